@@ -0,0 +1,193 @@
+#include "AnalysisCache.h"
+#include "MappedFile.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+static const char cacheMagic[8] = {'C', 'H', 'E', 'S', 'S', 'A', 'C', '1'};
+static const uint32_t cacheVersion = 2;
+//The header is padded so the slots start on a cache line
+static const size_t headerBytes = 64;
+//Set in every stored data word, so an empty slot is never mistaken for a result
+static const uint64_t usedBit = (uint64_t)1 << 63;
+
+AnalysisCache::AnalysisCache() : hits(0), misses(0) {
+}
+
+AnalysisCache::~AnalysisCache() {
+    close();
+}
+
+//Layout of the data word: move in bits 0-15, score in 16-31, depth in 32-39, flags in 40-47, and the used bit
+uint64_t AnalysisCache::pack(const CachedAnalysis& a) {
+    return (uint64_t)a.best.data |
+           ((uint64_t)(uint16_t)(int16_t)a.score << 16) |
+           ((uint64_t)(uint8_t)a.depth << 32) |
+           ((uint64_t)a.flags << 40) |
+           usedBit;
+}
+
+//Zeroes every slot, leaving the file its size so no process which has it mapped reads past its end
+static bool clearSlots(int fd, uint64_t slotCount) {
+    std::vector<char> zeros(1 << 20);
+    uint64_t bytes = slotCount * 16;
+    for (uint64_t done = 0; done < bytes; done += zeros.size())
+        if (!MappedFile::writeAll(fd, zeros.data(), (size_t)std::min<uint64_t>(zeros.size(), bytes - done), headerBytes + done))
+            return false;
+    return true;
+}
+
+/*
+ Maps the cache file, creating and sizing it first if it is new, or emptying it if its scores were made
+ with other weights or by an older version. This is done under an exclusive lock on the file, so two
+ processes starting at once agree on a single layout.
+ fileName - the cache file
+ weights - the fingerprint of the evaluation weights
+ megabytes - the size of a new file
+ */
+bool AnalysisCache::open(std::string fileName, uint64_t weights, size_t megabytes) {
+    close();
+
+    writable = true;
+    fd = ::open(fileName.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        writable = false;
+        fd = ::open(fileName.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+    }
+
+    Header header;
+    struct stat info;
+    bool valid = true;
+    if (writable)
+        flock(fd, LOCK_EX);
+    if (fstat(fd, &info) != 0) {
+        valid = false;
+    } else if (info.st_size == 0 && writable) {
+        uint64_t count = BucketSize;
+        while (count * 2 * 16 <= megabytes * 1024 * 1024)
+            count *= 2;
+        memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+        header.version = cacheVersion;
+        header.slotSize = 16;
+        header.slotCount = count;
+        header.weights = weights;
+        valid = ftruncate(fd, (off_t)(headerBytes + count * 16)) == 0 &&
+                pwrite(fd, &header, sizeof(header), 0) == (ssize_t)sizeof(header);
+        info.st_size = (off_t)(headerBytes + count * 16);
+    } else {
+        bool layout = pread(fd, &header, sizeof(header), 0) == (ssize_t)sizeof(header) &&
+                      memcmp(header.magic, cacheMagic, sizeof(cacheMagic)) == 0 && header.slotSize == 16 &&
+                      header.slotCount >= BucketSize && (header.slotCount & (header.slotCount - 1)) == 0 &&
+                      (uint64_t)info.st_size == headerBytes + header.slotCount * 16;
+        valid = layout && header.version == cacheVersion && header.weights == weights;
+        //Stale scores are thrown away, and the header written again only once the slots are empty
+        if (layout && !valid && writable) {
+            header.version = cacheVersion;
+            header.weights = weights;
+            valid = clearSlots(fd, header.slotCount) &&
+                    pwrite(fd, &header, sizeof(header), 0) == (ssize_t)sizeof(header);
+        }
+    }
+    if (writable)
+        flock(fd, LOCK_UN);
+
+    if (valid) {
+        mappedBytes = (size_t)info.st_size;
+        mapping = mmap(nullptr, mappedBytes, writable ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED, fd, 0);
+        if (mapping == MAP_FAILED) {
+            mapping = nullptr;
+            valid = false;
+        }
+    }
+    if (!valid) {
+        close();
+        return false;
+    }
+
+    slots = reinterpret_cast<uint64_t*>(static_cast<char*>(mapping) + headerBytes);
+    mask = header.slotCount - 1;
+    hits = 0;
+    misses = 0;
+    return true;
+}
+
+void AnalysisCache::close() {
+    if (mapping != nullptr)
+        munmap(mapping, mappedBytes);
+    if (fd >= 0)
+        ::close(fd);
+    mapping = nullptr;
+    slots = nullptr;
+    mappedBytes = 0;
+    fd = -1;
+}
+
+bool AnalysisCache::probe(uint64_t key, CachedAnalysis& analysis) const {
+    if (slots == nullptr)
+        return false;
+
+    uint64_t first = key & mask & ~(uint64_t)(BucketSize - 1);
+    for (uint64_t i = first; i < first + BucketSize; i++) {
+        uint64_t data = __atomic_load_n(&slots[2 * i + 1], __ATOMIC_RELAXED);
+        uint64_t check = __atomic_load_n(&slots[2 * i], __ATOMIC_RELAXED);
+        if (data == 0 || (check ^ data) != key)
+            continue;
+
+        analysis.best.data = (uint16_t)(data & 0xFFFF);
+        analysis.score = (int16_t)((data >> 16) & 0xFFFF);
+        analysis.depth = (int)((data >> 32) & 0xFF);
+        analysis.flags = (uint8_t)((data >> 40) & 0xFF);
+        hits++;
+        return true;
+    }
+    misses++;
+    return false;
+}
+
+void AnalysisCache::store(uint64_t key, const CachedAnalysis& analysis) {
+    if (slots == nullptr || !writable)
+        return;
+
+    //Uses the slot already holding this position, else an empty one, else the shallowest
+    uint64_t first = key & mask & ~(uint64_t)(BucketSize - 1);
+    uint64_t target = first;
+    int targetDepth = 256;
+    for (uint64_t i = first; i < first + BucketSize; i++) {
+        uint64_t data = __atomic_load_n(&slots[2 * i + 1], __ATOMIC_RELAXED);
+        uint64_t check = __atomic_load_n(&slots[2 * i], __ATOMIC_RELAXED);
+        if (data == 0 || (check ^ data) == key) {
+            //A deeper result for the same position is worth more than this one
+            if (data != 0 && (int)((data >> 32) & 0xFF) > analysis.depth)
+                return;
+            target = i;
+            break;
+        }
+        int depth = (int)((data >> 32) & 0xFF);
+        if (depth < targetDepth) {
+            targetDepth = depth;
+            target = i;
+        }
+    }
+
+    uint64_t data = pack(analysis);
+    __atomic_store_n(&slots[2 * target], key ^ data, __ATOMIC_RELAXED);
+    __atomic_store_n(&slots[2 * target + 1], data, __ATOMIC_RELAXED);
+}
+
+void AnalysisCache::sync() {
+    if (mapping != nullptr && writable)
+        msync(mapping, mappedBytes, MS_ASYNC);
+}
+
+AnalysisCache* AnalysisCache::defaultCache() {
+    static AnalysisCache cache;
+    static bool opened = cache.open("analysis.cache", Evaluation::defaultWeights().fingerprint());
+    return opened ? &cache : nullptr;
+}
@@ -0,0 +1,95 @@
+#ifndef AnalysisCache_H
+#define AnalysisCache_H
+
+#include "Position.h"
+#include "Evaluation.h"
+#include <atomic>
+#include <string>
+#include <stdint.h>
+
+//Flags kept with a cached result. Only searched positions are cached, so mates and stalemates, which are
+//found without a search, never are
+enum CacheFlags : uint8_t {
+    CacheInCheck = 1
+};
+
+//One position's analysis, as kept in the cache
+struct CachedAnalysis {
+    int score = 0;          //Centipawns from the point of view of the side to move
+    int depth = 0;          //Search depth of the score, 0 for the static evaluation
+    CompactMove best;
+    uint8_t flags = 0;
+};
+
+/*
+ A hash table of analysis results which lives in a memory mapped file, so results survive between runs
+ and are shared by every process which opens the same file.
+ The file is a header followed by fixed size slots, each the position key xored with the data and the
+ data itself, the same scheme the transposition table uses between threads. Each word is written
+ atomically, and a slot torn by two writers at once no longer matches its key, so any number of processes
+ can read and write the file at the same time without locks. Only creating the file takes a lock.
+ Scores depend on the evaluation weights, so the header keeps a fingerprint of the weights they were made
+ with, and a cache opened with other weights, such as after the tuner has run, is emptied first.
+ */
+class AnalysisCache {
+private:
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t slotSize;
+        uint64_t slotCount;
+        uint64_t weights;       //The fingerprint of the evaluation weights the scores were made with
+    };
+
+    int fd = -1;
+    void* mapping = nullptr;
+    size_t mappedBytes = 0;
+    uint64_t* slots = nullptr;      //Two words per slot
+    uint64_t mask = 0;
+    bool writable = false;
+
+    mutable std::atomic<uint64_t> hits;
+    mutable std::atomic<uint64_t> misses;
+
+    static uint64_t pack(const CachedAnalysis& a);
+
+public:
+
+    //Positions are looked for in groups of this many slots
+    static const int BucketSize = 4;
+
+    AnalysisCache();
+    ~AnalysisCache();
+
+    //Opens the cache file, creating it with roughly the given size if it does not exist.
+    //An existing file keeps its own size, and is emptied if its scores were made with other weights.
+    //Falls back to read only if the file can not be written, failing if the scores are stale.
+    //weights - the fingerprint of the evaluation weights, from EvalWeights::fingerprint
+    bool open(std::string fileName, uint64_t weights, size_t megabytes = 64);
+    void close();
+
+    bool isOpen() const {
+        return slots != nullptr;
+    }
+
+    //Looks up a position by its key, returning false on a miss
+    bool probe(uint64_t key, CachedAnalysis& analysis) const;
+
+    //Keeps a result, replacing the shallowest result in its bucket if the bucket is full
+    void store(uint64_t key, const CachedAnalysis& analysis);
+
+    //Asks the system to write the cache out to disk now rather than whenever it chooses
+    void sync();
+
+    uint64_t hitCount() const {
+        return hits;
+    }
+    uint64_t missCount() const {
+        return misses;
+    }
+
+    //The cache shared by the analysis tools, kept in analysis.cache. Returns nullptr if it could not be opened
+    static AnalysisCache* defaultCache();
+};
+
+#endif
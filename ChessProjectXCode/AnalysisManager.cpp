@@ -1,179 +1,275 @@
 #include "AnalysisManager.h"
 #include "globalFunctions.h"
+#include "OpeningExplorer.h"
 #include <string>
-#include <stack>
+#include <limits>
+#include <algorithm>
+#include <sstream>
 
 AnalysisManager::AnalysisManager(std::string fileName) {
-    input.loadFile(fileName);
+    // Maps the game read only and copies it out in one go, so moving around it never touches the file
+    if (input.mapFile(fileName)) {
+        std::span<const Move> view = input.entries();
+        moves.assign(view.begin(), view.end());
+        loaded = true;
+    }
+    if (loaded)
+        start();
+}
+
+AnalysisManager::AnalysisManager(const std::vector<Move>& game) : moves(game), loaded(true) {
+    start();
+}
+
+/*
+ Cuts the game down to its moves up to the first which is not legal, as a file cut short or not written
+ by this program may hold, so the board only ever replays legal moves. Then works out the key of every
+ position for the explorer, finds the book moves until the game leaves the book, and sets the analyzer going
+ */
+void AnalysisManager::start() {
+    Position pos;
+    pos.reset();
+    keys.push_back(pos.key());
+    for (auto it = moves.begin(); it != moves.end() && pos.applyStoredMove(*it); it++)
+        keys.push_back(pos.key());
+    moves.resize(keys.size() - 1);
+
+    const PolyglotBook* book = PolyglotBook::defaultBook();
+    if (book != nullptr) {
+        pos.reset();
+        for (bookPlies = 0; ; bookPlies++) {
+            bookMoves.push_back(book->lookup(pos));
+            if (bookPlies == (int)moves.size())
+                break;
+            CompactMove m = pos.fromStoredMove(moves[bookPlies]);
+            const std::vector<BookMove>& options = bookMoves.back();
+            if (m.isNull() || std::none_of(options.begin(), options.end(), [&](const BookMove& b) { return b.move == m; }))
+                break;
+            UndoInfo undo;
+            pos.makeMove(m, undo);
+        }
+    }
+    takeKeyframes();
+    analyzer.reset(new PlyAnalyzer(moves, AnalysisCache::defaultCache()));
+}
+
+/*
+ Plays through the game from the start, keeping a snapshot every KeyframeInterval plies, and leaves the
+ board back at the starting position
+ */
+void AnalysisManager::takeKeyframes() {
+    keyframes.clear();
+    keyframes.reserve(moves.size() / KeyframeInterval + 1);
+    gm.board.reset();
+    for (ply = 0; ; ) {
+        if (ply % KeyframeInterval == 0) {
+            keyframes.emplace_back();
+            gm.board.saveSnapshot(keyframes.back());
+        }
+        if (ply == (int)moves.size())
+            break;
+        stepForward();
+    }
+    gm.board.reset();
+    ply = 0;
 }
 
 int AnalysisManager::displayUI(std::string str, bool whitesTurn) {
-    globalFunctions::clearConsole();
-    std::cout << str << std::endl;
-    gm.board.print(true, std::cout);
+    std::ostringstream header, footer;
+    header << str << '\n' << "Ply " << ply << " of " << moves.size();
+    displayAnalysis(footer);
+    displayExplorer(footer);
+    displayBook(footer);
+    displayTablebase(footer);
+    renderer.render(gm.board, true, header.str(), footer.str());
     return displayMenu();
 }
 
+/*
+ Shows the evaluation, check or mate, and hanging pieces of the current ply. Only results already
+ published by the analyzer are read, so this never waits on it.
+ */
+void AnalysisManager::displayAnalysis(std::ostream& output) {
+    PlyAnalysis a;
+    if (!analyzer || !analyzer->get(ply, a)) {
+        output << "Analysing..." << std::endl;
+        return;
+    }
+    
+    if (a.checkmate)
+        output << "Checkmate. ";
+    else if (a.stalemate)
+        output << "Stalemate. ";
+    else if (a.inCheck)
+        output << "Check. ";
+    output << "Evaluation: " << (a.score >= 0 ? "+" : "") << a.score / 100.0;
+    if (!a.best.isNull())
+        output << " at depth " << a.depth << ", best move " << Position::moveName(a.best);
+    output << std::endl;
+    
+    // Lists the pieces which can be taken for free, as identifier and square
+    for (int color = 0; color < 2; color++) {
+        uint64_t hanging = (color == 0) ? a.hangingWhite : a.hangingBlack;
+        if (hanging == 0)
+            continue;
+        output << ((color == 0) ? "White" : "Black") << " pieces hanging:";
+        for (int sq = 0; sq < 64; sq++) {
+            if (hanging & ((uint64_t)1 << sq)) {
+                Location l(sq % 8, sq / 8);
+                output << ' ' << gm.board.idenAt(l) << l;
+            }
+        }
+        output << std::endl;
+    }
+}
+
+/*
+ Lists the most played moves from the current position in the saved games, with how those games ended
+ as white wins / draws / black wins. The lookup is a binary search of the mapped explorer file.
+ */
+void AnalysisManager::displayExplorer(std::ostream& output) {
+    const OpeningExplorer* explorer = OpeningExplorer::defaultExplorer();
+    if (explorer == nullptr || ply >= (int)keys.size())
+        return;
+    std::vector<ExplorerMove> played = explorer->lookup(keys[ply]);
+    if (played.empty())
+        return;
+    
+    output << "Played from here in saved games:" << std::endl;
+    for (size_t i = 0; i < played.size() && i < 5; i++) {
+        const ExplorerMove& m = played[i];
+        output << "  " << Position::moveName(m.move) << "  " << m.games << (m.games == 1 ? " game  " : " games  ")
+               << 100 * m.whiteWins / m.games << "% / " << 100 * m.draws / m.games << "% / " << 100 * m.blackWins / m.games << "%" << std::endl;
+    }
+}
+
+void AnalysisManager::displayBook(std::ostream& output) {
+    if (bookPlies < 0)
+        return;
+    if (ply < (int)bookMoves.size() && !bookMoves[ply].empty()) {
+        output << "Book:";
+        for (auto it = bookMoves[ply].begin(); it != bookMoves[ply].end(); it++)
+            output << "  " << Position::moveName(it->move) << " (" << it->weight << ")";
+        output << std::endl;
+    }
+    if (bookPlies == (int)moves.size())
+        output << "Every move of the game is in the book" << std::endl;
+    else if (ply <= bookPlies)
+        output << "The game leaves the book at ply " << bookPlies + 1 << std::endl;
+    else
+        output << "Out of book since ply " << bookPlies + 1 << std::endl;
+}
+
+void AnalysisManager::displayTablebase(std::ostream& output) {
+    bool whiteToMove = (ply % 2 == 0);
+    TablebaseResult result;
+    if (Tablebases::defaultTablebases()->probe(Position::fromBoard(gm.board, whiteToMove), result))
+        output << "Tablebase: " << Tablebases::describe(result, whiteToMove) << std::endl;
+}
+
+/*
+ Performs the move after the current ply
+ */
+void AnalysisManager::stepForward() {
+    int points = 0;
+    bool whitesTurn = (ply % 2 == 0);   // White makes the even numbered moves, counting from 0
+    gm.board.applyMove(whitesTurn, moves[ply], points);     // start kept only the legal moves
+    ply++;
+}
+
+/*
+ Moves the board to any point in the game. Stepping forward from where the board already is is used when
+ that is no further than from the nearest keyframe, otherwise the keyframe at or before the target is loaded.
+ target - the number of moves to have done, clamped to the length of the game
+ */
+void AnalysisManager::seek(int target) {
+    target = std::max(0, std::min(target, (int)moves.size()));
+    
+    int k = target / KeyframeInterval;
+    int keyframePly = k * KeyframeInterval;
+    if (ply > target || ply < keyframePly) {
+        gm.board.loadSnapshot(keyframes[k]);
+        ply = keyframePly;
+    }
+    
+    while (ply < target)
+        stepForward();
+    
+    if (analyzer)
+        analyzer->setCursor(ply);
+}
+
 void AnalysisManager::play() {
     
     //Resets the board to starting position
     gm.board.reset();
-    globalFunctions::clearConsole();
+    ply = 0;
     
     //Tracker for when the user wants to leave, which will probably be replaced soon enough
     bool done = false;
-    bool whitesTurn = false;
-    int index = 0;
-    std::stack<Piece*> taken;
-    std::stack<int>     takenIndex;
-    std::stack<int>     queenMakingIndeces;
-    Move m;
     int choice = 3;
     
-    
     while (!done) {
         
         /*
-            Because the below code is fairly confusing, I find it necessary to list the pre-conditions and notes that govern the code below
-            1. The Index, at this point in the code, is always the move which has been done last. This will be either (a) the last step forward, (b) the last move before the end, or (c) 0, indicating a starting position.
-            2. The turn boolean represents the color which has moved last. i.e. if the last step was black, the color will be black. Thus, the boolean is initially set to be false (for black moved last), as white must move first
-         
-         
-            Notes: 
-         
-                doMove() does check legality of the move, which is somewhat a waste and so it might be replaced by peroformMove
-                the RAFile class startings indexing at 1 . . . size(). This was done as a test to see how it would work. I now realize that 0 . . . size() - 1, is actually easier for me to manage.
-         
+            The ply is the number of moves done on the board, so 0 is the starting position and moves.size() the end.
+            Every option is a seek to some ply, which loads the nearest keyframe and replays the few moves after it.
+            The turn boolean represents the color which has moved last, so it is white after an odd number of moves.
          */
+        bool whitesTurn = (ply % 2 == 1);
         
         if (choice == 1) {                  // Step forward
             
             // checks if there are no more moves to perform
-            if (index == input.size()) {
+            if (ply == (int)moves.size()) {
                 choice = displayUI("You can not step any further", whitesTurn);
                 continue;
             }
-            
-            // Increments counters to the proper locations for the next move
-            index++;                        // Moves the index to the move about to be done
-            whitesTurn = !whitesTurn;       // Moves the color to the move about to be done
-            
-            // Gathes the move details for the next move
-            input.get(index, m);
-            
-            // Checks for pawn turning into a queen
-            Piece* p = gm.board.at(m.from);
-            if (p != nullptr && p->getIdentifier() == 'P' && ( (m.to.y == 7 && whitesTurn) || (m.to.y == 0 && !whitesTurn) ) ) {
-                queenMakingIndeces.push(index);
-            }
-            
-            // Updates our piece tracker, if necessary
-            if (!gm.board.isEmpty(m.to)) {  // If we are taking a piece
-                taken.push(gm.board.at(m.to));
-                takenIndex.push(index);
-            }
-            
-            // Performs the actual move, we pass in choice because we don't care about it's value anymore
-            gm.board.doMove(whitesTurn, m, choice);
-            
+            seek(ply + 1);
+        
         } else if (choice == 2) {           // Step back
             
-            // Note we are checking indeces before performing the move
-            if (index == 0) {  // No prior moves
+            if (ply == 0) {  // No prior moves
                 choice = displayUI("You can not step back any further", whitesTurn);
                 continue;
-            }/* else if (index == 1) {    // Reset to initial position, may not be necessary
-                gm.board.reset();
-                taken = std::stack<Piece*>();
-                takenIndex = std::stack<int>();
-                whitesTurn = false;
-                choice = displayUI("", whitesTurn);
-                continue;
-            }*/
-            
-            // Removes the previous move
-            input.get(index, m);
-            Piece* p = nullptr;
-            if (!takenIndex.empty() && takenIndex.top() == index) {
-                p = taken.top();
-                p->activate();  // Activates the piece so it is drawn
-                taken.pop();
-                takenIndex.pop();
             }
-            
-            
-            Move m2(m.to, m.from);
-            
-            gm.board.performMove(m2);
-            
-            gm.board.set(m2.from, p);
-            
-            // Checks if we are taking back a turn which made a pawn into a queen
-            if (!queenMakingIndeces.empty() && queenMakingIndeces.top() == index) {
-                
-                // Gathers a pawn from the list of the piece set, so it is included in all functions
-                Pawn* p = (whitesTurn ? gm.board.white : gm.board.black).findDeactivatedPawn();
-                
-                // Sets the location to the piece
-                if ( p != nullptr) {    // Should always be able to run, but better safe
-                    p->setLocation(m.from);     // Sets the location of the piece
-                    p->activate();              // Activates the piece
-                    Piece* queen = gm.board.at(m.from); // Gathers the queen so we can deactivate it
-                    queen->deactivate();        // Deactivates the queen
-                    gm.board.set(m.from, p);    // Set sthe location to the pawn
-                }
-                
-                queenMakingIndeces.pop();
-            }
-            
-            // Decrements values to the previous turn
-            whitesTurn = !whitesTurn;
-            index--;
-            
+            seek(ply - 1);
+        
         } else if (choice == 3) {           // Go to beginning
             
-            // Reset the stacks
-            takenIndex = std::stack<int>();
-            taken = std::stack<Piece*>();
-            queenMakingIndeces = std::stack<int>();
-            
-            // Resets the board
-            whitesTurn = false;
-            gm.board.reset();
-            index = 0;
-            
+            seek(0);
+        
         } else if (choice == 4) {           // Go to end
             
-            while (index < input.size()) {  // Loops through the game, without input
-                input.get(++index, m);
-                whitesTurn = !whitesTurn;
-                if (!gm.board.isEmpty(m.to)) {  // If we are taking a piece
-                    taken.push(gm.board.at(m.to));
-                    takenIndex.push(index);
-                }
-                // Checks for pawn turning into a queen
-                Piece* p = gm.board.at(m.from);
-                if (p != nullptr && p->getIdentifier() == 'P' && ( (m.to.y == 7 && whitesTurn) || (m.to.y == 0 && !whitesTurn) ) ) {
-                    queenMakingIndeces.push(index);
-                }
-                // Note: we pass in choice because we can corrupt it now
-                gm.board.doMove(whitesTurn, m, choice);
-            }
+            seek((int)moves.size());
+        
+        } else if (choice == 5) {           // Jump to a ply
             
-        } else if (choice == 5) {   // Exit Program
+            int target;
+            std::cout << "Enter the ply to jump to, from 0 to " << moves.size() << std::endl;
+            std::cin >> target;
+            if (std::cin.fail() || target < 0 || target > (int)moves.size()) {
+                std::cin.clear();
+                std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+                choice = displayUI("That ply is not part of the game", whitesTurn);
+                continue;
+            }
+            seek(target);
+        
+        } else if (choice == 6) {   // Exit Program
             
             done = true;
-            
+        
         }
         
         if (!done) {    //Gets input for the next operation
-            choice = displayUI("", whitesTurn);
+            choice = displayUI("", (ply % 2 == 1));
         }
     }
 }
 
 AnalysisManager::operator bool() const {
-    return input.isOpen();
+    return loaded;
 }
 
 int AnalysisManager::displayMenu() const {
@@ -182,7 +278,8 @@ int AnalysisManager::displayMenu() const {
     std::cout << "(2) step backward" << std::endl;
     std::cout << "(3) Return to turn 0" << std::endl;
     std::cout << "(4) Go to end" << std::endl;
-    std::cout << "(5) exit" << std::endl;
+    std::cout << "(5) Jump to ply" << std::endl;
+    std::cout << "(6) exit" << std::endl;
     int x;
     std::cin >> x;
     return x;
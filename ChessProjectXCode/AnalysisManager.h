@@ -5,14 +5,64 @@
 #include "ChessBoard.h"
 #include "GameManager.h"
 #include "RAFile.h"
+#include "PlyAnalyzer.h"
+#include "PolyglotBook.h"
+#include "Tablebase.h"
+#include "TerminalRenderer.h"
 #include <string>
+#include <vector>
+#include <memory>
 
 class AnalysisManager {
 private:
     RAFile<Move> input;
     GameManager gm;
+    
+    //The whole game up to its first illegal move, read once when the file is opened
+    std::vector<Move> moves;
+    //The number of moves currently done on the board
+    int ply = 0;
+    //Whether the game could be read
+    bool loaded = false;
+    //The key of the position after each ply, for looking it up in the opening explorer
+    std::vector<uint64_t> keys;
+    //The opening book's moves for each ply up to and including the first move played which was not one of them
+    std::vector<std::vector<BookMove>> bookMoves;
+    //The number of plies played from the book, or -1 if there is no book
+    int bookPlies = -1;
+    
+    //A snapshot of the board every KeyframeInterval plies, all taken when the game is read, so any ply can be
+    //reached by loading the one before it and replaying fewer than KeyframeInterval moves. Snapshot k is the
+    //board after k * KeyframeInterval plies
+    static const int KeyframeInterval = 8;
+    std::vector<BoardSnapshot> keyframes;
+    
+    //Analyses every ply in the background, starting around the ply being shown
+    std::unique_ptr<PlyAnalyzer> analyzer;
+    
+    //Draws each ply over the last, leaving rows below the board for the menu
+    TerminalRenderer renderer = TerminalRenderer(8);
+    
+    //Writes what the analyzer found about the current ply, if it is ready
+    void displayAnalysis(std::ostream& output);
+    //Writes the moves the saved games played from the current ply, if it is in the opening explorer
+    void displayExplorer(std::ostream& output);
+    //Writes the book moves of the current ply, and where the game left the book
+    void displayBook(std::ostream& output);
+    //Writes the exact result of the current ply from the endgame tables, once few enough pieces are left
+    void displayTablebase(std::ostream& output);
+    //Starts the analysis of the game once it has been read
+    void start();
+    //Replays the whole game once, taking every keyframe
+    void takeKeyframes();
+    
+    //Does the next move of the game
+    void stepForward();
+    
 public:
     AnalysisManager(std::string fileName);
+    //Analyses a game already read, such as one from the game database
+    AnalysisManager(const std::vector<Move>& game);
     //Plays through the game given when this instance was created
     void play();
     //Checks that the AnalysisManager was created successfully
@@ -21,6 +71,8 @@ public:
     int displayMenu() const;
     //Displays the UI Update and input for the user, with the custom message above
     int displayUI(std::string str, bool whitesTurn);
+    //Sets the board to how it was after the given number of moves
+    void seek(int target);
 };
 
 #endif
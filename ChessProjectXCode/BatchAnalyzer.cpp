@@ -0,0 +1,209 @@
+#include "BatchAnalyzer.h"
+#include "RAFile.h"
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <sstream>
+#include <algorithm>
+#include <stdio.h>
+
+//Mates are written as this many centipawns, so swings stay readable
+static const int MateValue = 10000;
+
+BatchAnalyzer::BatchAnalyzer(int threads, int depth, AnalysisCache* cache) : depth(depth), cache(cache) {
+    threadCount = (threads > 0) ? threads : (int)std::thread::hardware_concurrency();
+    if (threadCount < 1)
+        threadCount = 1;
+}
+
+int BatchAnalyzer::material(const Position& pos) {
+    int total = 0;
+    for (int sq = 0; sq < 64; sq++) {
+        uint8_t p = pos.at(sq);
+        if (p == NoPiece || Position::typeOf(p) == KingType)
+            continue;
+        int value = Evaluation::defaultWeights().material(Position::typeOf(p));
+        total += Position::isWhitePiece(p) ? value : -value;
+    }
+    return total;
+}
+
+//Escapes the characters JSON does not allow inside a string
+static std::string jsonString(const std::string& s) {
+    std::string out = "\"";
+    for (size_t i = 0; i < s.size(); i++) {
+        char c = s[i];
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if ((unsigned char)c < 0x20) {
+            char buffer[8];
+            snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+            out += buffer;
+        } else {
+            out += c;
+        }
+    }
+    return out + "\"";
+}
+
+/*
+ Scores every position of a game from white's side, then writes the game as one JSON line.
+ label - the fields naming the game, written first
+ moves - the game
+ engine - the calling thread's search
+ line - filled with the JSON line, without a newline
+ plies - filled with the number of plies analysed
+ cacheHits - increased by the number of positions found in the cache
+ */
+void BatchAnalyzer::analyseGame(const std::string& label, const std::vector<Move>& moves, Engine& engine, std::string& line, int& plies, uint64_t& cacheHits) const {
+    Position pos;
+    pos.reset();
+    engine.newGame();
+
+    SearchLimits limits;
+    limits.depth = depth;
+    limits.threads = 1;
+
+    std::vector<CompactMove> played;
+    std::vector<int> scores;            //scores[i] is the position before move i, from white's side
+    std::vector<int> materials;
+    std::vector<uint64_t> history;
+    bool replayed = true;
+    for (size_t i = 0; i <= moves.size(); i++) {
+        int score;
+        if (!pos.hasLegalMove())
+            score = pos.inCheck() ? -MateValue : 0;
+        else if (depth <= 0)
+            score = Evaluation::evaluateForSideToMove(pos, Evaluation::defaultWeights());
+        else {
+            CachedAnalysis cached;
+            if (cache != nullptr && cache->probe(pos.key(), cached) && cached.depth >= depth) {
+                score = cached.score;
+                cacheHits++;
+            } else {
+                //The cache is keyed by the position alone, so a score kept in it must not depend on how the
+                //game reached the position
+                SearchResult searched = engine.search(pos, limits, std::vector<CompactMove>(),
+                                                      cache != nullptr ? std::vector<uint64_t>() : history);
+                score = searched.score;
+                if (cache != nullptr) {
+                    cached.score = searched.score;
+                    cached.depth = searched.depth;
+                    cached.best = searched.best;
+                    cached.flags = pos.inCheck() ? CacheInCheck : 0;
+                    cache->store(pos.key(), cached);
+                }
+            }
+            if (score >= MateBound)
+                score = MateValue;
+            else if (score <= -MateBound)
+                score = -MateValue;
+        }
+        scores.push_back(pos.isWhiteToMove() ? score : -score);
+        materials.push_back(material(pos));
+
+        if (i == moves.size())
+            break;
+        CompactMove m = pos.fromStoredMove(moves[i]);
+        if (m.isNull()) {
+            replayed = false;
+            break;
+        }
+        history.push_back(pos.key());
+        UndoInfo undo;
+        pos.makeMove(m, undo);
+        played.push_back(m);
+    }
+
+    std::string result = "*";
+    if (pos.isCheckmate())
+        result = pos.isWhiteToMove() ? "0-1" : "1-0";
+    else if (pos.isStalemate())
+        result = "1/2-1/2";
+
+    std::ostringstream out;
+    out << "{" << label << ",\"result\":\"" << result << "\",\"complete\":"
+        << (replayed ? "true" : "false") << ",\"plies\":[";
+    int blunders = 0;
+    for (size_t i = 0; i < played.size(); i++) {
+        bool whiteMoved = (i % 2 == 0);
+        int loss = (scores[i] - scores[i + 1]) * (whiteMoved ? 1 : -1);
+        bool blunder = loss >= BlunderMargin;
+        blunders += blunder;
+        out << (i ? "," : "") << "{\"move\":\"" << Position::moveName(played[i]) << "\",\"eval\":" << scores[i + 1]
+            << ",\"swing\":" << (materials[i + 1] - materials[i]) << ",\"blunder\":" << (blunder ? "true" : "false") << "}";
+    }
+    out << "],\"blunders\":" << blunders << "}";
+
+    line = out.str();
+    plies = (int)played.size();
+}
+
+BatchStats BatchAnalyzer::run(const std::vector<std::string>& files, std::ostream& output) {
+    return run(files.size(), [&](size_t i, std::vector<Move>& moves, std::string& label) {
+        label = "\"file\":" + jsonString(files[i]);
+        return RAFile<Move>::readAll(files[i], moves);
+    }, output);
+}
+
+BatchStats BatchAnalyzer::run(const GameStorage& storage, std::ostream& output) {
+    return run((size_t)storage.size(), [&](size_t i, std::vector<Move>& moves, std::string& label) {
+        label = "\"game\":" + std::to_string(i) + ",\"name\":" + jsonString(storage.info((int)i).name);
+        return storage.loadGame((int)i, moves);
+    }, output);
+}
+
+/*
+ Hands the games out to the threads one at a time, so long and short games balance themselves
+ count - the number of games
+ read - reads a game and the label its line starts with
+ output - where the JSON lines are written
+ */
+BatchStats BatchAnalyzer::run(size_t count, const GameReader& read, std::ostream& output) {
+    BatchStats stats;
+    std::atomic<size_t> next(0);
+    std::atomic<int> games(0), failed(0);
+    std::atomic<uint64_t> plies(0), cacheHits(0);
+    std::mutex writing;
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threadCount; t++) {
+        workers.push_back(std::thread([&] () {
+            Engine engine(8);
+            std::string label, line;
+            std::vector<Move> moves;
+            size_t i;
+            while ((i = next++) < count) {
+                int gamePlies = 0;
+                uint64_t gameHits = 0;
+                if (!read(i, moves, label)) {
+                    failed++;
+                    continue;
+                }
+                analyseGame(label, moves, engine, line, gamePlies, gameHits);
+                {
+                    std::lock_guard<std::mutex> lock(writing);
+                    output << line << '\n';
+                }
+                games++;
+                plies += gamePlies;
+                cacheHits += gameHits;
+            }
+        }));
+    }
+    for (auto it = workers.begin(); it != workers.end(); it++)
+        it->join();
+    output.flush();
+    if (cache != nullptr)
+        cache->sync();
+
+    stats.games = games;
+    stats.failed = failed;
+    stats.plies = plies;
+    stats.cacheHits = cacheHits;
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return stats;
+}
@@ -0,0 +1,73 @@
+#ifndef BatchAnalyzer_H
+#define BatchAnalyzer_H
+
+#include "Position.h"
+#include "Engine.h"
+#include "AnalysisCache.h"
+#include "GameStorage.h"
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+//Totals for one run of the batch analyzer
+struct BatchStats {
+    int games = 0;              //Games analysed
+    int failed = 0;             //Games which could not be read
+    uint64_t plies = 0;
+    uint64_t cacheHits = 0;     //Positions whose score came from the analysis cache
+    double seconds = 0;
+
+    double gamesPerSecond() const {
+        return seconds > 0 ? games / seconds : 0;
+    }
+    double pliesPerSecond() const {
+        return seconds > 0 ? plies / seconds : 0;
+    }
+};
+
+/*
+ Analyses many saved games at once without the interactive menu. Games are handed out to a pool of
+ threads, each with its own position and search, and each game is written as one JSON line as soon
+ as it is finished, so memory stays bounded by one game per thread however many games there are.
+ With a cache, positions already searched deeply enough by an earlier run, or another game, are not
+ searched again.
+
+ Every line holds the file, or the game's id and name when it comes from a database, its result, and
+ for each ply the move, the evaluation after it from white's side, the change in material it caused, and
+ whether it was a blunder: a move which lost the mover at least BlunderMargin centipawns of evaluation.
+ */
+class BatchAnalyzer {
+private:
+    int threadCount;
+    int depth;
+    AnalysisCache* cache;
+
+    //Reads game i into moves and its label, the JSON fields naming it, returning false if it could not be read
+    typedef std::function<bool(size_t i, std::vector<Move>& moves, std::string& label)> GameReader;
+
+    //Analyses one game's moves into a JSON line which starts with its label
+    void analyseGame(const std::string& label, const std::vector<Move>& moves, Engine& engine, std::string& line, int& plies, uint64_t& cacheHits) const;
+    //Analyses games 0 to count - 1, each read by read
+    BatchStats run(size_t count, const GameReader& read, std::ostream& output);
+
+public:
+
+    static const int BlunderMargin = 200;
+
+    //threads - 0 uses every core
+    //depth - the search depth used to score each position, or 0 for the static evaluation alone
+    //cache - if given, searched positions are looked up here first and kept here afterwards
+    BatchAnalyzer(int threads = 0, int depth = 3, AnalysisCache* cache = nullptr);
+
+    //Analyses every game in the list, writing the lines to output in the order the games finish
+    BatchStats run(const std::vector<std::string>& files, std::ostream& output);
+    //Analyses every game in the database, whose lines give the game's id and name in place of a file
+    BatchStats run(const GameStorage& storage, std::ostream& output);
+
+    //Material from white's side, in centipawns, using the default weights
+    static int material(const Position& pos);
+};
+
+#endif
@@ -3,6 +3,7 @@
 #include <iostream>
 #include <vector>
 #include <ctype.h>
+#include <string.h>
 #include <stdlib.h>
 #include <algorithm>
 #include <string>
@@ -30,9 +31,9 @@ void ChessBoard::printWhite(std::ostream& output) {
                 output << (p->isWhite() ? whiteColor : blackColor) << p->getIdentifier() << ' ';
             }
         }
-        output << resetColor << labelColor << '*' << std::endl;
+        output << resetColor << labelColor << '*' << '\n';
     }
-    output << "* A B C D E F G H *" << resetColor << std::endl;
+    output << "* A B C D E F G H *" << resetColor << '\n';
 }
 
 /*
@@ -148,9 +149,9 @@ void ChessBoard::printBlack(std::ostream& output) {
                 output << (p->isWhite() ? whiteColor : blackColor) << p->getIdentifier() << ' ';
             }
         }
-        output << resetColor << labelColor << '*' << std::endl;
+        output << resetColor << labelColor << '*' << '\n';
     }
-    output << "* H G F E D C B A *" << resetColor << std::endl;
+    output << "* H G F E D C B A *" << resetColor << '\n';
 }
 
 /*
@@ -168,7 +169,7 @@ ChessBoard::ChessBoard() {
  output - the ostream for the board
  */
 void ChessBoard::print(bool whitesPerspective, std::ostream& output) {
-    output << labelColor << "* * * * * * * * * *" << std::endl;
+    output << labelColor << "* * * * * * * * * *" << '\n';
     (whitesPerspective) ? printWhite(output) : printBlack(output);
 }
 
@@ -378,7 +379,7 @@ std::vector<Location> ChessBoard::checkKnightMoves(Location location, std::funct
     
     //Check horizontal squares
     for (int x3 = -1; x3 <=1; x3 += 2) {
-        for (int y3 = -2; y3 <= 2; y3 += 2) {
+        for (int y3 = -2; y3 <= 2; y3 += 4) {
             Location l(x + x3, y + y3);
             if (isValidLocation(l) && func(l))
                 takenFrom.push_back(l);
@@ -389,7 +390,7 @@ std::vector<Location> ChessBoard::checkKnightMoves(Location location, std::funct
 }
 
 std::vector<Location> ChessBoard::checkPawnMoves(Location location, std::function<bool(Location)> func, bool isWhite) {
-    int mod = (isWhite) ? -1 : 1;
+    int mod = (isWhite) ? 1 : -1;     //Pawns of the other color take toward this one
     
     Location op1(location.x + 1, location.y + mod);
     Location op2(location.x - 1, location.y + mod);
@@ -558,6 +559,50 @@ void ChessBoard::reset() {
     
     whiteKingHasMoved = false;
     blackKingHasMoved = false;
+    pawnStartingLane = -1;
+}
+
+static const char snapshotIdentifiers[] = " PNBRQK";
+
+/*
+ Copies the board into a snapshot
+ snapshot - filled with the squares, the en passant lane and the king flags
+ */
+void ChessBoard::saveSnapshot(BoardSnapshot& snapshot) const {
+    for (int i = 0; i < 32; i++)
+        snapshot.squares[i] = 0;
+    for (int x = 0; x < 8; x++) {
+        for (int y = 0; y < 8; y++) {
+            Piece* p = board[x][y];
+            if (p == nullptr)
+                continue;
+            int code = (int)(strchr(snapshotIdentifiers, p->getIdentifier()) - snapshotIdentifiers) + (p->isWhite() ? 0 : 8);
+            int sq = y * 8 + x;
+            snapshot.squares[sq / 2] |= (uint8_t)(code << ((sq % 2) * 4));
+        }
+    }
+    snapshot.pawnStartingLane = (int8_t)pawnStartingLane;
+    snapshot.whiteKingHasMoved = whiteKingHasMoved;
+    snapshot.blackKingHasMoved = blackKingHasMoved;
+}
+
+/*
+ Sets the board up from a snapshot, reusing the pieces of each set
+ snapshot - the board to put back
+ */
+void ChessBoard::loadSnapshot(const BoardSnapshot& snapshot) {
+    white.deactivateAll();
+    black.deactivateAll();
+    for (int x = 0; x < 8; x++) {
+        for (int y = 0; y < 8; y++) {
+            int sq = y * 8 + x;
+            int code = (snapshot.squares[sq / 2] >> ((sq % 2) * 4)) & 15;
+            board[x][y] = (code == 0) ? nullptr : ((code & 8) ? black : white).placePiece(snapshotIdentifiers[code & 7], Location(x, y));
+        }
+    }
+    pawnStartingLane = snapshot.pawnStartingLane;
+    whiteKingHasMoved = snapshot.whiteKingHasMoved;
+    blackKingHasMoved = snapshot.blackKingHasMoved;
 }
 
 bool ChessBoard::idenAt(int x, int y, char& c) const {
@@ -727,9 +772,23 @@ Legality ChessBoard::doMove(bool whitesTurn, const Move &m, int& points) {
     if (isMoveLegal != Legality::Legal)
         return isMoveLegal;
     
+    applyMove(whitesTurn, m, points);
+    return isMoveLegal;
+}
+
+/*
+ Performs a move without checking it, handling castling, en passant and promotion
+ whitesTurn - the color making the move
+ m - the move, which must be legal
+ points - increased by the value of any piece taken
+ */
+void ChessBoard::applyMove(bool whitesTurn, const Move &m, int& points) {
+    
     // Determines if we are castling, and then castles if it is
     if (m == KING_CASTLE || m == QUEEN_CASTLE) {
         castle(whitesTurn, m == KING_CASTLE);
+        pawnStartingLane = -1;
+        return;     // The castle sentinels hold no real squares, so nothing below applies
     }
     
     //Adds the points taken to the specified point total
@@ -773,21 +832,18 @@ Legality ChessBoard::doMove(bool whitesTurn, const Move &m, int& points) {
             // Sets the piece to a queen. Does not allow for knights because it complicates analysis manager too much
             this->set(m.to, (whitesTurn ? white : black).addQueen(m.to, whitesTurn));
             
-            return isMoveLegal;
+            return;
         }
     }
     
     //Moves the pieces
     performMove(m);
-    
-    //We should be able to theoretically return Success; however, this approach keeps us safe
-    return isMoveLegal;
 }
 
 void ChessBoard::performMove(const Move& m) {
     Piece* p = at(m.from);
     if (p != nullptr && p->getIdentifier() == 'K')
-        (p->isWhite()) ? whiteKingHasMoved : blackKingHasMoved = true;
+        ((p->isWhite()) ? whiteKingHasMoved : blackKingHasMoved) = true;
     //Moves the pieces
     set(m.to, at(m.from));
     clear(m.from);  //The pointer is moved, so does not need to be cleaned
@@ -795,7 +851,7 @@ void ChessBoard::performMove(const Move& m) {
 
 std::vector<Move> ChessBoard::gatherAllLegalMoves(bool isWhite) {
     std::vector<Move> moves;
-    PieceSet p = (isWhite ? white : black);
+    PieceSet& p = (isWhite ? white : black);
     p.forEveryActivePiece([&moves, this, isWhite] (Piece* p) {
         
         std::vector<Location> secondary = this->getLegalMoves(p);
@@ -4,6 +4,7 @@
 #include "PieceSet.h"
 #include "DecodeReturn.h"
 #include "Move.h"
+#include <stdint.h>
 
 enum Legality {
     Legal,
@@ -12,6 +13,14 @@ enum Legality {
     CantCastle
 };
 
+//A compact copy of everything needed to put a board back as it was, used for jumping around a game
+struct BoardSnapshot {
+    uint8_t squares[32];        //Two squares to a byte, 0 when empty, otherwise 1 - 6 for PNBRQK plus 8 for black
+    int8_t pawnStartingLane;
+    bool whiteKingHasMoved;
+    bool blackKingHasMoved;
+};
+
 class ChessBoard {
 private:
     
@@ -55,6 +64,7 @@ private:
     void performMove(const Move& m);
     
     friend class AnalysisManager;
+    friend class TerminalRenderer;
     
 public:
     
@@ -77,6 +87,10 @@ public:
         pawnStartingLane = x;
     }
     
+    bool kingHasMoved(bool whitesKing) const {
+        return whitesKing ? whiteKingHasMoved : blackKingHasMoved;
+    }
+    
     std::vector<Location> getLegalMoves(Piece* p);
     
     void print(bool whitesPerspective, std::ostream& output);
@@ -134,6 +148,10 @@ public:
     //Resets the board to starting position
     void reset();
     
+    //Copies the board into a snapshot, and puts it back as it was from one
+    void saveSnapshot(BoardSnapshot& snapshot) const;
+    void loadSnapshot(const BoardSnapshot& snapshot);
+    
     //Checks if the given square is empty
     bool isEmpty(int x, int y) const {
         if (!isValidLocation(x, y))
@@ -165,6 +183,9 @@ public:
     
     //Checks the legality of the move, and then performs it
     Legality doMove(bool whitesTurn, const Move& m, int& points);
+    
+    //Performs a move already known to be legal, such as one read from a saved game
+    void applyMove(bool whitesTurn, const Move& m, int& points);
 };
 
 #endif
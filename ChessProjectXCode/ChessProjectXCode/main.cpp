@@ -1,8 +1,561 @@
 #include <iostream>
+#include <fstream>
+#include <string>
+#include <chrono>
+#include <algorithm>
 #include "UIManager.h"
 #include "globalFunctions.h"
+#include "BatchAnalyzer.h"
+#include "RAFile.h"
+#include "Move.h"
+#include "GameStorage.h"
+#include "GameCodec.h"
+#include "TrainingData.h"
+#include "PgnImporter.h"
+#include "PgnExporter.h"
+#include "GameQuery.h"
+#include "Tablebase.h"
+#include "PositionService.h"
+#include "GameServer.h"
+#include "LoadGenerator.h"
+#include "GameLoop.h"
+#include <memory>
+#include <mutex>
+#include <sys/stat.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
 
-int main() {
+/*
+ Reads argument i as a whole number, leaving value as it is when there are fewer arguments
+ usage - printed, with a note of the bad argument, if it is not a number
+ */
+static bool numberArgument(int argc, const char * argv[], int i, int& value, const char* usage) {
+    if (i >= argc)
+        return true;
+    char* end;
+    errno = 0;
+    long n = strtol(argv[i], &end, 10);
+    if (end == argv[i] || *end != '\0' || errno == ERANGE || n < INT_MIN || n > INT_MAX) {
+        std::cerr << argv[i] << " is not a number.\nUsage: " << usage << std::endl;
+        return false;
+    }
+    value = (int)n;
+    return true;
+}
+
+static bool numberArgument(int argc, const char * argv[], int i, uint64_t& value, const char* usage) {
+    if (i >= argc)
+        return true;
+    char* end;
+    errno = 0;
+    unsigned long long n = strtoull(argv[i], &end, 10);
+    if (end == argv[i] || *end != '\0' || errno == ERANGE || argv[i][0] == '-') {
+        std::cerr << argv[i] << " is not a number.\nUsage: " << usage << std::endl;
+        return false;
+    }
+    value = n;
+    return true;
+}
+
+/*
+ Analyses saved games without the menu:
+    ChessProject --analyze <directory> [depth] [output file]
+ The JSON lines go to the output file, or standard output if none is given, and the rates to standard error.
+ Searched positions are kept in analysis.cache, so running again over the same games is mostly lookups.
+ */
+static int analyze(int argc, const char * argv[]) {
+    std::string dir = argv[2];
+    int depth = 3;
+    if (!numberArgument(argc, argv, 3, depth, "ChessProject --analyze <directory> [depth] [output file]"))
+        return 1;
+    std::ofstream file;
+    if (argc > 4) {
+        file.open(argv[4]);
+        if (!file.is_open()) {
+            std::cerr << "The file " << argv[4] << " could not be created." << std::endl;
+            return 1;
+        }
+    }
+    
+    BatchAnalyzer analyzer(0, depth, AnalysisCache::defaultCache());
+    BatchStats stats = analyzer.run(globalFunctions::listFiles(dir), (argc > 4) ? file : std::cout);
+    std::cerr << stats.games << " games, " << stats.failed << " failed, " << stats.plies << " plies, " << stats.cacheHits << " cached, in " << stats.seconds << " seconds ("
+              << stats.gamesPerSecond() << " games/sec, " << stats.pliesPerSecond() << " plies/sec)" << std::endl;
+    return stats.failed == 0 ? 0 : 1;
+}
+
+/*
+ Measures how fast moves can be appended to a saved game file:
+    ChessProject --bench-writes [records] [file]
+ Each way of writing is timed over the same records: flushing after every record, as the file did before
+ it buffered appends, the append buffer with one commit at the end, and the same with the commit forced
+ to the disk. The file is left holding the last run.
+ */
+static int benchWrites(int argc, const char * argv[]) {
+    int records = 200000;
+    if (!numberArgument(argc, argv, 2, records, "ChessProject --bench-writes [records] [file]"))
+        return 1;
+    std::string name = (argc > 3) ? argv[3] : "bench.writes";
+    Move m(Location(4, 1), Location(4, 3));
+    
+    const char* labels[3] = {"per-record", "buffered", "buffered+fsync"};
+    for (int run = 0; run < 3; run++) {
+        auto start = std::chrono::steady_clock::now();
+        RAFile<Move> file;
+        if (!file.newfile(name)) {
+            std::cerr << "The file " << name << " could not be created." << std::endl;
+            return 1;
+        }
+        bool written = true;
+        for (int i = 0; i < records && written; i++) {
+            written = file.append(m);
+            if (run == 0)
+                written = written && file.flush();
+        }
+        written = written && file.flush(run == 2) && file.closeFile();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (!written) {
+            std::cerr << "Writing to " << name << " failed." << std::endl;
+            return 1;
+        }
+        double megabytes = (double)records * sizeof(Move) / (1024 * 1024);
+        std::cout << labels[run] << ": " << records << " records in " << seconds << " seconds ("
+                  << (seconds > 0 ? records / seconds : 0) << " records/sec, " << (seconds > 0 ? megabytes / seconds : 0) << " MB/sec)" << std::endl;
+    }
+    return 0;
+}
+
+/*
+ Moves a directory of saved game files into a game database:
+    ChessProject --import-games <directory> [database]
+ The games are named by their file names, and go to games.db if no database is given.
+ */
+static int importGames(int argc, const char * argv[]) {
+    std::string name = (argc > 3) ? argv[3] : "games.db";
+    GameStorage storage;
+    if (!storage.open(name) || !storage.isWritable()) {
+        std::cerr << "The game database " << name << " could not be opened for writing." << std::endl;
+        return 1;
+    }
+    std::vector<std::string> files = globalFunctions::listFiles(argv[2]);
+    int added = storage.importFiles(files);
+    if (!storage.commit(true)) {
+        std::cerr << "The game database " << name << " could not be written." << std::endl;
+        return 1;
+    }
+    std::cerr << added << " of " << files.size() << " files imported, " << storage.size() << " games in " << name << std::endl;
+    return added == (int)files.size() ? 0 : 1;
+}
+
+/*
+ Adds the games of a PGN file to a game database, reading it on every core:
+    ChessProject --import-pgn <file.pgn> [database] [threads]
+ The games go to games.db if no database is given, and the rate of each stage is printed at the end.
+ */
+static int importPgn(int argc, const char * argv[]) {
+    std::string name = (argc > 3) ? argv[3] : "games.db";
+    int threads = 0;
+    if (!numberArgument(argc, argv, 4, threads, "ChessProject --import-pgn <file.pgn> [database] [threads]"))
+        return 1;
+    GameStorage storage;
+    if (!storage.open(name) || !storage.isWritable()) {
+        std::cerr << "The game database " << name << " could not be opened for writing." << std::endl;
+        return 1;
+    }
+    PgnImporter importer(threads);
+    PgnImportStats stats = importer.run(argv[2], storage);
+    if (stats.bytes == 0) {
+        std::cerr << "The PGN file " << argv[2] << " could not be read." << std::endl;
+        return 1;
+    }
+    stats.report(std::cerr);
+    std::cerr << storage.size() << " games in " << name << std::endl;
+    return 0;
+}
+
+/*
+ Writes a directory of saved games, or a game database, out as one PGN file:
+    ChessProject --export-pgn <directory or database> <file.pgn> [threads]
+ */
+static int exportPgn(int argc, const char * argv[]) {
+    int threads = 0;
+    if (!numberArgument(argc, argv, 4, threads, "ChessProject --export-pgn <directory or database> <file.pgn> [threads]"))
+        return 1;
+    PgnExporter exporter(threads);
+    PgnExportStats stats;
+    struct stat info;
+    if (stat(argv[2], &info) == 0 && S_ISDIR(info.st_mode)) {
+        stats = exporter.exportFiles(globalFunctions::listFiles(argv[2]), argv[3]);
+    } else {
+        GameStorage storage;
+        if (stat(argv[2], &info) != 0 || !storage.open(argv[2])) {
+            std::cerr << "The game database " << argv[2] << " could not be opened." << std::endl;
+            return 1;
+        }
+        stats = exporter.exportGames(storage, argv[3]);
+    }
+    if (stats.bytes == 0) {
+        std::cerr << "The PGN file " << argv[3] << " could not be written." << std::endl;
+        return 1;
+    }
+    std::cerr << "Exported " << stats.games << " games (" << stats.failed << " failed, " << stats.plies << " plies, "
+              << stats.bytes / (1024.0 * 1024.0) << " MB) in " << stats.seconds << " seconds ("
+              << (stats.seconds > 0 ? stats.games / stats.seconds : 0) << " games/sec, "
+              << (stats.seconds > 0 ? stats.plies / stats.seconds : 0) << " plies/sec)" << std::endl;
+    return stats.failed == 0 ? 0 : 1;
+}
+
+/*
+ Lists the games in a database matching a query, as described by GameQuery::parse:
+    ChessProject --query <database> "<query>" [threads]
+ such as "ending KRvKB" or "promotion 30".
+ */
+static int query(int argc, const char * argv[]) {
+    int threads = 0;
+    if (!numberArgument(argc, argv, 4, threads, "ChessProject --query <database> \"<query>\" [threads]"))
+        return 1;
+    PlyPredicate predicate;
+    int maxPly;
+    if (!GameQuery::parse(argv[3], predicate, maxPly)) {
+        std::cerr << "The query " << argv[3] << " could not be read." << std::endl;
+        return 1;
+    }
+    GameStorage storage;
+    struct stat info;
+    if (stat(argv[2], &info) != 0 || !storage.open(argv[2])) {
+        std::cerr << "The game database " << argv[2] << " could not be opened." << std::endl;
+        return 1;
+    }
+    GameQuery engine(threads);
+    std::vector<int> games = engine.findGames(storage, predicate, maxPly);
+    for (size_t i = 0; i < games.size() && i < 20; i++)
+        std::cout << games[i] << "\t" << storage.info(games[i]).name << std::endl;
+    if (games.size() > 20)
+        std::cout << "..." << std::endl;
+    const ScanStats& stats = engine.lastStats();
+    std::cerr << games.size() << " of " << stats.games << " games matched, " << stats.plies << " plies replayed in "
+              << stats.seconds << " seconds on " << engine.threads() << " threads (" << stats.gamesPerSecond() << " games/sec)" << std::endl;
+    return 0;
+}
+
+/*
+ Measures how small and how fast each game encoding is over a directory of saved games:
+    ChessProject --bench-codec <directory>
+ Games which can not be replayed as legal moves are counted but left out of the figures.
+ */
+static int benchCodec(const char * argv[]) {
+    std::vector<std::vector<Move>> games;
+    std::vector<std::string> files = globalFunctions::listFiles(argv[2]);
+    std::vector<Move> moves;
+    uint64_t plies = 0;
+    int skipped = 0;
+    for (auto it = files.begin(); it != files.end(); it++) {
+        std::vector<uint8_t> encoded;
+        if (!RAFile<Move>::readAll(*it, moves) || !GameCodec::encode(moves, MoveIndices, encoded)) {
+            skipped++;
+            continue;
+        }
+        games.push_back(moves);
+        plies += moves.size();
+    }
+    std::cout << games.size() << " games, " << plies << " plies, " << skipped << " skipped" << std::endl;
+    if (plies == 0)
+        return 1;
+    
+    const GameEncoding encodings[3] = {RawMoves, MoveIndices, RankedMoves};
+    const char* labels[3] = {"raw", "indices", "ranked"};
+    for (int e = 0; e < 3; e++) {
+        std::vector<std::vector<uint8_t>> encoded(games.size());
+        uint64_t bytes = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (size_t g = 0; g < games.size(); g++) {
+            GameCodec::encode(games[g], encodings[e], encoded[g]);
+            bytes += encoded[g].size();
+        }
+        double encodeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        
+        bool matched = true;
+        start = std::chrono::steady_clock::now();
+        for (size_t g = 0; g < games.size(); g++) {
+            matched = GameCodec::decode(encoded[g].data(), encoded[g].size(), (int)games[g].size(), encodings[e], moves) && matched;
+            matched = matched && moves.size() == games[g].size() && std::equal(moves.begin(), moves.end(), games[g].begin());
+        }
+        double decodeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        
+        std::cout << labels[e] << ": " << bytes << " bytes, " << bytes * 8.0 / plies << " bits/ply, "
+                  << (double)(plies * sizeof(Move)) / std::max<uint64_t>(bytes, 1) << "x smaller than raw, encode "
+                  << (encodeSeconds > 0 ? plies / encodeSeconds : 0) << " plies/sec, decode "
+                  << (decodeSeconds > 0 ? plies / decodeSeconds : 0) << " plies/sec" << (matched ? "" : ", DECODED GAMES DIFFER") << std::endl;
+        if (!matched)
+            return 1;
+    }
+    return 0;
+}
+
+/*
+ Writes every position of a game database to a training file:
+    ChessProject --dump-positions <database> <training file>
+ */
+static int dumpPositions(const char * argv[]) {
+    GameStorage storage;
+    TrainingWriter writer;
+    if (!storage.open(argv[2]) || !writer.open(argv[3])) {
+        std::cerr << "The database " << argv[2] << " could not be read, or " << argv[3] << " could not be created." << std::endl;
+        return 1;
+    }
+    auto start = std::chrono::steady_clock::now();
+    uint64_t added = writer.addGames(storage);
+    bool closed = writer.close();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cerr << added << " positions from " << storage.size() << " games in " << seconds << " seconds" << std::endl;
+    return closed ? 0 : 1;
+}
+
+/*
+ Measures how fast a trainer could read a training file, in shuffled batches and unpacked to squares:
+    ChessProject --bench-training <training file> [epochs] [batch size]
+ */
+static int benchTraining(int argc, const char * argv[]) {
+    int epochs = 10;
+    uint64_t batchSize = 16384;
+    const char* usage = "ChessProject --bench-training <training file> [epochs] [batch size]";
+    if (!numberArgument(argc, argv, 3, epochs, usage) || !numberArgument(argc, argv, 4, batchSize, usage))
+        return 1;
+    TrainingReader reader;
+    if (!reader.open(argv[2])) {
+        std::cerr << "The training file " << argv[2] << " could not be read." << std::endl;
+        return 1;
+    }
+    
+    std::vector<PackedPosition> batch(batchSize);
+    uint8_t squares[64];
+    uint64_t positions = 0, pieces = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int epoch = 0; epoch < epochs; epoch++) {
+        reader.startEpoch((uint64_t)epoch);
+        size_t got;
+        while ((got = reader.nextBatch(batch.data(), batch.size())) > 0) {
+            for (size_t i = 0; i < got; i++) {
+                batch[i].unpackSquares(squares);
+                pieces += squares[i % 64] != NoPiece;
+            }
+            positions += got;
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << positions << " positions in " << seconds << " seconds (" << (seconds > 0 ? positions / seconds * 60 : 0)
+              << " positions/minute" << (pieces == 0 ? ", none occupied" : "") << ")" << std::endl;
+    return 0;
+}
+
+/*
+ Builds an endgame table in the tablebases directory, along with the smaller tables it needs:
+    ChessProject --generate-tablebase <material> [threads]
+ such as KRKP, with white's pieces first.
+ */
+static int generateTablebase(int argc, const char * argv[]) {
+    int threads = 0;
+    if (!numberArgument(argc, argv, 3, threads, "ChessProject --generate-tablebase <material> [threads]"))
+        return 1;
+    return Tablebases::defaultTablebases()->generate(argv[2], threads, &std::cerr) ? 0 : 1;
+}
+
+/*
+ Looks a position up in the endgame tables:
+    ChessProject --probe-tablebase "<fen>"
+ */
+static int probeTablebase(const char * argv[]) {
+    Position pos;
+    if (!pos.setFromFen(argv[2])) {
+        std::cerr << "The position " << argv[2] << " could not be read." << std::endl;
+        return 1;
+    }
+    TablebaseResult result;
+    if (!Tablebases::defaultTablebases()->probe(pos, result)) {
+        std::cerr << "There is no table for this position." << std::endl;
+        return 1;
+    }
+    std::cout << Tablebases::describe(result, pos.isWhiteToMove()) << std::endl;
+    return 0;
+}
+
+/*
+ Runs commands without the menu, as described by UIManager::runCommands, from a file or standard input:
+    ChessProject --commands [file]
+ */
+static int runCommands(int argc, const char * argv[]) {
+    //Nothing is read from the console between answers, so the streams need not be kept in step
+    std::ios::sync_with_stdio(false);
+    UIManager manager;
+    if (argc < 3 || std::string(argv[2]) == "-")
+        return manager.runCommands(std::cin, std::cout) == 0 ? 0 : 1;
+    std::ifstream input(argv[2]);
+    if (!input.is_open()) {
+        std::cerr << "The command file " << argv[2] << " could not be read." << std::endl;
+        return 1;
+    }
+    return manager.runCommands(input, std::cout) == 0 ? 0 : 1;
+}
+
+/*
+ Answers position queries, as described by PositionService, from standard input or a Unix domain socket:
+    ChessProject --serve [socket|-] [threads]
+ */
+static int serve(int argc, const char * argv[]) {
+    int threads = 0;
+    if (!numberArgument(argc, argv, 3, threads, "ChessProject --serve [socket|-] [threads]"))
+        return 1;
+    PositionService service(threads);
+    if (argc < 3 || std::string(argv[2]) == "-") {
+        service.serveStream(0, 1);
+    } else {
+        std::cerr << "Serving on " << argv[2] << " with " << service.threads() << " threads." << std::endl;
+        if (!service.serveSocket(argv[2])) {
+            std::cerr << "The socket " << argv[2] << " could not be opened." << std::endl;
+            return 1;
+        }
+    }
+    ServiceStats stats = service.stats();
+    std::cerr << stats.requests << " requests (" << stats.errors << " errors) in " << stats.batches << " batches, "
+              << (uint64_t)stats.requestsPerSecond() << " per second." << std::endl;
+    return 0;
+}
+
+/*
+ Hosts games for clients of a Unix domain socket, as described by GameServer:
+    ChessProject --game-server <socket> [threads]
+ */
+static int gameServer(int argc, const char * argv[]) {
+    int threads = 0;
+    if (!numberArgument(argc, argv, 3, threads, "ChessProject --game-server <socket> [threads]"))
+        return 1;
+    GameServer server(threads);
+    std::cerr << "Hosting games on " << argv[2] << " with " << server.threads() << " threads." << std::endl;
+    if (!server.serve(argv[2])) {
+        std::cerr << "The socket " << argv[2] << " could not be opened." << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+/*
+ Plays random games against a game server, reporting how quickly moves were answered:
+    ChessProject --load-test <socket> [moves] [connections] [games per connection]
+ */
+static int loadTest(int argc, const char * argv[]) {
+    uint64_t moves = 100000;
+    int connections = 16, games = 64;
+    const char* usage = "ChessProject --load-test <socket> [moves] [connections] [games per connection]";
+    if (!numberArgument(argc, argv, 3, moves, usage) || !numberArgument(argc, argv, 4, connections, usage) ||
+        !numberArgument(argc, argv, 5, games, usage))
+        return 1;
+    LoadGenerator generator(connections, games);
+    LoadStats stats;
+    bool played = generator.run(argv[2], moves, stats);
+    std::cout << stats.moves << " moves (" << stats.errors << " refused) in " << stats.games << " games, "
+              << (uint64_t)stats.movesPerSecond() << " moves per second." << std::endl;
+    std::cout << "Answered in p50 " << stats.p50 << "us, p99 " << stats.p99 << "us, worst " << stats.worst << "us." << std::endl;
+    if (!played) {
+        std::cerr << "The game server at " << argv[2] << " could not be played against." << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+/*
+ Plays games against itself, many at once as coroutines on a few threads, optionally saving them:
+    ChessProject --self-play <games> [threads] [depth] [database]
+ Moves are random at depth 0, the default, and searched by the engine to the depth otherwise.
+ */
+static int selfPlay(int argc, const char * argv[]) {
+    int games = 0, threads = 0, depth = 0;
+    const char* usage = "ChessProject --self-play <games> [threads] [depth] [database]";
+    if (!numberArgument(argc, argv, 2, games, usage) || !numberArgument(argc, argv, 3, threads, usage) ||
+        !numberArgument(argc, argv, 4, depth, usage))
+        return 1;
+    GameStorage storage;
+    bool saving = argc > 5;
+    if (saving && (!storage.open(argv[5]) || !storage.isWritable())) {
+        std::cerr << "The database " << argv[5] << " could not be opened." << std::endl;
+        return 1;
+    }
+    
+    RandomMoveSource random;
+    SearchLimits limits;
+    limits.depth = depth;
+    EngineMoveSource engine(limits);
+    MoveSource& source = (depth > 0) ? (MoveSource&)engine : (MoveSource&)random;
+    
+    GameScheduler scheduler(threads);
+    std::mutex finishedLock;
+    uint64_t results[4] = {0, 0, 0, 0};
+    uint64_t plies = 0;
+    for (int g = 0; g < games; g++) {
+        GameTask task = playGame(source, source);
+        std::shared_ptr<std::vector<Move>> moves(saving ? new std::vector<Move>() : nullptr);
+        task.watch([&, moves, g](const GameUpdate& update) {
+            if (moves && update.plies > (int)moves->size())
+                moves->push_back(update.storedMove);
+            if (!update.over)
+                return;
+            std::lock_guard<std::mutex> guard(finishedLock);
+            results[update.result]++;
+            plies += (uint64_t)update.plies;
+            if (moves)
+                storage.addGame("Self-play " + std::to_string(g + 1), *moves, update.result);
+        });
+        scheduler.spawn(std::move(task));
+    }
+    
+    auto start = std::chrono::steady_clock::now();
+    scheduler.run();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (saving && !storage.commit(true)) {
+        std::cerr << "The games could not be saved to " << argv[5] << "." << std::endl;
+        return 1;
+    }
+    std::cout << games << " games on " << scheduler.threads() << " threads in " << seconds << " seconds ("
+              << (uint64_t)(seconds > 0 ? plies / seconds : 0) << " plies/sec): " << results[WhiteWins] << " white wins, "
+              << results[BlackWins] << " black wins, " << results[DrawnGame] << " drawn, " << results[ResultUnknown]
+              << " unfinished." << std::endl;
+    return 0;
+}
+
+int main(int argc, const char * argv[]) {
+    if (argc > 2 && std::string(argv[1]) == "--analyze")
+        return analyze(argc, argv);
+    if (argc > 1 && std::string(argv[1]) == "--bench-writes")
+        return benchWrites(argc, argv);
+    if (argc > 2 && std::string(argv[1]) == "--import-games")
+        return importGames(argc, argv);
+    if (argc > 2 && std::string(argv[1]) == "--import-pgn")
+        return importPgn(argc, argv);
+    if (argc > 3 && std::string(argv[1]) == "--export-pgn")
+        return exportPgn(argc, argv);
+    if (argc > 3 && std::string(argv[1]) == "--query")
+        return query(argc, argv);
+    if (argc > 2 && std::string(argv[1]) == "--bench-codec")
+        return benchCodec(argv);
+    if (argc > 3 && std::string(argv[1]) == "--dump-positions")
+        return dumpPositions(argv);
+    if (argc > 2 && std::string(argv[1]) == "--bench-training")
+        return benchTraining(argc, argv);
+    if (argc > 2 && std::string(argv[1]) == "--generate-tablebase")
+        return generateTablebase(argc, argv);
+    if (argc > 2 && std::string(argv[1]) == "--probe-tablebase")
+        return probeTablebase(argv);
+    if (argc > 1 && std::string(argv[1]) == "--commands")
+        return runCommands(argc, argv);
+    if (argc > 1 && std::string(argv[1]) == "--serve")
+        return serve(argc, argv);
+    if (argc > 2 && std::string(argv[1]) == "--game-server")
+        return gameServer(argc, argv);
+    if (argc > 2 && std::string(argv[1]) == "--load-test")
+        return loadTest(argc, argv);
+    if (argc > 2 && std::string(argv[1]) == "--self-play")
+        return selfPlay(argc, argv);
+    
     UIManager manager;
     globalFunctions::clearConsole();
     manager.menu();
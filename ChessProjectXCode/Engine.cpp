@@ -0,0 +1,532 @@
+#include "Engine.h"
+#include <thread>
+#include <chrono>
+#include <memory>
+#include <algorithm>
+
+static const int MaxPly = 128;
+static const int Infinity = MateScore + 1;
+
+//Move ordering bands, from the first moves tried to the last
+static const int TTMoveScore = 1 << 30;
+static const int CaptureScore = 1 << 24;
+static const int FirstKillerScore = (1 << 24) - 1;
+static const int SecondKillerScore = (1 << 24) - 2;
+static const int HistoryLimit = 1 << 20;
+
+/*
+ The state owned by one thread of a search. Nothing in here is shared, apart from the engine's
+ transposition table, stop flag and node counter.
+ */
+class SearchThread {
+public:
+    Engine& engine;
+    const SearchLimits& limits;
+    int id;
+    Position pos;
+    std::vector<CompactMove> rootMoves;
+    std::vector<uint64_t> keys;
+    int gameLength;
+    std::chrono::steady_clock::time_point start;
+
+    uint64_t nodes = 0;
+    uint64_t unreportedNodes = 0;
+    CompactMove killers[MaxPly][2];
+    int history[16][64];
+    CompactMove pv[MaxPly][MaxPly];
+    int pvLength[MaxPly];
+
+    //The result of the deepest iteration completed
+    int completedDepth = 0;
+    CompactMove bestMove;
+    int bestScore = 0;
+    std::vector<CompactMove> bestPv;
+
+    SearchThread(Engine& engine, const SearchLimits& limits, int id, const Position& root,
+                 const std::vector<CompactMove>& rootMoves, const std::vector<uint64_t>& history,
+                 std::chrono::steady_clock::time_point start)
+        : engine(engine), limits(limits), id(id), pos(root), rootMoves(rootMoves), keys(history), gameLength((int)history.size()), start(start) {
+        for (int i = 0; i < MaxPly; i++)
+            killers[i][0] = killers[i][1] = CompactMove();
+        for (int p = 0; p < 16; p++)
+            for (int sq = 0; sq < 64; sq++)
+                this->history[p][sq] = 0;
+    }
+
+    void iterate();
+    int searchRoot(int depth, int alpha, int beta, CompactMove& iterationBest);
+    int search(int alpha, int beta, int depth, int ply, bool pvNode, bool allowNull);
+    int quiesce(int alpha, int beta, int ply);
+
+    int scoreMove(CompactMove m, CompactMove ttMove, int ply) const;
+    void pickNext(MoveList& list, int* scores, int index) const;
+    bool checkStop();
+    bool isRepetition() const;
+    bool hasNonPawnMaterial() const;
+    void updatePv(int ply, CompactMove m);
+};
+
+//Mate scores are stored relative to the node, not the root, so they stay valid anywhere in the tree
+static int scoreToTable(int score, int ply) {
+    if (score > MateBound) return score + ply;
+    if (score < -MateBound) return score - ply;
+    return score;
+}
+
+static int scoreFromTable(int score, int ply) {
+    if (score > MateBound) return score - ply;
+    if (score < -MateBound) return score + ply;
+    return score;
+}
+
+bool SearchThread::checkStop() {
+    if (engine.stopFlag.load(std::memory_order_relaxed))
+        return true;
+    if ((nodes & 1023) != 0)
+        return false;
+
+    engine.sharedNodes += unreportedNodes;
+    unreportedNodes = 0;
+
+    //Only the main thread ends the search, so every helper sees the same stopping point
+    if (id != 0 || completedDepth == 0)
+        return false;
+    if (limits.nodes != 0 && engine.sharedNodes.load(std::memory_order_relaxed) >= limits.nodes)
+        engine.stopFlag = true;
+    if (limits.timeMs != 0 &&
+        std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count() >= limits.timeMs)
+        engine.stopFlag = true;
+    return engine.stopFlag.load(std::memory_order_relaxed);
+}
+
+bool SearchThread::isRepetition() const {
+    //Positions from before the root are only skipped when the clock shows a capture or pawn move since them
+    int end = (int)keys.size() - 1;
+    int limit = (pos.getHalfmoveClock() < end - gameLength) ? end - pos.getHalfmoveClock() : 0;
+    for (int i = end - 2; i >= limit; i -= 2)
+        if (keys[i] == keys[end])
+            return true;
+    return false;
+}
+
+bool SearchThread::hasNonPawnMaterial() const {
+    bool white = pos.isWhiteToMove();
+    for (int sq = 0; sq < 64; sq++) {
+        uint8_t p = pos.at(sq);
+        int type = Position::typeOf(p);
+        if (p != NoPiece && Position::isWhitePiece(p) == white && type != PawnType && type != KingType)
+            return true;
+    }
+    return false;
+}
+
+void SearchThread::updatePv(int ply, CompactMove m) {
+    pv[ply][ply] = m;
+    for (int i = ply + 1; i < pvLength[ply + 1]; i++)
+        pv[ply][i] = pv[ply + 1][i];
+    pvLength[ply] = std::max(pvLength[ply + 1], ply + 1);
+}
+
+/*
+ Orders moves: the table move, then captures by most valuable victim / least valuable attacker,
+ then the killer moves, then quiet moves by their history
+ */
+int SearchThread::scoreMove(CompactMove m, CompactMove ttMove, int ply) const {
+    if (m == ttMove)
+        return TTMoveScore;
+
+    uint8_t mover = pos.at(m.from());
+    uint8_t victim = pos.at(m.to());
+    if (m.special() == EnPassant)
+        victim = WhitePawn;
+    if (victim != NoPiece || m.promotionType() == QueenType) {
+        int victimValue = (victim != NoPiece) ? Evaluation::pieceValue(Position::typeOf(victim)) : 0;
+        if (m.promotionType() == QueenType)
+            victimValue += Evaluation::pieceValue(QueenType);
+        return CaptureScore + victimValue * 8 - Position::typeOf(mover);
+    }
+
+    if (m == killers[ply][0])
+        return FirstKillerScore;
+    if (m == killers[ply][1])
+        return SecondKillerScore;
+    return history[mover][m.to()];
+}
+
+//Moves the best scored remaining move to index, so moves are sorted only as far as they are searched
+void SearchThread::pickNext(MoveList& list, int* scores, int index) const {
+    int best = index;
+    for (int i = index + 1; i < list.count; i++)
+        if (scores[i] > scores[best])
+            best = i;
+    if (best != index) {
+        std::swap(list.moves[index], list.moves[best]);
+        std::swap(scores[index], scores[best]);
+    }
+}
+
+int SearchThread::quiesce(int alpha, int beta, int ply) {
+    nodes++;
+    unreportedNodes++;
+    pvLength[ply] = ply;
+    if (checkStop())
+        return 0;
+
+    bool inCheck = pos.inCheck();
+    if (ply >= MaxPly - 1)
+        return Evaluation::evaluateForSideToMove(pos, engine.weights);
+
+    //Standing pat is only allowed when we are not forced to answer a check
+    if (!inCheck) {
+        int standPat = Evaluation::evaluateForSideToMove(pos, engine.weights);
+        if (standPat >= beta)
+            return standPat;
+        if (standPat > alpha)
+            alpha = standPat;
+    }
+
+    MoveList list;
+    if (inCheck)
+        pos.generatePseudoLegalMoves(list);
+    else
+        pos.generateCaptures(list);
+
+    int scores[256];
+    for (int i = 0; i < list.count; i++)
+        scores[i] = scoreMove(list[i], CompactMove(), ply);
+
+    bool mover = pos.isWhiteToMove();
+    int legalMoves = 0;
+    for (int i = 0; i < list.count; i++) {
+        pickNext(list, scores, i);
+        CompactMove m = list[i];
+        UndoInfo undo;
+        pos.makeMove(m, undo);
+        if (pos.isAttacked(pos.kingLocation(mover), !mover)) {
+            pos.unmakeMove(m, undo);
+            continue;
+        }
+        legalMoves++;
+        int score = -quiesce(-beta, -alpha, ply + 1);
+        pos.unmakeMove(m, undo);
+
+        if (engine.stopFlag.load(std::memory_order_relaxed))
+            return 0;
+        if (score > alpha) {
+            alpha = score;
+            if (score >= beta)
+                return score;
+        }
+    }
+
+    if (inCheck && legalMoves == 0)
+        return -MateScore + ply;
+    return alpha;
+}
+
+/*
+ Principal variation search
+ alpha, beta - the window
+ depth - the remaining depth
+ ply - the distance from the root
+ pvNode - whether this node is on the principal variation, and so searched with a full window
+ allowNull - whether a null move may be tried here
+ */
+int SearchThread::search(int alpha, int beta, int depth, int ply, bool pvNode, bool allowNull) {
+    if (depth <= 0)
+        return quiesce(alpha, beta, ply);
+
+    nodes++;
+    unreportedNodes++;
+    pvLength[ply] = ply;
+    if (checkStop())
+        return 0;
+
+    if (isRepetition() || pos.getHalfmoveClock() >= 100)
+        return 0;
+    if (ply >= MaxPly - 1)
+        return Evaluation::evaluateForSideToMove(pos, engine.weights);
+
+    //Mate distance pruning: no line from here can beat a mate already found nearer the root
+    alpha = std::max(alpha, -MateScore + ply);
+    beta = std::min(beta, MateScore - ply - 1);
+    if (alpha >= beta)
+        return alpha;
+
+    TTEntry entry;
+    CompactMove ttMove;
+    if (engine.table.probe(pos.key(), entry)) {
+        ttMove = entry.move;
+        int score = scoreFromTable(entry.score, ply);
+        if (!pvNode && entry.depth >= depth &&
+            (entry.bound == ExactBound ||
+             (entry.bound == LowerBound && score >= beta) ||
+             (entry.bound == UpperBound && score <= alpha)))
+            return score;
+    }
+
+    bool inCheck = pos.inCheck();
+    if (inCheck)
+        depth++;
+
+    //Null move pruning: if passing still fails high, a real move almost certainly would too
+    if (allowNull && !pvNode && !inCheck && depth >= 3 && hasNonPawnMaterial() &&
+        Evaluation::evaluateForSideToMove(pos, engine.weights) >= beta) {
+        int reduction = 2 + depth / 4;
+        UndoInfo undo;
+        pos.makeNullMove(undo);
+        keys.push_back(pos.key());
+        int score = -search(-beta, -beta + 1, depth - 1 - reduction, ply + 1, false, false);
+        keys.pop_back();
+        pos.unmakeNullMove(undo);
+        if (engine.stopFlag.load(std::memory_order_relaxed))
+            return 0;
+        if (score >= beta)
+            return (score > MateBound) ? beta : score;
+    }
+
+    MoveList list;
+    pos.generatePseudoLegalMoves(list);
+    int scores[256];
+    for (int i = 0; i < list.count; i++)
+        scores[i] = scoreMove(list[i], ttMove, ply);
+
+    bool mover = pos.isWhiteToMove();
+    int originalAlpha = alpha;
+    int bestScore = -Infinity;
+    CompactMove bestMove;
+    int legalMoves = 0;
+
+    for (int i = 0; i < list.count; i++) {
+        pickNext(list, scores, i);
+        CompactMove m = list[i];
+        bool quiet = pos.at(m.to()) == NoPiece && !m.isPromotion() && m.special() != EnPassant;
+        bool isKiller = m == killers[ply][0] || m == killers[ply][1];
+
+        UndoInfo undo;
+        pos.makeMove(m, undo);
+        if (pos.isAttacked(pos.kingLocation(mover), !mover)) {
+            pos.unmakeMove(m, undo);
+            continue;
+        }
+        legalMoves++;
+        keys.push_back(pos.key());
+
+        int score;
+        if (legalMoves == 1) {
+            score = -search(-beta, -alpha, depth - 1, ply + 1, pvNode, true);
+        } else {
+            //Late quiet moves are searched shallower first, and only searched fully if they surprise us
+            int reduction = 0;
+            if (quiet && !isKiller && !inCheck && depth >= 3 && legalMoves > 3 && !pos.inCheck())
+                reduction = (legalMoves > 8) ? 2 : 1;
+
+            score = -search(-alpha - 1, -alpha, depth - 1 - reduction, ply + 1, false, true);
+            if (score > alpha && reduction > 0)
+                score = -search(-alpha - 1, -alpha, depth - 1, ply + 1, false, true);
+            if (score > alpha && score < beta && pvNode)
+                score = -search(-beta, -alpha, depth - 1, ply + 1, true, true);
+        }
+
+        keys.pop_back();
+        pos.unmakeMove(m, undo);
+
+        if (engine.stopFlag.load(std::memory_order_relaxed))
+            return 0;
+
+        if (score > bestScore) {
+            bestScore = score;
+            bestMove = m;
+            if (score > alpha) {
+                alpha = score;
+                if (pvNode)
+                    updatePv(ply, m);
+                if (score >= beta) {
+                    if (quiet) {
+                        if (killers[ply][0] != m) {
+                            killers[ply][1] = killers[ply][0];
+                            killers[ply][0] = m;
+                        }
+                        int& h = history[pos.at(m.from())][m.to()];
+                        h += depth * depth;
+                        if (h > HistoryLimit)
+                            for (int p = 0; p < 16; p++)
+                                for (int sq = 0; sq < 64; sq++)
+                                    history[p][sq] /= 2;
+                    }
+                    break;
+                }
+            }
+        }
+    }
+
+    if (legalMoves == 0)
+        return inCheck ? -MateScore + ply : 0;
+
+    Bound bound = (bestScore >= beta) ? LowerBound : (alpha > originalAlpha ? ExactBound : UpperBound);
+    engine.table.store(pos.key(), bestMove, scoreToTable(bestScore, ply), depth, bound);
+    return bestScore;
+}
+
+/*
+ Searches the root moves. Unlike search, a move which completes before the search is stopped is
+ still reported, so a stopped iteration can improve on the one before it.
+ */
+int SearchThread::searchRoot(int depth, int alpha, int beta, CompactMove& iterationBest) {
+    pvLength[0] = 0;
+    TTEntry entry;
+    CompactMove ttMove = (completedDepth > 0) ? bestMove : CompactMove();
+    if (ttMove.isNull() && engine.table.probe(pos.key(), entry))
+        ttMove = entry.move;
+
+    MoveList list;
+    list.count = 0;
+    for (auto it = rootMoves.begin(); it != rootMoves.end(); it++)
+        list.add(*it);
+    int scores[256];
+    for (int i = 0; i < list.count; i++)
+        scores[i] = scoreMove(list[i], ttMove, 0);
+
+    //Helpers try the root moves in a rotated order, so they do not all start on the same subtree
+    if (id > 0 && list.count > 1) {
+        for (int i = 0; i < list.count; i++)
+            if (scores[i] != TTMoveScore)
+                scores[i] -= (i + id) % list.count;
+    }
+
+    int bestScore = -Infinity;
+    for (int i = 0; i < list.count; i++) {
+        pickNext(list, scores, i);
+        CompactMove m = list[i];
+        UndoInfo undo;
+        pos.makeMove(m, undo);
+        keys.push_back(pos.key());
+
+        int score;
+        if (i == 0) {
+            score = -search(-beta, -alpha, depth - 1, 1, true, true);
+        } else {
+            score = -search(-alpha - 1, -alpha, depth - 1, 1, false, true);
+            if (score > alpha && score < beta)
+                score = -search(-beta, -alpha, depth - 1, 1, true, true);
+        }
+
+        keys.pop_back();
+        pos.unmakeMove(m, undo);
+
+        if (engine.stopFlag.load(std::memory_order_relaxed))
+            break;
+
+        if (score > bestScore) {
+            bestScore = score;
+            iterationBest = m;
+            if (score > alpha) {
+                alpha = score;
+                updatePv(0, m);
+            }
+        }
+    }
+
+    if (!iterationBest.isNull() && !engine.stopFlag.load(std::memory_order_relaxed))
+        engine.table.store(pos.key(), iterationBest, scoreToTable(bestScore, 0), depth, ExactBound);
+    return bestScore;
+}
+
+/*
+ Iterative deepening. Helper threads start one ply deeper on odd ids, so at any moment the
+ threads are spread over two depths.
+ */
+void SearchThread::iterate() {
+    keys.push_back(pos.key());
+    int startDepth = 1 + ((id > 0) ? (id & 1) : 0);
+
+    for (int depth = startDepth; depth <= limits.depth && depth < MaxPly; depth++) {
+        CompactMove iterationBest;
+        int score = searchRoot(depth, -Infinity, Infinity, iterationBest);
+
+        bool stopped = engine.stopFlag.load(std::memory_order_relaxed);
+        if (iterationBest.isNull())
+            break;
+
+        //A stopped iteration is only trusted if it found a better move than the last one finished
+        if (!stopped || completedDepth == 0 || score > bestScore) {
+            bestMove = iterationBest;
+            bestScore = score;
+            bestPv.assign(pv[0], pv[0] + pvLength[0]);
+            if (bestPv.empty() || bestPv[0] != bestMove)
+                bestPv.assign(1, bestMove);
+        }
+        if (stopped)
+            break;
+        completedDepth = depth;
+
+        //There is no point looking deeper once a forced mate has been found
+        if (id == 0 && (score > MateBound || score < -MateBound))
+            break;
+    }
+
+    engine.sharedNodes += unreportedNodes;
+    unreportedNodes = 0;
+    if (id == 0)
+        engine.stopFlag = true;
+}
+
+Engine::Engine(size_t hashMegabytes) : table(hashMegabytes), weights(Evaluation::defaultWeights()), stopFlag(false), sharedNodes(0) {
+}
+
+void Engine::newGame() {
+    table.clear();
+}
+
+/*
+ Runs a Lazy SMP search: the main thread and its helpers all search the root, and the main
+ thread's result is returned once it runs out of depth, time or nodes.
+ root - the position to search
+ limits - the budget for the search
+ rootMoves - if not empty, the only moves considered at the root
+ history - keys of the positions earlier in the game
+ */
+SearchResult Engine::search(const Position& root, const SearchLimits& limits,
+                            const std::vector<CompactMove>& rootMoves, const std::vector<uint64_t>& history) {
+    SearchResult result;
+    auto start = std::chrono::steady_clock::now();
+
+    Position pos = root;
+    MoveList legal;
+    pos.generateLegalMoves(legal);
+    std::vector<CompactMove> moves;
+    for (int i = 0; i < legal.count; i++)
+        if (rootMoves.empty() || std::find(rootMoves.begin(), rootMoves.end(), legal[i]) != rootMoves.end())
+            moves.push_back(legal[i]);
+    if (moves.empty())
+        return result;
+
+    int threadCount = (limits.threads > 0) ? limits.threads : (int)std::thread::hardware_concurrency();
+    if (threadCount < 1)
+        threadCount = 1;
+
+    stopFlag = false;
+    sharedNodes = 0;
+    table.newSearch();
+
+    std::vector<std::unique_ptr<SearchThread>> threads;
+    for (int i = 0; i < threadCount; i++)
+        threads.push_back(std::unique_ptr<SearchThread>(new SearchThread(*this, limits, i, pos, moves, history, start)));
+
+    std::vector<std::thread> helpers;
+    for (int i = 1; i < threadCount; i++)
+        helpers.push_back(std::thread(&SearchThread::iterate, threads[i].get()));
+    threads[0]->iterate();
+    for (auto it = helpers.begin(); it != helpers.end(); it++)
+        it->join();
+
+    SearchThread& main = *threads[0];
+    result.best = main.bestMove.isNull() ? moves[0] : main.bestMove;
+    result.score = main.bestScore;
+    result.depth = main.completedDepth;
+    result.pv = main.bestPv;
+    for (auto it = threads.begin(); it != threads.end(); it++)
+        result.nodes += (*it)->nodes;
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
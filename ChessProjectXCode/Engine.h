@@ -0,0 +1,79 @@
+#ifndef Engine_H
+#define Engine_H
+
+#include "Position.h"
+#include "Evaluation.h"
+#include "TranspositionTable.h"
+#include <atomic>
+#include <vector>
+#include <stdint.h>
+
+//Scores at or beyond MateBound are mates, MateScore - n being mate in n plies
+const int MateScore = 32000;
+const int MateBound = MateScore - 256;
+
+//How long the computer may think. A limit of 0 means no limit of that kind
+struct SearchLimits {
+    int timeMs = 0;
+    uint64_t nodes = 0;
+    int depth = 64;
+    int threads = 0;        //0 uses every core
+};
+
+//The outcome of a search
+struct SearchResult {
+    CompactMove best;
+    int score = 0;              //From the point of view of the side to move
+    int depth = 0;              //Deepest iteration completed
+    uint64_t nodes = 0;         //Summed over all threads
+    double seconds = 0;
+    std::vector<CompactMove> pv;
+
+    double nodesPerSecond() const {
+        return seconds > 0 ? nodes / seconds : 0;
+    }
+};
+
+class SearchThread;
+
+/*
+ The computer opponent. Searches with iterative deepening principal variation alpha-beta and a
+ quiescence search, and scales across cores with Lazy SMP: every thread searches the same root,
+ sharing only the transposition table, and the threads' differing move orders and depths spread
+ the work out between them.
+ */
+class Engine {
+private:
+    TranspositionTable table;
+    EvalWeights weights;
+    std::atomic<bool> stopFlag;
+    std::atomic<uint64_t> sharedNodes;
+
+    friend class SearchThread;
+
+public:
+
+    Engine(size_t hashMegabytes = 64);
+
+    //Forgets everything learned in earlier searches
+    void newGame();
+
+    //Uses different evaluation weights from the defaults
+    void setWeights(const EvalWeights& w) {
+        weights = w;
+    }
+
+    //Searches the position within the limits.
+    //rootMoves - if not empty, only these moves are considered at the root
+    //history - keys of the positions earlier in the game, for spotting repetitions
+    SearchResult search(const Position& root, const SearchLimits& limits,
+                        const std::vector<CompactMove>& rootMoves = std::vector<CompactMove>(),
+                        const std::vector<uint64_t>& history = std::vector<uint64_t>());
+
+    //Asks a running search to stop as soon as it can
+    void stop() {
+        stopFlag = true;
+    }
+};
+
+#endif
@@ -0,0 +1,131 @@
+#include "Evaluation.h"
+#include <fstream>
+
+EvalWeights::EvalWeights() {
+    for (int i = 0; i < count; i++)
+        values[i] = 0;
+
+    //Same values as the piece headers, in centipawns. The king is never traded so it has none
+    values[materialOffset + PawnType - 1] = 100;
+    values[materialOffset + KnightType - 1] = 300;
+    values[materialOffset + BishopType - 1] = 300;
+    values[materialOffset + RookType - 1] = 500;
+    values[materialOffset + QueenType - 1] = 900;
+
+    //A little credit for active pieces, so the computer develops rather than shuffling pawns
+    values[mobilityOffset + KnightType - 1] = 4;
+    values[mobilityOffset + BishopType - 1] = 4;
+    values[mobilityOffset + RookType - 1] = 2;
+    values[mobilityOffset + QueenType - 1] = 1;
+}
+
+/*
+ Reads weights written by save. The file holds one labelled line for material and mobility, and
+ one line per piece type for the piece square tables.
+ fileName - the file to read
+ */
+bool EvalWeights::load(std::string fileName) {
+    std::ifstream input(fileName);
+    if (!input.is_open())
+        return false;
+
+    EvalWeights read;
+    std::string label;
+    int type;
+
+    input >> label;
+    if (label != "material")
+        return false;
+    for (int i = 0; i < 6; i++)
+        input >> read.values[materialOffset + i];
+
+    for (int t = 0; t < 6; t++) {
+        input >> label >> type;
+        if (label != "pst" || type != t + 1)
+            return false;
+        for (int sq = 0; sq < 64; sq++)
+            input >> read.values[pstOffset + t * 64 + sq];
+    }
+
+    input >> label;
+    if (label != "mobility")
+        return false;
+    for (int i = 0; i < 6; i++)
+        input >> read.values[mobilityOffset + i];
+
+    if (input.fail())
+        return false;
+    *this = read;
+    return true;
+}
+
+bool EvalWeights::save(std::string fileName) const {
+    std::ofstream output(fileName);
+    if (!output.is_open())
+        return false;
+
+    output << "material";
+    for (int i = 0; i < 6; i++)
+        output << ' ' << values[materialOffset + i];
+    output << '\n';
+
+    for (int t = 0; t < 6; t++) {
+        output << "pst " << t + 1;
+        for (int sq = 0; sq < 64; sq++)
+            output << ((sq % 8 == 0) ? "\n " : " ") << values[pstOffset + t * 64 + sq];
+        output << '\n';
+    }
+
+    output << "mobility";
+    for (int i = 0; i < 6; i++)
+        output << ' ' << values[mobilityOffset + i];
+    output << '\n';
+
+    return !output.fail();
+}
+
+//FNV-1a over the weights in order
+uint64_t EvalWeights::fingerprint() const {
+    uint64_t hash = 14695981039346656037ULL;
+    for (int i = 0; i < count; i++) {
+        hash ^= (uint32_t)values[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+const EvalWeights& Evaluation::defaultWeights() {
+    static EvalWeights weights;
+    static bool loaded = weights.load("weights.txt");
+    (void)loaded;
+    return weights;
+}
+
+/*
+ Scores a position as material, plus piece square tables, plus mobility for each side
+ pos - the position to score
+ weights - the weights to score it with
+ */
+int Evaluation::evaluate(const Position& pos, const EvalWeights& weights) {
+    int score = 0;
+    for (int sq = 0; sq < 64; sq++) {
+        uint8_t p = pos.at(sq);
+        if (p == NoPiece)
+            continue;
+        int type = Position::typeOf(p);
+        bool white = Position::isWhitePiece(p);
+
+        //Tables are written from white's side, so black pieces read them mirrored
+        int value = weights.material(type) + weights.pst(type, white ? sq : (sq ^ 56));
+        if (type != PawnType)
+            value += weights.mobility(type) * pos.mobility(sq);
+
+        score += white ? value : -value;
+    }
+    return score;
+}
+
+int Evaluation::pieceValue(int type) {
+    //The king is given a large value so that capturing with it sorts last
+    return (type == KingType) ? 10000 : defaultWeights().material(type);
+}
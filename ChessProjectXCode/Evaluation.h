@@ -0,0 +1,58 @@
+#ifndef Evaluation_H
+#define Evaluation_H
+
+#include "Position.h"
+#include <string>
+
+/*
+ The weights used by the static evaluation, in centipawns. Every weight is a plain integer in one
+ array so the tuner can treat them as a single parameter vector.
+ Layout: material[6], piece square tables[6][64] (from white's side of the board), mobility[6],
+ each indexed by PieceType - 1.
+ */
+class EvalWeights {
+public:
+    static const int materialOffset = 0;
+    static const int pstOffset = 6;
+    static const int mobilityOffset = pstOffset + 6 * 64;
+    static const int count = mobilityOffset + 6;
+
+    int values[count];
+
+    //Starts from the hand tuned piece values in the piece headers, with flat tables and a small mobility bonus
+    EvalWeights();
+
+    int material(int type) const { return values[materialOffset + type - 1]; }
+    int pst(int type, int sq) const { return values[pstOffset + (type - 1) * 64 + sq]; }
+    int mobility(int type) const { return values[mobilityOffset + type - 1]; }
+
+    //Reads / writes the weights as a text file, returning false if it could not be done
+    bool load(std::string fileName);
+    bool save(std::string fileName) const;
+
+    //A hash of every weight, to tell whether scores kept from an earlier run were made with these weights
+    uint64_t fingerprint() const;
+};
+
+class Evaluation {
+public:
+    //The weights used by default, loaded from weights.txt if the tuner has written one
+    static const EvalWeights& defaultWeights();
+
+    //Static evaluation in centipawns, positive when white is better
+    static int evaluate(const Position& pos, const EvalWeights& weights);
+    static int evaluate(const Position& pos) {
+        return evaluate(pos, defaultWeights());
+    }
+
+    //Static evaluation from the point of view of the side to move
+    static int evaluateForSideToMove(const Position& pos, const EvalWeights& weights) {
+        int score = evaluate(pos, weights);
+        return pos.isWhiteToMove() ? score : -score;
+    }
+
+    //The material value of a piece type under the default weights, used for ordering captures
+    static int pieceValue(int type);
+};
+
+#endif
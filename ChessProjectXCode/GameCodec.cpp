@@ -0,0 +1,318 @@
+#include "GameCodec.h"
+#include <algorithm>
+#include <string.h>
+
+//Piece values for ordering moves. They are fixed here rather than read from the tuned weights, which
+//would change the order, and so the meaning of every stored game, whenever the weights were tuned
+static const int orderValues[7] = {0, 100, 320, 330, 500, 900, 2000};
+
+//The range coder's model covers every rank a legal move can have
+static const int rankCount = 256;
+//Added to a rank's frequency each time it is used, and the limit the total is halved at to stay in range
+static const int rankIncrement = 24;
+static const uint32_t rankLimit = 1 << 16;
+
+//The range coder keeps its range between these, writing a byte whenever the top byte is settled
+static const uint32_t coderTop = 1 << 24;
+static const uint32_t coderBottom = 1 << 16;
+
+//How close the square is to the centre, 0 on the edge to 3 in the middle
+static int centrality(int sq) {
+    int x = Position::fileOf(sq), y = Position::rankOf(sq);
+    return std::min(std::min(x, 7 - x), std::min(y, 7 - y));
+}
+
+/*
+ Numbers the legal moves. MoveIndices sorts them by their packed value alone. RankedMoves puts promotions
+ and captures first, most valuable victim and least valuable attacker first, then castling, then quiet
+ moves which bring a piece towards the centre, with the packed value breaking ties.
+ */
+void GameCodec::orderMoves(Position& pos, GameEncoding encoding, MoveList& list) {
+    pos.generateLegalMoves(list);
+    if (encoding != RankedMoves) {
+        std::sort(list.moves, list.moves + list.count, [](CompactMove a, CompactMove b) { return a.data < b.data; });
+        return;
+    }
+
+    int keys[256];
+    int order[256];
+    for (int i = 0; i < list.count; i++) {
+        CompactMove m = list[i];
+        int mover = Position::typeOf(pos.at(m.from()));
+        int victim = (m.special() == EnPassant) ? PawnType : Position::typeOf(pos.at(m.to()));
+        int key;
+        if (victim != 0 || m.isPromotion())
+            key = 100000 + orderValues[victim] * 8 + orderValues[m.promotionType()] * 8 - mover;
+        else if (m.isCastle())
+            key = 50000;
+        else
+            key = 10000 + (centrality(m.to()) - centrality(m.from())) * 100 + (mover == PawnType ? 50 : 0) - mover;
+        keys[i] = key;
+        order[i] = i;
+    }
+    std::sort(order, order + list.count, [&](int a, int b) {
+        return keys[a] != keys[b] ? keys[a] > keys[b] : list[a].data < list[b].data;
+    });
+    CompactMove sorted[256];
+    for (int i = 0; i < list.count; i++)
+        sorted[i] = list[order[i]];
+    memcpy(list.moves, sorted, list.count * sizeof(CompactMove));
+}
+
+//An adaptive count of how often each rank has been coded, starting from a guess that low ranks are likely
+struct RankModel {
+    uint16_t frequency[rankCount];
+    uint32_t total = 0;
+
+    RankModel() {
+        for (int r = 0; r < rankCount; r++) {
+            frequency[r] = (uint16_t)(1 + 32 / (r + 1));
+            total += frequency[r];
+        }
+    }
+
+    void update(int rank) {
+        frequency[rank] += rankIncrement;
+        total += rankIncrement;
+        if (total >= rankLimit) {
+            total = 0;
+            for (int r = 0; r < rankCount; r++) {
+                frequency[r] = (uint16_t)((frequency[r] + 1) / 2);
+                total += frequency[r];
+            }
+        }
+    }
+};
+
+//Writes bits from the least significant end of each byte
+struct BitWriter {
+    std::vector<uint8_t>& out;
+    uint32_t buffer = 0;
+    int used = 0;
+
+    BitWriter(std::vector<uint8_t>& out) : out(out) { }
+
+    void write(uint32_t value, int bits) {
+        buffer |= value << used;
+        used += bits;
+        while (used >= 8) {
+            out.push_back((uint8_t)buffer);
+            buffer >>= 8;
+            used -= 8;
+        }
+    }
+    void finish() {
+        if (used > 0)
+            out.push_back((uint8_t)buffer);
+    }
+};
+
+struct BitReader {
+    const uint8_t* data;
+    size_t bytes;
+    size_t position = 0;
+    uint32_t buffer = 0;
+    int available = 0;
+
+    BitReader(const uint8_t* data, size_t bytes) : data(data), bytes(bytes) { }
+
+    bool read(int bits, uint32_t& value) {
+        while (available < bits) {
+            if (position == bytes)
+                return false;
+            buffer |= (uint32_t)data[position++] << available;
+            available += 8;
+        }
+        value = buffer & ((1u << bits) - 1);
+        buffer >>= bits;
+        available -= bits;
+        return true;
+    }
+};
+
+//A carryless range coder: the range is renormalised a byte at a time, and narrowed when it straddles a byte
+//boundary so no carry can ever reach a byte already written
+struct RangeEncoder {
+    std::vector<uint8_t>& out;
+    uint32_t low = 0;
+    uint32_t range = 0xFFFFFFFF;
+
+    RangeEncoder(std::vector<uint8_t>& out) : out(out) { }
+
+    void encode(uint32_t start, uint32_t size, uint32_t total) {
+        range /= total;
+        low += start * range;
+        range *= size;
+        while ((low ^ (low + range)) < coderTop || (range < coderBottom && ((range = -low & (coderBottom - 1)), true))) {
+            out.push_back((uint8_t)(low >> 24));
+            low <<= 8;
+            range <<= 8;
+        }
+    }
+    void finish() {
+        for (int i = 0; i < 4; i++) {
+            out.push_back((uint8_t)(low >> 24));
+            low <<= 8;
+        }
+    }
+};
+
+struct RangeDecoder {
+    const uint8_t* data;
+    size_t bytes;
+    size_t position = 0;
+    uint32_t low = 0;
+    uint32_t range = 0xFFFFFFFF;
+    uint32_t code = 0;
+
+    RangeDecoder(const uint8_t* data, size_t bytes) : data(data), bytes(bytes) {
+        for (int i = 0; i < 4; i++)
+            code = (code << 8) | next();
+    }
+
+    //Bytes past the end read as zero, and a game which needs them fails its other checks
+    uint32_t next() {
+        return (position < bytes) ? data[position++] : 0;
+    }
+
+    //The count the next symbol falls at, which is past the total if the data is corrupt
+    uint32_t peek(uint32_t total) {
+        range /= total;
+        return (code - low) / range;
+    }
+    void consume(uint32_t start, uint32_t size) {
+        low += start * range;
+        range *= size;
+        while ((low ^ (low + range)) < coderTop || (range < coderBottom && ((range = -low & (coderBottom - 1)), true))) {
+            code = (code << 8) | next();
+            low <<= 8;
+            range <<= 8;
+        }
+    }
+};
+
+//The number of bits needed to write any index below count
+static int indexBits(int count) {
+    int bits = 0;
+    while ((1 << bits) < count)
+        bits++;
+    return bits;
+}
+
+/*
+ Replays the game, writing where each move falls in the ordered legal moves. A position with one legal move
+ writes nothing, as the decoder can work it out for itself.
+ moves - the game
+ encoding - how to write it
+ out - replaced with the encoded game
+ */
+bool GameCodec::encode(const std::vector<Move>& moves, GameEncoding encoding, std::vector<uint8_t>& out) {
+    out.clear();
+    if (encoding == RawMoves) {
+        out.resize(moves.size() * sizeof(Move));
+        if (!moves.empty())
+            memcpy(out.data(), moves.data(), out.size());
+        return true;
+    }
+
+    Position pos;
+    pos.reset();
+    MoveList list;
+    RankModel model;
+    BitWriter bits(out);
+    RangeEncoder coder(out);
+
+    for (auto it = moves.begin(); it != moves.end(); it++) {
+        CompactMove m = pos.fromStoredMove(*it);
+        //Only moves which come back exactly as they were stored can be numbered
+        if (m.isNull() || !(pos.toStoredMove(m) == *it))
+            return false;
+        orderMoves(pos, encoding, list);
+        int index = 0;
+        while (index < list.count && list[index] != m)
+            index++;
+        if (index == list.count)
+            return false;
+
+        if (list.count > 1) {
+            if (encoding == MoveIndices) {
+                bits.write(index, indexBits(list.count));
+            } else {
+                uint32_t start = 0, total = 0;
+                for (int r = 0; r < list.count; r++) {
+                    if (r == index)
+                        start = total;
+                    total += model.frequency[r];
+                }
+                coder.encode(start, model.frequency[index], total);
+                model.update(index);
+            }
+        }
+        UndoInfo undo;
+        pos.makeMove(m, undo);
+    }
+
+    if (encoding == MoveIndices)
+        bits.finish();
+    else
+        coder.finish();
+    return true;
+}
+
+bool GameCodec::decode(const uint8_t* data, size_t bytes, int plies, GameEncoding encoding, std::vector<Move>& moves) {
+    moves.clear();
+    if (encoding == RawMoves) {
+        if (bytes != (size_t)plies * sizeof(Move))
+            return false;
+        moves.resize(plies);
+        if (plies > 0)
+            memcpy(static_cast<void*>(moves.data()), data, bytes);
+        return true;
+    }
+    if (encoding != MoveIndices && encoding != RankedMoves)
+        return false;
+
+    Position pos;
+    pos.reset();
+    MoveList list;
+    RankModel model;
+    BitReader bits(data, bytes);
+    RangeDecoder coder(data, bytes);
+    moves.reserve(plies);
+
+    for (int ply = 0; ply < plies; ply++) {
+        orderMoves(pos, encoding, list);
+        if (list.count == 0)
+            return false;
+
+        int index = 0;
+        if (list.count > 1) {
+            if (encoding == MoveIndices) {
+                uint32_t value;
+                if (!bits.read(indexBits(list.count), value) || (int)value >= list.count)
+                    return false;
+                index = (int)value;
+            } else {
+                uint32_t total = 0;
+                for (int r = 0; r < list.count; r++)
+                    total += model.frequency[r];
+                uint32_t target = coder.peek(total);
+                if (target >= total)
+                    return false;
+                uint32_t start = 0;
+                while (start + model.frequency[index] <= target) {
+                    start += model.frequency[index];
+                    index++;
+                }
+                coder.consume(start, model.frequency[index]);
+                model.update(index);
+            }
+        }
+
+        CompactMove m = list[index];
+        moves.push_back(pos.toStoredMove(m));
+        UndoInfo undo;
+        pos.makeMove(m, undo);
+    }
+    return true;
+}
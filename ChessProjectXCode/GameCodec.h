@@ -0,0 +1,39 @@
+#ifndef GameCodec_H
+#define GameCodec_H
+
+#include "Position.h"
+#include "Move.h"
+#include <vector>
+#include <stdint.h>
+
+//The ways a game's moves can be written
+enum GameEncoding : uint8_t {
+    RawMoves = 0,       //Each Move as it is held in memory, 16 bytes a ply
+    MoveIndices = 1,    //Each move's index among the legal moves, in as few bits as the count of legal moves needs
+    RankedMoves = 2     //Each move's rank among the legal moves ordered likeliest first, arithmetic coded
+};
+
+/*
+ Compresses games by writing each move as its place in a list of the legal moves, which both sides can
+ rebuild by replaying the game. MoveIndices numbers the moves in a fixed order and spends
+ ceil(log2(legal moves)) bits on each, about 5 bits a ply. RankedMoves orders the moves by a cheap guess
+ at how likely they are, captures and central moves first, and codes the rank with a range coder whose
+ model learns which ranks the game uses, so predictable games cost less.
+ Everything the order depends on is fixed in this file, so games written once always decode the same way.
+ */
+class GameCodec {
+private:
+    //Fills list with the legal moves in the order the encoding numbers them
+    static void orderMoves(Position& pos, GameEncoding encoding, MoveList& list);
+
+public:
+
+    //Writes a game, replacing out. Returns false if the game does not replay as legal moves, which only
+    //RawMoves can store
+    static bool encode(const std::vector<Move>& moves, GameEncoding encoding, std::vector<uint8_t>& out);
+
+    //Reads a game of the given number of plies, returning false if the data is not a valid game
+    static bool decode(const uint8_t* data, size_t bytes, int plies, GameEncoding encoding, std::vector<Move>& moves);
+};
+
+#endif
@@ -0,0 +1,138 @@
+#include "GameLoop.h"
+#include <algorithm>
+
+void GameTask::promise_type::Yield::await_suspend(std::coroutine_handle<> handle) const {
+    //Without a scheduler the game stays suspended until next() is called again
+    if (promise->scheduler != nullptr)
+        promise->scheduler->post(handle);
+}
+
+void GameTask::promise_type::Finish::await_suspend(std::coroutine_handle<promise_type> handle) const noexcept {
+    if (promise->scheduler != nullptr)
+        promise->scheduler->finish(handle);
+}
+
+//Sources may give any move at all, so only one which is among the position's legal moves is played
+static bool isLegalMove(Position& pos, CompactMove m) {
+    MoveList pseudo;
+    pos.generatePseudoLegalMoves(pseudo);
+    for (int i = 0; i < pseudo.count; i++)
+        if (pseudo[i] == m)
+            return pos.isLegal(m);
+    return false;
+}
+
+/*
+ Plays a game the way GameManager::play does, but waiting on its move sources rather than the console
+ white - where white's moves come from
+ black - where black's moves come from
+ rules - when to stop a game which goes on too long
+ */
+GameTask playGame(MoveSource& white, MoveSource& black, GameRules rules) {
+    Position pos;
+    //Keys since the last capture or pawn move, which is as far back as a repetition can reach
+    std::vector<uint64_t> history;
+    GameUpdate update;
+    update.position = &pos;
+    co_yield update;
+
+    while (!update.over) {
+        bool whitesTurn = pos.isWhiteToMove();
+        CompactMove m = co_await (whitesTurn ? white : black).move(pos);
+
+        update.move = m;
+        if (m.isNull() || !isLegalMove(pos, m)) {
+            update.over = true;
+            update.reason = m.isNull() ? "resigned" : "illegal move";
+            update.result = whitesTurn ? BlackWins : WhiteWins;
+            co_yield update;
+            break;
+        }
+        update.storedMove = pos.toStoredMove(m);
+        history.push_back(pos.key());
+        UndoInfo undo;
+        pos.makeMove(m, undo);
+        update.plies++;
+        if (pos.getHalfmoveClock() == 0)
+            history.clear();
+
+        if (!pos.hasLegalMove()) {
+            update.over = true;
+            bool mated = pos.inCheck();
+            update.result = mated ? (whitesTurn ? WhiteWins : BlackWins) : DrawnGame;
+            update.reason = mated ? "checkmate" : "stalemate";
+        } else if (pos.getHalfmoveClock() >= 100) {
+            update.over = true;
+            update.result = DrawnGame;
+            update.reason = "fifty moves";
+        } else if (std::count(history.begin(), history.end(), pos.key()) >= 2) {
+            update.over = true;
+            update.result = DrawnGame;
+            update.reason = "repetition";
+        } else if (update.plies >= rules.maxPlies) {
+            update.over = true;
+            update.reason = "ply limit";
+        }
+        co_yield update;
+    }
+}
+
+GameScheduler::GameScheduler(int threads) {
+    threadCount = (threads > 0) ? threads : std::max(1, (int)std::thread::hardware_concurrency());
+}
+
+void GameScheduler::spawn(GameTask task) {
+    std::coroutine_handle<GameTask::promise_type> handle = task.handle;
+    task.handle = nullptr;
+    handle.promise().scheduler = this;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        unfinished++;
+    }
+    post(handle);
+}
+
+void GameScheduler::post(std::coroutine_handle<> handle) {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        ready.push_back(handle);
+    }
+    changed.notify_one();
+}
+
+void GameScheduler::finish(std::coroutine_handle<> handle) {
+    //Nothing of the game is used once it has suspended for the last time, so it can go at once
+    handle.destroy();
+    bool last;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        last = --unfinished == 0;
+    }
+    if (last)
+        changed.notify_all();
+}
+
+void GameScheduler::work() {
+    while (true) {
+        std::coroutine_handle<> handle;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            changed.wait(guard, [&] { return !ready.empty() || unfinished == 0; });
+            if (ready.empty())
+                return;
+            handle = ready.front();
+            ready.pop_front();
+        }
+        handle.resume();
+    }
+}
+
+void GameScheduler::run() {
+    std::vector<std::thread> workers;
+    for (int t = 1; t < threadCount; t++)
+        workers.push_back(std::thread(&GameScheduler::work, this));
+    //The calling thread plays too
+    work();
+    for (auto it = workers.begin(); it != workers.end(); it++)
+        it->join();
+}
@@ -0,0 +1,177 @@
+#ifndef GameLoop_H
+#define GameLoop_H
+
+#include "Position.h"
+#include "Move.h"
+#include "GameStorage.h"
+#include "MoveSource.h"
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+
+class GameScheduler;
+
+//What a game tells whoever is watching it, once at the start and after every move
+struct GameUpdate {
+    const Position* position = nullptr;     //The position now, valid until the game is resumed
+    int plies = 0;
+    CompactMove move;                       //The move just played, null at the start
+    Move storedMove;                        //The same move as game files keep it
+    bool over = false;
+    GameResult result = ResultUnknown;      //Unknown only for a game stopped at the ply limit
+    const char* reason = "";                //Why the game is over: checkmate, stalemate, fifty moves, repetition,
+                                            //resigned or ply limit
+};
+
+/*
+ A game being played as a coroutine, which stops at every update it yields and at every move it has to wait
+ for, instead of blocking a thread as GameManager::play does.
+
+ A task can be driven by hand, with next() returning after each update, when its move sources answer at
+ once. Given to a GameScheduler it is run on the scheduler's threads instead, among every other game there,
+ going to the back of the queue after each update so games take turns.
+ */
+class GameTask {
+public:
+    struct promise_type {
+        GameUpdate current;
+        GameScheduler* scheduler = nullptr;
+        std::function<void(const GameUpdate&)> observer;
+
+        GameTask get_return_object() {
+            return GameTask(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        std::suspend_always initial_suspend() noexcept {
+            return {};
+        }
+
+        //Hands the game back to the scheduler, or to whoever called next()
+        struct Yield {
+            promise_type* promise;
+            bool await_ready() const noexcept {
+                return false;
+            }
+            void await_suspend(std::coroutine_handle<> handle) const;
+            void await_resume() const noexcept { }
+        };
+        Yield yield_value(const GameUpdate& update) {
+            current = update;
+            if (observer)
+                observer(current);
+            return Yield{this};
+        }
+
+        //Lets the scheduler know the game has finished, so it can free it
+        struct Finish {
+            promise_type* promise;
+            bool await_ready() const noexcept {
+                return false;
+            }
+            void await_suspend(std::coroutine_handle<promise_type> handle) const noexcept;
+            void await_resume() const noexcept { }
+        };
+        Finish final_suspend() noexcept {
+            return Finish{this};
+        }
+
+        void return_void() { }
+        void unhandled_exception() {
+            std::terminate();
+        }
+
+        //co_await on a MoveSource waits for it to choose a move
+        MoveSource::Awaiter await_transform(MoveSource::Request request) {
+            return MoveSource::Awaiter(request, scheduler);
+        }
+    };
+
+private:
+    std::coroutine_handle<promise_type> handle;
+
+    friend class GameScheduler;
+
+    explicit GameTask(std::coroutine_handle<promise_type> handle) : handle(handle) { }
+
+public:
+    GameTask(GameTask&& other) noexcept : handle(other.handle) {
+        other.handle = nullptr;
+    }
+    GameTask(const GameTask&) = delete;
+    GameTask& operator=(const GameTask&) = delete;
+    ~GameTask() {
+        if (handle)
+            handle.destroy();
+    }
+
+    //Calls the function with every update as it is yielded, on whichever thread is running the game
+    void watch(std::function<void(const GameUpdate&)> observer) {
+        handle.promise().observer = std::move(observer);
+    }
+
+    //Runs the game on to its next update, returning false once it is over
+    bool next() {
+        if (!handle || handle.done())
+            return false;
+        handle.resume();
+        return !handle.done();
+    }
+
+    //The last update yielded
+    const GameUpdate& update() const {
+        return handle.promise().current;
+    }
+};
+
+//Limits for a game played by playGame
+struct GameRules {
+    int maxPlies = 400;             //The game is left unfinished after this many plies
+};
+
+//Plays a game from the starting position, asking each side's source for its moves in turn, and yielding an
+//update at the start and after every move. A source giving a null move or an illegal one resigns, losing the game
+GameTask playGame(MoveSource& white, MoveSource& black, GameRules rules = GameRules());
+
+/*
+ Runs many games at once on a few threads. A game takes a thread only while it is working out its next
+ move, so tens of thousands can be in progress at once, waiting on their move sources or for their turn.
+ */
+class GameScheduler {
+private:
+    int threadCount;
+    std::deque<std::coroutine_handle<>> ready;
+    std::mutex lock;
+    std::condition_variable changed;
+    size_t unfinished = 0;              //Games spawned which have not finished yet
+
+    friend struct GameTask::promise_type::Finish;
+
+    void work();
+    //Frees a finished game
+    void finish(std::coroutine_handle<> handle);
+
+public:
+
+    //threads - 0 uses every core
+    GameScheduler(int threads = 0);
+
+    int threads() const {
+        return threadCount;
+    }
+
+    //Takes a game over, to start when run is called, or at once if it is running. The game's observer is
+    //called on the scheduler's threads, so must be safe to call from several at once
+    void spawn(GameTask task);
+
+    //Queues a waiting game to carry on. Safe to call from any thread
+    void post(std::coroutine_handle<> handle);
+
+    //Runs the games on the scheduler's threads until every game spawned has finished
+    void run();
+};
+
+#endif
@@ -2,7 +2,10 @@
 #include <iostream>
 #include <vector>
 #include <string>
+#include <sstream>
+#include <algorithm>
 #include "globalFunctions.h"
+#include "Tablebase.h"
 
 #define BOLDBLACK "\033[1m\033[30m"
 #define RESET "\033[0m"
@@ -19,16 +22,24 @@ std::vector<Move> GameManager::play() {
         whitesTurn = !whitesTurn;
         
         // Displays the board to the user, before gathering input
-        globalFunctions::clearConsole();
-        std::cout << (whitesTurn ? "White's" : "Black's") << " turn to play." << std::endl;
-        board.print(whitesTurn, std::cout);
-        std::cout << std::endl;
+        std::string footer = lastReport;
+        if (!endgameReport.empty())
+            footer += "\n" + endgameReport;
+        renderer.render(board, whitesTurn, std::string(whitesTurn ? "White's" : "Black's") + " turn to play.", footer);
         
-        // Processes the turn for the player
-        Move m = turn(whitesTurn);
+        // Processes the turn for the player, or the computer if it is playing this side
+        uint64_t key = Position::fromBoard(board, whitesTurn).key();
+        Move m = computerPlays[whitesTurn ? 0 : 1] ? computerTurn(whitesTurn) : turn(whitesTurn);
         if (m == EXIT)
             return std::vector<Move>();
         moves.push_back(m);
+        history.push_back(key);
+        
+        // Looks the new position up in the endgame tables, which know how it ends with best play
+        TablebaseResult exact;
+        endgameReport.clear();
+        if (Tablebases::defaultTablebases()->probe(Position::fromBoard(board, !whitesTurn), exact))
+            endgameReport = "Tablebase: " + Tablebases::describe(exact, !whitesTurn);
         
         // Checks for victory, and repeats if there has been no victory
     } while (!victory(whitesTurn));
@@ -181,6 +192,104 @@ Move GameManager::turn(bool whitesTurn) {
     return m;
 }
 
+/*
+ Hands one side of the game to the computer
+ white - whether the computer plays white
+ limits - how long the computer may think about each move
+ useMonteCarlo - whether to play with Monte Carlo tree search rather than alpha-beta
+ */
+void GameManager::setComputerPlayer(bool white, SearchLimits limits, bool useMonteCarlo) {
+    computerPlays[white ? 0 : 1] = true;
+    this->limits = limits;
+    if (useMonteCarlo) {
+        if (!monteCarlo)
+            monteCarlo = std::make_shared<MonteCarloSearch>();
+    } else if (!engine)
+        engine = std::make_shared<Engine>();
+}
+
+/*
+ Picks the candidate the endgame tables rate best: the fastest win, else a draw, else the slowest loss.
+ Returns a null move if the tables do not cover every candidate.
+ */
+static CompactMove tablebaseMove(Position& root, const std::vector<CompactMove>& candidates) {
+    CompactMove best;
+    int bestScore = 0;
+    for (auto it = candidates.begin(); it != candidates.end(); it++) {
+        UndoInfo undo;
+        TablebaseResult result;
+        root.makeMove(*it, undo);
+        bool found = Tablebases::defaultTablebases()->probe(root, result);
+        root.unmakeMove(*it, undo);
+        if (!found)
+            return CompactMove();
+        //The result is the opponent's, so their loss is our win
+        int score = (result.outcome < 0) ? 1000 - result.plies : (result.outcome > 0) ? -1000 + result.plies : 0;
+        if (best.isNull() || score > bestScore) {
+            best = *it;
+            bestScore = score;
+        }
+    }
+    return best;
+}
+
+/*
+ Searches the board for the computer's move and performs it. Once the endgame tables cover the position
+ their best move is played without a search.
+ Only moves the board itself can perform are searched: pawns always become queens, and castling
+ must pass ChessBoard::canCastle.
+ */
+Move GameManager::computerTurn(bool whitesTurn) {
+    Position root = Position::fromBoard(board, whitesTurn);
+    MoveList legal;
+    root.generateLegalMoves(legal);
+    
+    std::vector<CompactMove> candidates;
+    for (int i = 0; i < legal.count; i++) {
+        CompactMove cm = legal[i];
+        if (cm.isPromotion() && cm.promotionType() != QueenType)
+            continue;
+        if (cm.isCastle() && !board.canCastle(whitesTurn, cm.special() == KingSideCastle))
+            continue;
+        candidates.push_back(cm);
+    }
+    
+    while (!candidates.empty()) {
+        CompactMove best = tablebaseMove(root, candidates);
+        std::ostringstream report;
+        if (!best.isNull()) {
+            report << " from the endgame tables";
+        } else if (monteCarlo) {
+            MonteCarloResult result = monteCarlo->search(root, limits, candidates);
+            best = result.best;
+            report << ". " << result.playouts << " playouts, " << (long)result.playoutsPerSecond() << " playouts/sec, "
+                   << (int)(result.winRate * 100) << "% expected score";
+        } else {
+            SearchResult result = engine->search(root, limits, candidates, history);
+            best = result.best;
+            report << ". Depth " << result.depth << ", " << result.nodes << " nodes, "
+                   << (long)result.nodesPerSecond() << " nodes/sec";
+        }
+        if (best.isNull())
+            break;
+        
+        Move m = root.toStoredMove(best);
+        if (board.doMove(whitesTurn, m, (whitesTurn ? whitePoints : blackPoints)) == Legality::Legal) {
+            std::ostringstream played;
+            played << "The computer played " << m << report.str();
+            lastReport = played.str();
+            return m;
+        }
+        
+        // The board disagreed with the search about this move, so we try again without it
+        candidates.erase(std::find(candidates.begin(), candidates.end(), best));
+    }
+    
+    std::cout << "The computer has no moves it can play. The game is drawn." << std::endl;
+    std::cin.get();
+    return EXIT;
+}
+
 void GameManager::newGame() {
     std::cerr << "This has not been implemented, as it is not necessary" << std::endl;
 }
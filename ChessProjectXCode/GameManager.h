@@ -6,6 +6,10 @@
 #include <string>
 #include <vector>
 #include "DecodeReturn.h"
+#include "Engine.h"
+#include "MonteCarlo.h"
+#include "TerminalRenderer.h"
+#include <memory>
 
 #define BlinkingText "\033[5m"
 #define resetText "\033[0m"
@@ -17,6 +21,23 @@ private:
     int whitePoints = 0;
     int blackPoints = 0;
     
+    //Which sides the computer plays, [0] for white and [1] for black
+    bool computerPlays[2] = {false, false};
+    SearchLimits limits;
+    std::shared_ptr<Engine> engine;
+    std::shared_ptr<MonteCarloSearch> monteCarlo;      //Used instead of the engine when set
+    
+    //Keys of the positions so far, so the computer can see repetitions
+    std::vector<uint64_t> history;
+    
+    //Summary of the computer's last search, shown under the board
+    std::string lastReport;
+    //The endgame tables' verdict on the position, shown under the board once few enough pieces are left
+    std::string endgameReport;
+    
+    //Draws each turn over the last, leaving rows below the board for the move prompt
+    TerminalRenderer renderer = TerminalRenderer(4);
+    
 public:
     
     friend class AnalysisManager;
@@ -33,6 +54,13 @@ public:
     //Processes a turn for one of the players
     Move turn(bool whitesTurn);
     
+    //Lets the computer play one side, thinking within the limits given for each move.
+    //With useMonteCarlo it plays by tree search over random games, and limits.nodes counts playouts
+    void setComputerPlayer(bool white, SearchLimits limits, bool useMonteCarlo = false);
+    
+    //Searches for and plays the computer's move
+    Move computerTurn(bool whitesTurn);
+    
     //Resets the game for a new game
     void newGame();
     
@@ -0,0 +1,214 @@
+#include "GameQuery.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <sstream>
+#include <thread>
+
+//Games are handed to the threads this many at a time
+static const int gameBlock = 64;
+
+MaterialSignature MaterialSignature::mirrored() const {
+    MaterialSignature m;
+    m.bits = ((bits & 0xFFFFFF) << 24) | ((bits >> 24) & 0xFFFFFF);
+    return m;
+}
+
+MaterialSignature MaterialSignature::of(const Position& pos) {
+    MaterialSignature m;
+    for (int sq = 0; sq < 64; sq++)
+        if (pos.at(sq) != NoPiece)
+            m.add(pos.at(sq));
+    return m;
+}
+
+bool MaterialSignature::parse(const std::string& text, MaterialSignature& signature) {
+    MaterialSignature m;
+    bool white = true;
+    for (auto it = text.begin(); it != text.end(); it++) {
+        char c = (char)toupper(*it);
+        if (c == 'V' && white) {
+            white = false;
+            continue;
+        }
+        size_t type = std::string(" PNBRQK").find(c);
+        if (type == std::string::npos || type == 0)
+            return false;
+        uint8_t piece = Position::makePiece((int)type, white);
+        if (m.count(piece) == 15)
+            return false;
+        m.add(piece);
+    }
+    if (white || m.count(WhiteKing) != 1 || m.count(BlackKing) != 1)
+        return false;
+    signature = m;
+    return true;
+}
+
+uint64_t ScanPly::bitboard(uint8_t piece) const {
+    uint64_t board = 0;
+    for (int sq = 0; sq < 64; sq++)
+        if (pos->at(sq) == piece)
+            board |= (uint64_t)1 << sq;
+    return board;
+}
+
+GameQuery::GameQuery(int threads) {
+    threadCount = (threads > 0) ? threads : (int)std::thread::hardware_concurrency();
+    if (threadCount < 1)
+        threadCount = 1;
+}
+
+/*
+ Replays the games on every thread, stopping a game at the end of its moves, at a move which does not
+ fit, or when the visitor returns false.
+ storage - the games
+ visit - sees each ply, with the number of the thread replaying it
+ */
+void GameQuery::replay(const GameStorage& storage, const std::function<bool(int thread, int game, const ScanPly&)>& visit) {
+    auto start = std::chrono::steady_clock::now();
+    std::atomic<int> nextGame(0);
+    std::atomic<uint64_t> totalGames(0), totalPlies(0);
+
+    auto worker = [&](int thread) {
+        std::vector<Move> moves;
+        Position pos;
+        uint64_t games = 0, plies = 0;
+        MaterialSignature startMaterial;
+        pos.reset();
+        startMaterial = MaterialSignature::of(pos);
+
+        int first;
+        while ((first = nextGame.fetch_add(gameBlock)) < storage.size()) {
+            int last = std::min(first + gameBlock, storage.size());
+            for (int id = first; id < last; id++) {
+                if (!storage.loadGame(id, moves))
+                    continue;
+                games++;
+                pos.reset();
+                ScanPly ply;
+                ply.pos = &pos;
+                ply.ply = 0;
+                ply.moved = NoPiece;
+                ply.captured = NoPiece;
+                ply.material = startMaterial;
+                if (!visit(thread, id, ply))
+                    continue;
+
+                for (size_t i = 0; i < moves.size(); i++) {
+                    CompactMove m = pos.fromStoredMove(moves[i]);
+                    if (m.isNull())
+                        break;
+                    ply.move = m;
+                    ply.moved = pos.at(m.from());
+                    ply.captured = (m.special() == EnPassant) ? Position::makePiece(PawnType, !pos.isWhiteToMove()) : pos.at(m.to());
+                    if (ply.captured != NoPiece)
+                        ply.material.remove(ply.captured);
+                    if (m.isPromotion()) {
+                        ply.material.remove(ply.moved);
+                        ply.material.add(Position::makePiece(m.promotionType(), pos.isWhiteToMove()));
+                    }
+                    UndoInfo undo;
+                    pos.makeMove(m, undo);
+                    ply.ply = (int)i + 1;
+                    plies++;
+                    if (!visit(thread, id, ply))
+                        break;
+                }
+            }
+        }
+        totalGames += games;
+        totalPlies += plies;
+    };
+
+    std::vector<std::thread> pool;
+    for (int t = 0; t < threadCount; t++)
+        pool.push_back(std::thread(worker, t));
+    for (auto it = pool.begin(); it != pool.end(); it++)
+        it->join();
+
+    stats.games = totalGames;
+    stats.plies = totalPlies;
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+std::vector<int> GameQuery::findGames(const GameStorage& storage, const PlyPredicate& predicate, int maxPly) {
+    std::vector<int> found = mapReduce<std::vector<int>>(storage, std::vector<int>(),
+        [&](int game, const ScanPly& ply, std::vector<int>& matches) {
+            if (maxPly >= 0 && ply.ply > maxPly)
+                return false;
+            if (predicate(ply)) {
+                matches.push_back(game);
+                return false;
+            }
+            return maxPly < 0 || ply.ply < maxPly;
+        },
+        [](std::vector<int>& into, const std::vector<int>& from) {
+            into.insert(into.end(), from.begin(), from.end());
+        });
+    std::sort(found.begin(), found.end());
+    return found;
+}
+
+/*
+ Builds a predicate from the terms of a query, all of which must hold at the same ply.
+ text - the query
+ predicate - set to the test, if the query is well formed
+ maxPly - set to the last ply worth replaying, or -1 for the whole game
+ */
+bool GameQuery::parse(const std::string& text, PlyPredicate& predicate, int& maxPly) {
+    std::vector<PlyPredicate> terms;
+    int limit = -1;
+    std::istringstream in(text);
+    std::string word;
+    while (in >> word) {
+        if (word == "and")
+            continue;
+        if (word == "material" || word == "ending") {
+            std::string spec;
+            MaterialSignature m;
+            if (!(in >> spec) || !MaterialSignature::parse(spec, m))
+                return false;
+            if (word == "material") {
+                terms.push_back([m](const ScanPly& ply) { return ply.material == m; });
+            } else {
+                MaterialSignature other = m.mirrored();
+                terms.push_back([m, other](const ScanPly& ply) { return ply.material == m || ply.material == other; });
+            }
+        } else if (word == "promotion") {
+            int moveNumber;
+            if (!(in >> moveNumber) || moveNumber < 1)
+                return false;
+            int last = moveNumber * 2;
+            limit = (limit < 0) ? last : std::min(limit, last);
+            terms.push_back([last](const ScanPly& ply) { return ply.move.isPromotion() && ply.ply <= last; });
+        } else if (word == "piece") {
+            std::string spec;
+            if (!(in >> spec) || spec.size() != 3 || spec[1] < 'a' || spec[1] > 'h' || spec[2] < '1' || spec[2] > '8')
+                return false;
+            size_t type = std::string(" PNBRQK").find((char)toupper(spec[0]));
+            if (type == std::string::npos || type == 0)
+                return false;
+            uint8_t piece = Position::makePiece((int)type, isupper(spec[0]) != 0);
+            int sq = Position::square(spec[1] - 'a', spec[2] - '1');
+            terms.push_back([piece, sq](const ScanPly& ply) { return ply.pos->at(sq) == piece; });
+        } else if (word == "capture") {
+            terms.push_back([](const ScanPly& ply) { return ply.captured != NoPiece; });
+        } else if (word == "check") {
+            terms.push_back([](const ScanPly& ply) { return ply.ply > 0 && ply.pos->inCheck(); });
+        } else {
+            return false;
+        }
+    }
+    if (terms.empty())
+        return false;
+
+    predicate = [terms](const ScanPly& ply) {
+        for (auto it = terms.begin(); it != terms.end(); it++)
+            if (!(*it)(ply))
+                return false;
+        return true;
+    };
+    maxPly = limit;
+    return true;
+}
@@ -0,0 +1,126 @@
+#ifndef GameQuery_H
+#define GameQuery_H
+
+#include "GameStorage.h"
+#include "Position.h"
+#include <functional>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+/*
+ The material on the board as a count of each piece, four bits per PieceCode kind: white pawn to king in
+ the low six nibbles, then black pawn to king. Two positions with the same material have equal signatures.
+ */
+struct MaterialSignature {
+    uint64_t bits = 0;
+
+    static int shift(uint8_t piece) {
+        return ((Position::typeOf(piece) - 1) + (Position::isWhitePiece(piece) ? 0 : 6)) * 4;
+    }
+    void add(uint8_t piece) { bits += (uint64_t)1 << shift(piece); }
+    void remove(uint8_t piece) { bits -= (uint64_t)1 << shift(piece); }
+    int count(uint8_t piece) const { return (int)((bits >> shift(piece)) & 15); }
+
+    //The same material with the colours swapped
+    MaterialSignature mirrored() const;
+
+    static MaterialSignature of(const Position& pos);
+
+    //Reads material written as white's pieces, a v, then black's, such as KRvKB or KQPPvKQ. Returns false if malformed
+    static bool parse(const std::string& text, MaterialSignature& signature);
+
+    bool operator==(const MaterialSignature& rhs) const { return bits == rhs.bits; }
+    bool operator!=(const MaterialSignature& rhs) const { return bits != rhs.bits; }
+};
+
+//What a scan sees after each ply of a game
+struct ScanPly {
+    const Position* pos;            //The position after the move
+    int ply;                        //Plies played, 0 for the starting position
+    CompactMove move;               //The move just played, null at ply 0
+    uint8_t moved;                  //The piece which moved, as it was before any promotion
+    uint8_t captured;               //The piece taken, NoPiece if none
+    MaterialSignature material;     //Kept up to date move by move rather than counted each ply
+
+    //The squares holding the piece, one bit per square with A1 the lowest
+    uint64_t bitboard(uint8_t piece) const;
+};
+
+//Tests a ply of a game
+typedef std::function<bool(const ScanPly&)> PlyPredicate;
+
+//Totals of the last scan
+struct ScanStats {
+    uint64_t games = 0;
+    uint64_t plies = 0;             //Plies replayed, which early stops keep below the plies stored
+    double seconds = 0;
+
+    double gamesPerSecond() const {
+        return seconds > 0 ? games / seconds : 0;
+    }
+};
+
+/*
+ Answers questions across every game of a database by replaying them on all cores.
+ Games are handed to the threads 64 at a time, each thread replaying them on its own Position and keeping
+ the material signature up to date as pieces are captured and promoted. A visitor sees every ply in order
+ and returns false to stop with a game early, so a question answered at the first match, or only about
+ the opening, replays no more of each game than it needs.
+ mapReduce gives each thread its own copy of the accumulator and combines them at the end, so the visitor
+ never needs a lock.
+ */
+class GameQuery {
+private:
+    int threadCount;
+    ScanStats stats;
+
+    //Replays every game, calling visit with the number of the calling thread until it returns false
+    void replay(const GameStorage& storage, const std::function<bool(int thread, int game, const ScanPly&)>& visit);
+
+public:
+
+    //threads - 0 uses every core
+    GameQuery(int threads = 0);
+
+    int threads() const {
+        return threadCount;
+    }
+    const ScanStats& lastStats() const {
+        return stats;
+    }
+
+    //Folds every ply of every game into a value.
+    //visit - adds a ply of a game to the thread's accumulator, returning false to skip the rest of the game
+    //reduce - adds one thread's accumulator to another
+    template <typename T>
+    T mapReduce(const GameStorage& storage, const T& initial,
+                const std::function<bool(int game, const ScanPly&, T&)>& visit,
+                const std::function<void(T& into, const T& from)>& reduce) {
+        //Each accumulator is kept on its own cache lines, so the threads do not slow each other down
+        struct alignas(64) Part {
+            T value;
+        };
+        std::vector<Part> parts(threadCount, Part{initial});
+        replay(storage, [&](int thread, int game, const ScanPly& ply) {
+            return visit(game, ply, parts[thread].value);
+        });
+        T total = initial;
+        for (auto it = parts.begin(); it != parts.end(); it++)
+            reduce(total, it->value);
+        return total;
+    }
+
+    //The ids of the games, in order, with a ply matching the predicate within the first maxPly plies, or anywhere if maxPly < 0
+    std::vector<int> findGames(const GameStorage& storage, const PlyPredicate& predicate, int maxPly = -1);
+
+    //Reads a query made of terms joined by "and", returning false if it is malformed. The terms are
+    //  material KRvKB      - exactly this material, white's first
+    //  ending KRvKB        - this material with either side holding either half
+    //  promotion 30        - a pawn promoted by move 30, which also limits the scan to those moves
+    //  piece Qd4           - a piece on a square, upper case for white and lower case for black
+    //  capture / check     - the move captured / gave check
+    static bool parse(const std::string& text, PlyPredicate& predicate, int& maxPly);
+};
+
+#endif
@@ -0,0 +1,530 @@
+#include "GameServer.h"
+#include "Position.h"
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#if defined(__APPLE__) || defined(__FreeBSD__)
+#include <sys/event.h>
+#else
+#include <sys/epoll.h>
+#endif
+
+//What the event loop is told about a descriptor
+struct PollEvent {
+    int fd;
+    bool readable;
+    bool writable;
+};
+
+/*
+ Waits on many descriptors at once: kqueue on macOS, which has no epoll, and epoll elsewhere.
+ Each descriptor is watched for reading, writing or both, and stays ready until it is drained.
+ */
+class Poller {
+private:
+    int fd;
+
+public:
+    Poller() {
+#if defined(__APPLE__) || defined(__FreeBSD__)
+        fd = kqueue();
+#else
+        fd = epoll_create1(0);
+#endif
+    }
+
+    ~Poller() {
+        if (fd >= 0)
+            close(fd);
+    }
+
+    bool isOpen() const {
+        return fd >= 0;
+    }
+
+    //Starts watching a descriptor, or changes what it is watched for. Closing a descriptor stops it being
+    //watched, so there is nothing to remove
+    bool watch(int target, bool reading, bool writing, bool added) {
+#if defined(__APPLE__) || defined(__FreeBSD__)
+        struct kevent changes[2];
+        EV_SET(&changes[0], target, EVFILT_READ, EV_ADD | (reading ? EV_ENABLE : EV_DISABLE), 0, 0, nullptr);
+        EV_SET(&changes[1], target, EVFILT_WRITE, EV_ADD | (writing ? EV_ENABLE : EV_DISABLE), 0, 0, nullptr);
+        (void)added;
+        return kevent(fd, changes, 2, nullptr, 0, nullptr) == 0;
+#else
+        struct epoll_event event;
+        memset(&event, 0, sizeof(event));
+        event.events = (reading ? (uint32_t)EPOLLIN : 0u) | (writing ? (uint32_t)EPOLLOUT : 0u);
+        event.data.fd = target;
+        return epoll_ctl(fd, added ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, target, &event) == 0;
+#endif
+    }
+
+    //Waits for descriptors to become ready, returning how many were, or -1 on failure
+    int wait(PollEvent* events, int most) {
+#if defined(__APPLE__) || defined(__FreeBSD__)
+        struct kevent ready[256];
+        int n = kevent(fd, nullptr, 0, ready, std::min(most, 256), nullptr);
+        for (int i = 0; i < n; i++) {
+            events[i].fd = (int)ready[i].ident;
+            events[i].readable = ready[i].filter == EVFILT_READ;
+            events[i].writable = ready[i].filter == EVFILT_WRITE;
+        }
+#else
+        struct epoll_event ready[256];
+        int n = epoll_wait(fd, ready, std::min(most, 256), -1);
+        for (int i = 0; i < n; i++) {
+            events[i].fd = ready[i].data.fd;
+            events[i].readable = (ready[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) != 0;
+            events[i].writable = (ready[i].events & EPOLLOUT) != 0;
+        }
+#endif
+        return n;
+    }
+};
+
+//Splits the next word off a request, moving p past it. Returns false when there are no words left
+static bool nextWord(const char*& p, const char* end, std::string& word) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+        p++;
+    const char* start = p;
+    while (p < end && *p != ' ' && *p != '\t' && *p != '\r')
+        p++;
+    word.assign(start, p);
+    return !word.empty();
+}
+
+//Reads a game number, returning false unless the whole word is one
+static bool readGame(const std::string& word, uint32_t& game) {
+    if (word.empty() || word.size() > 9 || word.find_first_not_of("0123456789") != std::string::npos)
+        return false;
+    game = (uint32_t)strtoul(word.c_str(), nullptr, 10);
+    return true;
+}
+
+static bool setNonBlocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+GameServer::GameServer(int threads) {
+    threadCount = (threads > 0) ? threads : std::max(1, (int)std::thread::hardware_concurrency());
+    for (int t = 0; t < threadCount; t++)
+        shards.push_back(std::unique_ptr<Shard>(new Shard()));
+    for (int t = 0; t < threadCount; t++)
+        workers.push_back(std::thread(&GameServer::work, this, t));
+}
+
+GameServer::~GameServer() {
+    for (auto it = shards.begin(); it != shards.end(); it++) {
+        std::lock_guard<std::mutex> guard((*it)->lock);
+        stopping = true;
+    }
+    for (auto it = shards.begin(); it != shards.end(); it++)
+        (*it)->ready.notify_all();
+    for (auto it = workers.begin(); it != workers.end(); it++)
+        it->join();
+    for (auto it = connections.begin(); it != connections.end(); it++)
+        close(it->first);
+    if (wakeFds[0] >= 0) {
+        close(wakeFds[0]);
+        close(wakeFds[1]);
+    }
+}
+
+void GameServer::work(int shardIndex) {
+    Shard& shard = *shards[shardIndex];
+    ChessBoard board;
+    std::vector<Job> jobs;
+    std::vector<Reply> answered;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> guard(shard.lock);
+            shard.ready.wait(guard, [&] { return stopping || !shard.jobs.empty(); });
+            if (shard.jobs.empty())
+                return;
+            jobs.clear();
+            jobs.swap(shard.jobs);
+        }
+
+        answered.clear();
+        for (auto it = jobs.begin(); it != jobs.end(); it++) {
+            if (it->line.empty()) {
+                //The connection has closed, so the games it started end with it
+                for (uint32_t i = 0; i < shard.sessions.size(); i++) {
+                    if (shard.sessions[i].inUse && shard.sessions[i].owner == it->connection) {
+                        shard.sessions[i].inUse = false;
+                        shard.freeSessions.push_back(i);
+                    }
+                }
+                continue;
+            }
+            if (answered.empty() || answered.back().connection != it->connection)
+                answered.push_back(Reply{it->connection, std::string(), 0});
+            answer(shard, shardIndex, board, *it, answered.back().text);
+            answered.back().answers++;
+        }
+        if (answered.empty())
+            continue;
+
+        {
+            std::lock_guard<std::mutex> guard(repliesLock);
+            for (auto it = answered.begin(); it != answered.end(); it++)
+                replies.push_back(std::move(*it));
+        }
+        //One byte is enough to wake the event loop however many answers are waiting
+        if (!wakePending.exchange(true)) {
+            char wake = 1;
+            while (write(wakeFds[1], &wake, 1) < 0 && errno == EINTR) { }
+        }
+    }
+}
+
+/*
+ Plays or looks at a game. The move is found among the position's legal moves, then made on the board with
+ ChessBoard::doMove, which has the final say, as GameManager::computerTurn does.
+ shard - the worker's games
+ shardIndex - the worker's number, which is each of its game numbers modulo the number of workers
+ board - a board the worker sets up for each move
+ job - the request
+ out - where the answer is appended
+ */
+void GameServer::answer(Shard& shard, int shardIndex, ChessBoard& board, const Job& job, std::string& out) {
+    const char* p = job.line.data();
+    const char* end = p + job.line.size();
+    std::string id, command, word;
+    nextWord(p, end, id);
+    nextWord(p, end, command);
+    out += id;
+
+    if (command == "new") {
+        static const BoardSnapshot start = [] {
+            BoardSnapshot snapshot;
+            ChessBoard fresh;
+            fresh.saveSnapshot(snapshot);
+            return snapshot;
+        }();
+        uint32_t index;
+        if (!shard.freeSessions.empty()) {
+            index = shard.freeSessions.back();
+            shard.freeSessions.pop_back();
+        } else {
+            index = (uint32_t)shard.sessions.size();
+            shard.sessions.push_back(Session());
+        }
+        Session& session = shard.sessions[index];
+        session.board = start;
+        session.owner = job.connection;
+        session.plies = 0;
+        session.inUse = true;
+        session.over = false;
+        out += " ok " + std::to_string((uint64_t)index * threadCount + shardIndex) + "\n";
+        return;
+    }
+
+    //The event loop only passes on requests naming a game of this shard
+    uint32_t game = 0;
+    nextWord(p, end, word);
+    readGame(word, game);
+    uint32_t index = game / threadCount;
+    if (index >= shard.sessions.size() || !shard.sessions[index].inUse) {
+        out += " error no game " + word + "\n";
+        return;
+    }
+    Session& session = shard.sessions[index];
+    bool whitesTurn = session.plies % 2 == 0;
+
+    if (command == "end") {
+        session.inUse = false;
+        shard.freeSessions.push_back(index);
+        out += " ok " + word + "\n";
+        return;
+    }
+
+    board.loadSnapshot(session.board);
+    Position pos = Position::fromBoard(board, whitesTurn, session.plies / 2 + 1);
+    if (command == "fen") {
+        out += " ok " + word + " " + pos.toFen() + "\n";
+        return;
+    }
+
+    std::string move;
+    if (session.over) {
+        out += " error game over " + word + "\n";
+        return;
+    }
+    if (!nextWord(p, end, move)) {
+        out += " error no move given\n";
+        return;
+    }
+    CompactMove m = pos.fromSan(move);
+    if (m.isNull()) {
+        MoveList legal;
+        pos.generateLegalMoves(legal);
+        for (int i = 0; i < legal.count && m.isNull(); i++)
+            if (Position::moveName(legal[i]) == move || (legal[i].promotionType() == QueenType && Position::moveName(legal[i]) == move + "q"))
+                m = legal[i];
+    }
+    //The board always promotes to a queen
+    if (m.isNull() || (m.isPromotion() && m.promotionType() != QueenType)) {
+        out += " error illegal move " + move + "\n";
+        return;
+    }
+    int points = 0;
+    if (board.doMove(whitesTurn, pos.toStoredMove(m), points) != Legality::Legal) {
+        out += " error illegal move " + move + "\n";
+        return;
+    }
+    board.saveSnapshot(session.board);
+    session.plies++;
+
+    //The same test as GameManager::victory, that the other side is in check with no move out of it, and
+    //stalemate as well
+    Position after = Position::fromBoard(board, !whitesTurn);
+    bool check = after.inCheck();
+    const char* status = "normal";
+    if (!after.hasLegalMove()) {
+        status = check ? "checkmate" : "stalemate";
+        session.over = true;
+    } else if (check) {
+        status = "check";
+    }
+    out += " ok " + word + " " + status + "\n";
+}
+
+/*
+ Sends each complete line on to the worker holding its game, keeping any partial last line. Requests which
+ are not understood are answered here without troubling a worker.
+ connection - the connection the lines were read from
+ batches - the requests for each shard, handed over together once everything ready has been read
+ */
+void GameServer::dispatch(Connection& connection, std::vector<std::vector<Job>>& batches) {
+    size_t start = 0;
+    size_t lineEnd;
+    std::string id, command, word;
+    while ((lineEnd = connection.input.find('\n', start)) != std::string::npos) {
+        const char* p = connection.input.data() + start;
+        const char* end = connection.input.data() + lineEnd;
+        size_t lineStart = start;
+        start = lineEnd + 1;
+        if (!nextWord(p, end, id))
+            continue;
+
+        uint32_t game = 0;
+        int shard = -1;
+        if (!nextWord(p, end, command)) {
+            connection.output += id + " error no command\n";
+        } else if (command == "new") {
+            shard = nextShard;
+            nextShard = (nextShard + 1) % threadCount;
+        } else if (command != "move" && command != "fen" && command != "end") {
+            connection.output += id + " error unknown command " + command + "\n";
+        } else if (!nextWord(p, end, word) || !readGame(word, game)) {
+            connection.output += id + " error no game given\n";
+        } else {
+            shard = (int)(game % threadCount);
+        }
+        if (shard >= 0) {
+            batches[shard].push_back(Job{connection.id, connection.input.substr(lineStart, lineEnd - lineStart)});
+            connection.awaiting++;
+        }
+    }
+    connection.input.erase(0, start);
+}
+
+bool GameServer::flush(Connection& connection) {
+    size_t written = 0;
+    while (written < connection.output.size()) {
+        ssize_t n = write(connection.fd, connection.output.data() + written, connection.output.size() - written);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            break;
+        if (n <= 0)
+            return false;
+        written += (size_t)n;
+    }
+    connection.output.erase(0, written);
+    return true;
+}
+
+bool GameServer::serve(const std::string& path) {
+    signal(SIGPIPE, SIG_IGN);
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path))
+        return false;
+    strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+
+    Poller poller;
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0 || !poller.isOpen() || pipe(wakeFds) != 0) {
+        if (listener >= 0)
+            close(listener);
+        return false;
+    }
+    unlink(path.c_str());
+    if (bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(listener, 1024) != 0 ||
+        !setNonBlocking(listener) || !setNonBlocking(wakeFds[0]) ||
+        !poller.watch(listener, true, false, false) || !poller.watch(wakeFds[0], true, false, false)) {
+        close(listener);
+        return false;
+    }
+
+    std::vector<PollEvent> events(256);
+    std::vector<std::vector<Job>> batches(threadCount);
+    std::vector<Reply> ready;
+    std::vector<int> closing;
+    std::vector<int> touched;
+    std::vector<char> buffer(1 << 16);
+    bool listening = true;
+
+    auto closeConnection = [&](int fd) {
+        auto found = connections.find(fd);
+        if (found == connections.end())
+            return;
+        for (int s = 0; s < threadCount; s++)
+            batches[s].push_back(Job{found->second.id, std::string()});
+        connectionFds.erase(found->second.id);
+        connections.erase(found);
+        close(fd);
+    };
+    //Watches for writing only while answers are waiting, and stops reading while too many are. Returns false
+    //once a client which has ended its input has every answer, so the connection is finished with
+    auto rewatch = [&](Connection& connection) {
+        if (connection.inputEnded && connection.awaiting == 0 && connection.output.empty())
+            return false;
+        bool writing = !connection.output.empty();
+        bool reading = !connection.inputEnded && connection.output.size() < UnwrittenBytes;
+        if (writing != connection.writing || reading != connection.reading) {
+            connection.writing = writing;
+            connection.reading = reading;
+            poller.watch(connection.fd, reading, writing, true);
+        }
+        return true;
+    };
+
+    while (listening) {
+        int n = poller.wait(events.data(), (int)events.size());
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0)
+            break;
+
+        closing.clear();
+        for (int e = 0; e < n; e++) {
+            int fd = events[e].fd;
+            if (fd == listener) {
+                while (true) {
+                    int client = accept(listener, nullptr, nullptr);
+                    if (client < 0) {
+                        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR && errno != ECONNABORTED && errno != EMFILE)
+                            listening = false;
+                        break;
+                    }
+                    if (!setNonBlocking(client) || !poller.watch(client, true, false, false)) {
+                        close(client);
+                        continue;
+                    }
+                    Connection& connection = connections[client];
+                    connection.fd = client;
+                    connection.id = nextConnection++;
+                    connectionFds[connection.id] = client;
+                }
+                continue;
+            }
+
+            if (fd == wakeFds[0]) {
+                char drained[64];
+                while (read(wakeFds[0], drained, sizeof(drained)) > 0) { }
+                wakePending = false;
+                {
+                    std::lock_guard<std::mutex> guard(repliesLock);
+                    ready.swap(replies);
+                }
+                touched.clear();
+                for (auto it = ready.begin(); it != ready.end(); it++) {
+                    auto found = connectionFds.find(it->connection);
+                    if (found == connectionFds.end())
+                        continue;
+                    Connection& connection = connections[found->second];
+                    connection.output += it->text;
+                    connection.awaiting -= it->answers;
+                    touched.push_back(found->second);
+                }
+                ready.clear();
+                std::sort(touched.begin(), touched.end());
+                touched.erase(std::unique(touched.begin(), touched.end()), touched.end());
+                for (auto it = touched.begin(); it != touched.end(); it++) {
+                    Connection& connection = connections[*it];
+                    if ((!connection.writing && !flush(connection)) || !rewatch(connection))
+                        closing.push_back(*it);
+                }
+                continue;
+            }
+
+            auto found = connections.find(fd);
+            if (found == connections.end())
+                continue;
+            Connection& connection = found->second;
+            bool failed = false;
+            if (events[e].writable && !flush(connection))
+                failed = true;
+            if (events[e].readable && !failed && connection.reading) {
+                while (true) {
+                    ssize_t got = read(fd, buffer.data(), buffer.size());
+                    if (got < 0 && errno == EINTR)
+                        continue;
+                    if (got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+                        break;
+                    if (got < 0) {
+                        failed = true;
+                        break;
+                    }
+                    if (got == 0) {
+                        connection.inputEnded = true;
+                        break;
+                    }
+                    connection.input.append(buffer.data(), (size_t)got);
+                    if ((size_t)got < buffer.size())
+                        break;
+                }
+                dispatch(connection, batches);
+                if (!connection.output.empty() && !connection.writing && !flush(connection))
+                    failed = true;
+            }
+            if (failed || !rewatch(connection))
+                closing.push_back(fd);
+        }
+
+        for (auto it = closing.begin(); it != closing.end(); it++)
+            closeConnection(*it);
+
+        //Each worker is woken once for everything read this time round
+        for (int s = 0; s < threadCount; s++) {
+            if (batches[s].empty())
+                continue;
+            Shard& shard = *shards[s];
+            {
+                std::lock_guard<std::mutex> guard(shard.lock);
+                if (shard.jobs.empty())
+                    shard.jobs.swap(batches[s]);
+                else
+                    shard.jobs.insert(shard.jobs.end(), std::make_move_iterator(batches[s].begin()), std::make_move_iterator(batches[s].end()));
+            }
+            batches[s].clear();
+            shard.ready.notify_one();
+        }
+    }
+
+    close(listener);
+    unlink(path.c_str());
+    return true;
+}
@@ -0,0 +1,117 @@
+#ifndef GameServer_H
+#define GameServer_H
+
+#include "ChessBoard.h"
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <stdint.h>
+
+/*
+ Hosts many games at once in one process, for clients connected over a Unix domain socket, in place of a
+ process for each game waiting on the console. A request is a line of
+    <id> new                    - starts a game, answered with "<id> ok <game>"
+    <id> move <game> <move>     - plays the side to move's move, as coordinates such as e2e4 or as SAN,
+                                  answered with "<id> ok <game> <status>", the status being normal, check,
+                                  checkmate or stalemate
+    <id> fen <game>             - answered with "<id> ok <game> <fen>"
+    <id> end <game>             - ends a game, answered with "<id> ok <game>"
+ or answered with "<id> error <reason>". Any client may move in any game, so two players can share one.
+
+ One thread waits on every connection at once, reading requests and writing answers without blocking, and
+ passes the requests on to a few workers. Each game belongs to one worker, which keeps it as a BoardSnapshot
+ and checks its moves on a ChessBoard of its own with ChessBoard::doMove, so a game's requests are answered
+ in the order they arrived. A client which shuts down its side of the connection is still sent the
+ answers to what it sent; games a client started end when it disconnects.
+ */
+class GameServer {
+private:
+    //All the server keeps of a game between moves
+    struct Session {
+        BoardSnapshot board;
+        uint64_t owner;             //The connection which started the game
+        uint16_t plies;
+        bool inUse;
+        bool over;
+    };
+
+    //A request for a worker. An empty line means the connection has closed
+    struct Job {
+        uint64_t connection;
+        std::string line;
+    };
+    struct Reply {
+        uint64_t connection;
+        std::string text;
+        int answers;
+    };
+
+    //The games one worker looks after, and the requests waiting for it
+    struct Shard {
+        std::mutex lock;
+        std::condition_variable ready;
+        std::vector<Job> jobs;
+        std::vector<Session> sessions;
+        std::vector<uint32_t> freeSessions;
+    };
+
+    struct Connection {
+        int fd;
+        uint64_t id;
+        std::string input;
+        std::string output;
+        int awaiting = 0;           //Requests passed to the workers and not yet answered
+        bool inputEnded = false;    //Set once the client has sent all it will, closing once it is answered
+        bool reading = true;
+        bool writing = false;
+    };
+
+    int threadCount;
+    std::vector<std::unique_ptr<Shard>> shards;
+    std::vector<std::thread> workers;
+    bool stopping = false;
+    int nextShard = 0;
+
+    //Answers ready to be written, and the pipe which wakes the event loop to write them
+    std::mutex repliesLock;
+    std::vector<Reply> replies;
+    std::atomic<bool> wakePending{false};
+    int wakeFds[2] = {-1, -1};
+
+    std::unordered_map<int, Connection> connections;
+    std::unordered_map<uint64_t, int> connectionFds;
+    uint64_t nextConnection = 1;
+
+    void work(int shard);
+    //Answers one request for a game of the given shard, appending the answer to out
+    void answer(Shard& shard, int shardIndex, ChessBoard& board, const Job& job, std::string& out);
+
+    //Routes the complete lines read from a connection to the workers holding their games
+    void dispatch(Connection& connection, std::vector<std::vector<Job>>& batches);
+    //Writes as much of a connection's answers as it will take. Returns false if the connection has failed
+    bool flush(Connection& connection);
+
+public:
+
+    //How much a connection may have waiting to be written before no more of its requests are read
+    static const size_t UnwrittenBytes = 1024 * 1024;
+
+    //threads - 0 uses every core
+    GameServer(int threads = 0);
+    ~GameServer();
+
+    int threads() const {
+        return threadCount;
+    }
+
+    //Listens on a Unix domain socket and serves its clients. Runs until the socket fails; returns false if it
+    //could not be created
+    bool serve(const std::string& path);
+};
+
+#endif
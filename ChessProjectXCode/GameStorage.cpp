@@ -1,24 +1,354 @@
-/*#include "GameStorage.h"
-#include <vector>
+#include "GameStorage.h"
+#include "Position.h"
+#include "RAFile.h"
+#include "MappedFile.h"
+#include <sys/stat.h>
+#include <sys/file.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <algorithm>
 
-void GameStorage::addGame(std::string name, std::vector<Move> game) {
-    games[name] = game;
+static const char storageMagic[8] = {'C', 'H', 'E', 'S', 'S', 'G', 'D', 'B'};
+static const uint32_t storageVersion = 2;
+static const uint32_t recordMagic = 0x43455247;     //"GREC"
+//The most bytes forEachGame reads at once, unless a single game is larger
+static const size_t readChunkBytes = 1 << 20;
+
+//FNV-1a, which is plenty to tell a tail torn by a crash from a good one
+static uint64_t checksum(const char* data, size_t bytes) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < bytes; i++) {
+        hash ^= (unsigned char)data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+//The bytes a record takes in the heap, header and padding included
+static size_t recordBytes(uint32_t payloadBytes, uint16_t nameLength) {
+    size_t bytes = 16 + (size_t)payloadBytes + nameLength;
+    return (bytes + 3) & ~(size_t)3;
+}
+
+/*
+ Opens the database, creating an empty one if the file is new. The file is locked for as long as it is
+ open, so only one process adds games to it; if another holds the lock it is opened read only.
+ fileName - the database file
+ */
+bool GameStorage::open(std::string fileName) {
+    close();
+
+    writable = true;
+    fd = ::open(fileName.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd >= 0 && flock(fd, LOCK_EX | LOCK_NB) != 0) {
+        ::close(fd);
+        fd = -1;
+    }
+    if (fd < 0) {
+        writable = false;
+        fd = ::open(fileName.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        close();
+        return false;
+    }
+    uint64_t fileSize = (uint64_t)info.st_size;
+
+    if (fileSize == 0 && writable) {       //A new database, which is written out empty straight away
+        heapEnd = HeaderBytes;
+        dirty = true;
+        if (!commit(false)) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    Header header;
+    if (fileSize < HeaderBytes || !MappedFile::readAll(fd, reinterpret_cast<char*>(&header), sizeof(header), 0) ||
+        memcmp(header.magic, storageMagic, sizeof(storageMagic)) != 0 ||
+        header.version != storageVersion || header.moveSize != sizeof(Move)) {
+        close();
+        return false;
+    }
+
+    if (!readTail(header, fileSize)) {
+        rebuildIndex(fileSize);
+        dirty = writable;       //The rebuilt index is written out on the next commit
+    }
+    return true;
+}
+
+bool GameStorage::readTail(const Header& header, uint64_t fileSize) {
+    if (header.heapEnd < HeaderBytes || header.tailEnd != fileSize || header.heapEnd > header.tailEnd ||
+        header.gameCount * sizeof(IndexEntry) > header.tailEnd - header.heapEnd)
+        return false;
+
+    std::vector<char> tail((size_t)(header.tailEnd - header.heapEnd));
+    if (!MappedFile::readAll(fd, tail.data(), tail.size(), header.heapEnd) || checksum(tail.data(), tail.size()) != header.checksum)
+        return false;
+
+    //The index entries, then each name as its length and its characters
+    size_t position = (size_t)header.gameCount * sizeof(IndexEntry);
+    std::vector<IndexEntry> entries(header.gameCount);
+    if (!entries.empty())
+        memcpy(entries.data(), tail.data(), position);
+    for (uint64_t i = 0; i < header.gameCount; i++) {
+        uint16_t length;
+        if (position + sizeof(length) > tail.size())
+            return false;
+        memcpy(&length, tail.data() + position, sizeof(length));
+        position += sizeof(length);
+        if (position + length > tail.size() || entries[i].offset + recordBytes(entries[i].payloadBytes, length) > header.heapEnd)
+            return false;
+        addEntry(entries[i], std::string(tail.data() + position, length));
+        position += length;
+    }
+    heapEnd = header.heapEnd;
+    return true;
 }
 
-void GameStorage::saveGame() {
-    
+/*
+ Walks the heap from the first record, keeping each one which is whole, and stops at the first which is
+ not: the end of the heap, or a record cut short by a crash.
+ fileSize - the size of the file, which no record may run past
+ */
+void GameStorage::rebuildIndex(uint64_t fileSize) {
+    index.clear();
+    names.clear();
+    ids.clear();
+
+    uint64_t offset = HeaderBytes;
+    RecordHeader record;
+    while (offset + sizeof(record) <= fileSize && MappedFile::readAll(fd, reinterpret_cast<char*>(&record), sizeof(record), offset)) {
+        size_t bytes = recordBytes(record.payloadBytes, record.nameLength);
+        if (record.magic != recordMagic || record.result > DrawnGame || record.encoding > RankedMoves || offset + bytes > fileSize)
+            break;
+        std::string name(record.nameLength, '\0');
+        if (!MappedFile::readAll(fd, &name[0], name.size(), offset + sizeof(record) + record.payloadBytes))
+            break;
+
+        IndexEntry entry = {};
+        entry.offset = offset;
+        entry.plies = record.plies;
+        entry.payloadBytes = record.payloadBytes;
+        entry.result = record.result;
+        entry.encoding = record.encoding;
+        addEntry(entry, name);
+        offset += bytes;
+    }
+    heapEnd = offset;
 }
 
-void GameStorage::saveGames() {
-    
+void GameStorage::addEntry(const IndexEntry& entry, const std::string& name) {
+    ids[name] = (int)index.size();
+    index.push_back(entry);
+    names.push_back(name);
+}
+
+void GameStorage::close() {
+    if (fd >= 0) {
+        commit();
+        ::close(fd);        //Also lets go of the lock
+    }
+    fd = -1;
+    writable = false;
+    dirty = false;
+    heapEnd = 0;
+    index.clear();
+    names.clear();
+    ids.clear();
+}
+
+/*
+ Writes a game's record over the start of the tail. It is not part of the file until the next commit.
+ name - the name to find the game by, cut to 65535 characters
+ moves - the game
+ result - how it ended
+ */
+int GameStorage::addGame(std::string name, const std::vector<Move>& moves, GameResult result) {
+    if (fd < 0 || !writable)
+        return -1;
+
+    //Games which do not replay as legal moves are kept as they are
+    std::vector<uint8_t> payload;
+    GameEncoding used = encoding;
+    if (!GameCodec::encode(moves, used, payload)) {
+        used = RawMoves;
+        GameCodec::encode(moves, used, payload);
+    }
+    return addEncodedGame(name, payload, (int)moves.size(), used, result);
+}
+
+int GameStorage::addEncodedGame(std::string name, const std::vector<uint8_t>& payload, int plies, GameEncoding used, GameResult result) {
+    if (fd < 0 || !writable)
+        return -1;
+    if (name.size() > 0xFFFF)
+        name.resize(0xFFFF);
+
+    RecordHeader record = {};
+    record.magic = recordMagic;
+    record.plies = (uint32_t)plies;
+    record.payloadBytes = (uint32_t)payload.size();
+    record.nameLength = (uint16_t)name.size();
+    record.result = result;
+    record.encoding = used;
+
+    std::vector<char> bytes(recordBytes(record.payloadBytes, record.nameLength), 0);
+    memcpy(bytes.data(), &record, sizeof(record));
+    if (!payload.empty())
+        memcpy(bytes.data() + sizeof(record), payload.data(), payload.size());
+    memcpy(bytes.data() + sizeof(record) + payload.size(), name.data(), name.size());
+    if (!MappedFile::writeAll(fd, bytes.data(), bytes.size(), heapEnd))
+        return -1;
+
+    IndexEntry entry = {};
+    entry.offset = heapEnd;
+    entry.plies = record.plies;
+    entry.payloadBytes = record.payloadBytes;
+    entry.result = result;
+    entry.encoding = used;
+    addEntry(entry, name);
+    heapEnd += bytes.size();
+    dirty = true;
+    return (int)index.size() - 1;
+}
+
+int GameStorage::importFiles(const std::vector<std::string>& files) {
+    int added = 0;
+    std::vector<Move> moves;
+    for (auto it = files.begin(); it != files.end(); it++) {
+        if (!RAFile<Move>::readAll(*it, moves))
+            continue;
+        size_t slash = it->find_last_of('/');
+        std::string name = (slash == std::string::npos) ? *it : it->substr(slash + 1);
+        if (addGame(name, moves, resultOf(moves)) >= 0)
+            added++;
+    }
+    return added;
+}
+
+/*
+ Writes the tail after the last record, trims anything past it, and then points the header at it.
+ durable - syncs the file after the tail and again after the header
+ */
+bool GameStorage::commit(bool durable) {
+    if (fd < 0 || !writable)
+        return false;
+    if (!dirty)
+        return true;
+
+    std::vector<char> tail(index.size() * sizeof(IndexEntry));
+    if (!index.empty())
+        memcpy(tail.data(), index.data(), tail.size());
+    for (size_t i = 0; i < names.size(); i++) {
+        uint16_t length = (uint16_t)names[i].size();
+        const char* bytes = reinterpret_cast<const char*>(&length);
+        tail.insert(tail.end(), bytes, bytes + sizeof(length));
+        tail.insert(tail.end(), names[i].begin(), names[i].end());
+    }
+
+    Header header = {};
+    memcpy(header.magic, storageMagic, sizeof(storageMagic));
+    header.version = storageVersion;
+    header.moveSize = sizeof(Move);
+    header.gameCount = index.size();
+    header.heapEnd = heapEnd;
+    header.tailEnd = heapEnd + tail.size();
+    header.checksum = checksum(tail.data(), tail.size());
+
+    char headerBytes[HeaderBytes] = {};
+    memcpy(headerBytes, &header, sizeof(header));
+    if (!MappedFile::writeAll(fd, tail.data(), tail.size(), heapEnd) || ftruncate(fd, (off_t)header.tailEnd) != 0 ||
+        (durable && fsync(fd) != 0))
+        return false;
+    if (!MappedFile::writeAll(fd, headerBytes, sizeof(headerBytes), 0) || (durable && fsync(fd) != 0))
+        return false;
+    dirty = false;
+    return true;
+}
+
+bool GameStorage::loadGame(int id, std::vector<Move>& moves) const {
+    if (id < 0 || id >= (int)index.size())
+        return false;
+    const IndexEntry& entry = index[id];
+
+    //The record's header and moves in one read
+    std::vector<uint8_t> bytes(sizeof(RecordHeader) + entry.payloadBytes);
+    RecordHeader record;
+    if (!MappedFile::readAll(fd, reinterpret_cast<char*>(bytes.data()), bytes.size(), entry.offset))
+        return false;
+    memcpy(&record, bytes.data(), sizeof(record));
+    if (record.magic != recordMagic || record.plies != entry.plies || record.payloadBytes != entry.payloadBytes)
+        return false;
+    return GameCodec::decode(bytes.data() + sizeof(record), record.payloadBytes, record.plies, (GameEncoding)record.encoding, moves);
+}
+
+int GameStorage::findGame(const std::string& name) const {
+    auto found = ids.find(name);
+    return (found == ids.end()) ? -1 : found->second;
+}
+
+GameInfo GameStorage::info(int id) const {
+    GameInfo result;
+    if (id < 0 || id >= (int)index.size())
+        return result;
+    result.name = names[id];
+    result.plies = (int)index[id].plies;
+    result.result = (GameResult)index[id].result;
+    return result;
+}
+
+/*
+ Records sit in the heap in id order, so the heap is read front to back in chunks of about a megabyte
+ and each game is handed out from the chunk holding it.
+ func - called with each game's id and moves, and stops the walk by returning false
+ */
+void GameStorage::forEachGame(std::function<bool(int id, const std::vector<Move>& moves)> func) const {
+    std::vector<char> chunk;
+    std::vector<Move> moves;
+    int id = 0;
+    while (id < (int)index.size()) {
+        //Takes as many whole records as fit in a chunk, and always at least one
+        uint64_t start = index[id].offset;
+        int last = id;
+        while (last + 1 < (int)index.size() && index[last + 1].offset + recordBytes(index[last + 1].payloadBytes, (uint16_t)names[last + 1].size()) - start <= readChunkBytes)
+            last++;
+        uint64_t end = index[last].offset + recordBytes(index[last].payloadBytes, (uint16_t)names[last].size());
+        chunk.resize((size_t)(end - start));
+        if (!MappedFile::readAll(fd, chunk.data(), chunk.size(), start))
+            return;
+
+        for (; id <= last; id++) {
+            const uint8_t* record = reinterpret_cast<const uint8_t*>(chunk.data()) + (index[id].offset - start);
+            if (!GameCodec::decode(record + sizeof(RecordHeader), index[id].payloadBytes, index[id].plies, (GameEncoding)index[id].encoding, moves))
+                continue;       //A game which can not be decoded is skipped, as loadGame would refuse it
+            if (!func(id, moves))
+                return;
+        }
+    }
 }
 
-GameReturn GameStorage::loadGame() {
-    GameReturn gr;
-    return gr;  //STAND IN
+GameResult GameStorage::resultOf(const std::vector<Move>& moves) {
+    Position pos;
+    pos.reset();
+    for (auto it = moves.begin(); it != moves.end(); it++)
+        if (!pos.applyStoredMove(*it))
+            return ResultUnknown;
+    if (pos.isCheckmate())
+        return pos.isWhiteToMove() ? BlackWins : WhiteWins;
+    if (pos.isStalemate())
+        return DrawnGame;
+    return ResultUnknown;
 }
 
-void GameStorage::manageStorage() {
-    
+GameStorage* GameStorage::defaultStorage() {
+    static GameStorage storage;
+    static bool opened = storage.open("games.db");
+    return opened ? &storage : nullptr;
 }
-*/
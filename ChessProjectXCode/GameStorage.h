@@ -1,44 +1,155 @@
-/*#ifndef GameStorage_H
+#ifndef GameStorage_H
 #define GameStorage_H
 
-#include <map>
-#include "RAFile.h"
 #include "Move.h"
+#include "GameCodec.h"
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <stdint.h>
 
-struct GameReturn {
+//How a stored game ended, as far as the moves show
+enum GameResult : uint8_t {
+    ResultUnknown = 0,      //Unfinished, or resigned or agreed with nothing but the moves to go on
+    WhiteWins = 1,
+    BlackWins = 2,
+    DrawnGame = 3
+};
+
+//What is known about a stored game without reading its moves
+struct GameInfo {
     std::string name;
-    std::vector<Move> game();
+    int plies = 0;
+    GameResult result = ResultUnknown;
 };
 
+/*
+ Many games kept in one file, so an archive is opened with a single open and read with a few large reads
+ rather than one file, and one directory lookup, per game. Moves are compressed by GameCodec, to about
+ half a byte a ply rather than the 16 bytes of a Move, and games it can not compress are kept raw.
+ The file is a header, then a heap of game records which is only ever appended to, then a tail holding a
+ fixed width index entry per game (where its record starts, its length and result) and every game's name.
+ Games are found by id through the index in constant time, and by name through a hash table built from
+ the tail when the file is opened.
+
+ New records are written over the old tail, which is written again after them on commit, with the header
+ last. A crash before the header is written leaves a tail which does not match its checksum, and the index
+ is then rebuilt by walking the records themselves, each of which repeats its own length and name.
+ A writer holds an exclusive lock on the file while it is open; a second process opens it read only.
+ */
 class GameStorage {
 private:
-    //The name of the control file we use for all of the games
-    //static std::string CONTROL_NAME = "overview.txt";
-    
-    //A map with all of our games
-    std::map<std::string, std::vector<Move>> games;
-    
-    //Saves one of the games
-    void saveGame();
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t moveSize;      //sizeof(Move) when the file was written
+        uint64_t gameCount;
+        uint64_t heapEnd;       //Where the tail starts
+        uint64_t tailEnd;       //The size of the file
+        uint64_t checksum;      //Of the tail
+    };
+    struct IndexEntry {
+        uint64_t offset;        //Where the game's record starts
+        uint32_t plies;
+        uint32_t payloadBytes;  //The size of the encoded moves
+        uint8_t result;
+        uint8_t encoding;
+        uint8_t unused[6];
+    };
+    //Starts every record in the heap, followed by the encoded moves, the name, and padding to a multiple of 4 bytes
+    struct RecordHeader {
+        uint32_t magic;
+        uint32_t plies;
+        uint32_t payloadBytes;
+        uint16_t nameLength;
+        uint8_t result;
+        uint8_t encoding;
+    };
+
+    int fd = -1;
+    bool writable = false;
+    bool dirty = false;             //Whether games were added since the tail was last written
+    GameEncoding encoding = RankedMoves;
+    uint64_t heapEnd = 0;
+
+    std::vector<IndexEntry> index;
+    std::vector<std::string> names;
+    std::unordered_map<std::string, int> ids;
+
+    //Reads the index and names from the tail, returning false if it does not match the header
+    bool readTail(const Header& header, uint64_t fileSize);
+    //Builds the index by walking the records in the heap, for when the tail can not be trusted
+    void rebuildIndex(uint64_t fileSize);
+    void addEntry(const IndexEntry& entry, const std::string& name);
+
 public:
-    //Adds a game to our list
-    void addGame(std::string, std::vector<Move>);
-    
-    //When this dies, save all the games by default
+
+    //Bytes before the first record
+    static const size_t HeaderBytes = 64;
+
+    GameStorage() { }
+    //Commits any games added, and closes the file
     ~GameStorage() {
-        saveGames();
+        close();
+    }
+
+    //Opens a database, creating it if it does not exist. Returns false if it could not be read
+    bool open(std::string fileName);
+    void close();
+
+    bool isOpen() const {
+        return fd >= 0;
+    }
+    //Whether games can be added, which is false when another process is writing to the file
+    bool isWritable() const {
+        return writable;
+    }
+
+    //Sets how games added from now on are compressed. Games already stored keep their own encoding
+    void setEncoding(GameEncoding e) {
+        encoding = e;
+    }
+    GameEncoding getEncoding() const {
+        return encoding;
+    }
+
+    //Adds a game to the end of the database, returning its id, or -1 if it could not be written.
+    //A name used before now finds the new game; the old one can still be read by its id
+    int addGame(std::string name, const std::vector<Move>& moves, GameResult result = ResultUnknown);
+
+    //Adds a game already compressed with GameCodec::encode, so the work of encoding can be done on other threads
+    int addEncodedGame(std::string name, const std::vector<uint8_t>& payload, int plies, GameEncoding used, GameResult result = ResultUnknown);
+
+    //Adds every saved game file in the list, named by its file name, returning the number added
+    int importFiles(const std::vector<std::string>& files);
+
+    //Writes the index after the games added, and then the header which makes them part of the file.
+    //durable - waits for each to reach the disk, so a crash can not lose a game once this returns
+    bool commit(bool durable = true);
+
+    //Reads the moves of a game, returning false if there is no such game or it could not be read
+    bool loadGame(int id, std::vector<Move>& moves) const;
+
+    //The id of the game saved last with the name, or -1 if there is none
+    int findGame(const std::string& name) const;
+
+    //The name, length and result of a game, without reading it
+    GameInfo info(int id) const;
+
+    //The number of games stored
+    int size() const {
+        return (int)index.size();
     }
-    
-    //Saves all of our games to text files
-    void saveGames();
-    
-    //Loads a game from a path provided from the user
-    GameReturn loadGame();
-    
-    //Manages storage
-    void manageStorage();
-    
+
+    //Reads every game in id order with large sequential reads, until the function returns false
+    void forEachGame(std::function<bool(int id, const std::vector<Move>& moves)> func) const;
+
+    //Works out the result of a game by replaying it, which finds checkmate and stalemate
+    static GameResult resultOf(const std::vector<Move>& moves);
+
+    //The database the menu saves games to and loads them from, games.db. Returns nullptr if it could not be opened
+    static GameStorage* defaultStorage();
 };
 
 #endif
-*/
@@ -0,0 +1,208 @@
+#include "LoadGenerator.h"
+#include "Position.h"
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <random>
+#include <thread>
+
+LoadGenerator::LoadGenerator(int connections, int gamesPerConnection) :
+    connections(std::max(1, connections)), gamesPerConnection(std::max(1, gamesPerConnection)) { }
+
+static bool writeAll(int fd, const std::string& text) {
+    size_t written = 0;
+    while (written < text.size()) {
+        ssize_t n = write(fd, text.data() + written, text.size() - written);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        written += (size_t)n;
+    }
+    return true;
+}
+
+/*
+ Plays random games on one connection. Each request's id is the number of the game it is for, so the
+ answers can be matched to games whatever order they come in; games being ended are sent with the id -
+ and their answers ignored.
+ path - the server's socket
+ seed - for the choice of moves
+ moves - the number of moves to have answered
+ stats - the totals, added to
+ latencies - the time each move took to be answered, in microseconds, added to
+ */
+bool LoadGenerator::play(const std::string& path, int seed, uint64_t moves, LoadStats& stats, std::vector<uint32_t>& latencies) const {
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return false;
+    if (connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        close(fd);
+        return false;
+    }
+
+    struct Game {
+        std::string id;             //Empty until the server has started the game
+        Position pos;
+        CompactMove move;           //The move in flight
+        int plies = 0;
+        std::chrono::steady_clock::time_point sent;
+    };
+    std::vector<Game> games(gamesPerConnection);
+    std::mt19937 random((unsigned)seed);
+    uint64_t sent = 0, answered = 0;
+    int inFlight = 0;
+    std::string out;
+
+    auto sendMove = [&](int slot) {
+        Game& game = games[slot];
+        MoveList legal;
+        game.pos.generateLegalMoves(legal);
+        //The server's board always promotes to a queen
+        int count = 0;
+        for (int i = 0; i < legal.count; i++)
+            if (!legal[i].isPromotion() || legal[i].promotionType() == QueenType)
+                legal.moves[count++] = legal[i];
+        game.move = legal.moves[random() % count];
+        game.sent = std::chrono::steady_clock::now();
+        out += std::to_string(slot) + " move " + game.id + " " + Position::moveName(game.move) + "\n";
+        sent++;
+        inFlight++;
+    };
+    auto restart = [&](int slot) {
+        Game& game = games[slot];
+        if (!game.id.empty())
+            out += "- end " + game.id + "\n";
+        game.id.clear();
+        game.pos.reset();
+        game.plies = 0;
+        out += std::to_string(slot) + " new\n";
+        inFlight++;
+    };
+
+    for (int slot = 0; slot < gamesPerConnection; slot++)
+        restart(slot);
+
+    std::string input;
+    std::vector<char> buffer(1 << 16);
+    bool failed = false;
+    while (inFlight > 0 && !failed) {
+        if (!out.empty()) {
+            failed = !writeAll(fd, out);
+            out.clear();
+        }
+        ssize_t got = read(fd, buffer.data(), buffer.size());
+        if (got < 0 && errno == EINTR)
+            continue;
+        if (got <= 0)
+            break;
+        input.append(buffer.data(), (size_t)got);
+
+        size_t start = 0, lineEnd;
+        while ((lineEnd = input.find('\n', start)) != std::string::npos) {
+            std::string line = input.substr(start, lineEnd - start);
+            start = lineEnd + 1;
+            if (line[0] == '-')
+                continue;
+            int slot = atoi(line.c_str());
+            if (slot < 0 || slot >= gamesPerConnection)
+                continue;
+            Game& game = games[slot];
+            inFlight--;
+            bool ok = line.find(" ok ") != std::string::npos;
+
+            if (game.id.empty()) {
+                //The answer to new, which must succeed for the run to go on
+                if (!ok) {
+                    failed = true;
+                    break;
+                }
+                game.id = line.substr(line.find(" ok ") + 4);
+                stats.games++;
+            } else {
+                latencies.push_back((uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - game.sent).count());
+                answered++;
+                if (!ok) {
+                    stats.errors++;
+                    if (sent < moves)
+                        restart(slot);
+                    continue;
+                }
+                stats.moves++;
+                UndoInfo undo;
+                game.pos.makeMove(game.move, undo);
+                game.plies++;
+                bool finished = line.find("checkmate") != std::string::npos || line.find("stalemate") != std::string::npos ||
+                                game.plies >= MaxPlies || !game.pos.hasLegalMove();
+                if (finished) {
+                    if (sent < moves)
+                        restart(slot);
+                    continue;
+                }
+            }
+            if (sent < moves)
+                sendMove(slot);
+        }
+        input.erase(0, start);
+    }
+    close(fd);
+    return !failed && answered >= moves;
+}
+
+/*
+ Plays the moves across the connections at once and totals them up
+ path - the server's socket
+ moves - the number of moves to have answered, shared out between the connections
+ stats - filled with the totals and latencies
+ */
+bool LoadGenerator::run(const std::string& path, uint64_t moves, LoadStats& stats) const {
+    signal(SIGPIPE, SIG_IGN);
+    stats = LoadStats();
+    std::vector<uint32_t> latencies;
+    std::mutex statsLock;
+    bool allPlayed = true;
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> threads;
+    for (int c = 0; c < connections; c++) {
+        uint64_t share = moves / connections + ((uint64_t)c < moves % connections ? 1 : 0);
+        threads.push_back(std::thread([&, c, share] {
+            LoadStats mine;
+            std::vector<uint32_t> times;
+            times.reserve(share);
+            bool played = play(path, c + 1, share, mine, times);
+            std::lock_guard<std::mutex> guard(statsLock);
+            stats.moves += mine.moves;
+            stats.errors += mine.errors;
+            stats.games += mine.games;
+            latencies.insert(latencies.end(), times.begin(), times.end());
+            allPlayed = allPlayed && played;
+        }));
+    }
+    for (auto it = threads.begin(); it != threads.end(); it++)
+        it->join();
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (!latencies.empty()) {
+        auto percentile = [&](double fraction) {
+            size_t k = std::min(latencies.size() - 1, (size_t)(fraction * latencies.size()));
+            std::nth_element(latencies.begin(), latencies.begin() + k, latencies.end());
+            return (double)latencies[k];
+        };
+        stats.p50 = percentile(0.50);
+        stats.p99 = percentile(0.99);
+        stats.worst = *std::max_element(latencies.begin(), latencies.end());
+    }
+    return allPlayed;
+}
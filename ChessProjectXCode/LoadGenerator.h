@@ -0,0 +1,47 @@
+#ifndef LoadGenerator_H
+#define LoadGenerator_H
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+//Totals for one run of the load generator, with times in microseconds
+struct LoadStats {
+    uint64_t moves = 0;         //Moves the server accepted
+    uint64_t errors = 0;        //Moves the server refused
+    uint64_t games = 0;         //Games started
+    double seconds = 0;
+    double p50 = 0;             //Median time from sending a move to its answer
+    double p99 = 0;
+    double worst = 0;
+
+    double movesPerSecond() const {
+        return seconds > 0 ? moves / seconds : 0;
+    }
+};
+
+/*
+ Plays random games against a GameServer to measure it. Each connection runs on a thread of its own and
+ keeps one move in flight for every one of its games, choosing among the legal moves of a position it
+ follows itself, and starting a new game when one finishes or reaches MaxPlies. The time from sending each
+ move to reading its answer is kept, to report the median and 99th percentile.
+ */
+class LoadGenerator {
+private:
+    int connections;
+    int gamesPerConnection;
+
+    //Plays on one connection until it has had moves answered, returning false if it could not connect
+    bool play(const std::string& path, int seed, uint64_t moves, LoadStats& stats, std::vector<uint32_t>& latencies) const;
+
+public:
+
+    static const int MaxPlies = 200;
+
+    LoadGenerator(int connections = 16, int gamesPerConnection = 64);
+
+    //Plays moves in all across the connections, returning false if any could not connect
+    bool run(const std::string& path, uint64_t moves, LoadStats& stats) const;
+};
+
+#endif
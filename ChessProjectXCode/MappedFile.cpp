@@ -0,0 +1,74 @@
+#include "MappedFile.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+bool MappedFile::open(const std::string& fileName) {
+    close();
+    fd = ::open(fileName.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        close();
+        return false;
+    }
+    fileBytes = (size_t)info.st_size;
+    return true;
+}
+
+bool MappedFile::map(bool random) {
+    if (fd < 0 || fileBytes == 0) {
+        close();
+        return false;
+    }
+    mapping = mmap(nullptr, fileBytes, PROT_READ, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED) {
+        mapping = nullptr;
+        close();
+        return false;
+    }
+    if (random)
+        madvise(mapping, fileBytes, MADV_RANDOM);
+    return true;
+}
+
+void MappedFile::adviseSequential() const {
+    if (mapping != nullptr)
+        madvise(mapping, fileBytes, MADV_SEQUENTIAL);
+}
+
+void MappedFile::close() {
+    if (mapping != nullptr)
+        munmap(mapping, fileBytes);
+    if (fd >= 0)
+        ::close(fd);
+    mapping = nullptr;
+    fileBytes = 0;
+    fd = -1;
+}
+
+bool MappedFile::writeAll(int fd, const char* data, size_t bytes, uint64_t offset) {
+    while (bytes > 0) {
+        ssize_t written = pwrite(fd, data, bytes, (off_t)offset);
+        if (written <= 0)
+            return false;
+        data += written;
+        bytes -= (size_t)written;
+        offset += (uint64_t)written;
+    }
+    return true;
+}
+
+bool MappedFile::readAll(int fd, char* data, size_t bytes, uint64_t offset) {
+    while (bytes > 0) {
+        ssize_t got = pread(fd, data, bytes, (off_t)offset);
+        if (got <= 0)
+            return false;
+        data += got;
+        bytes -= (size_t)got;
+        offset += (uint64_t)got;
+    }
+    return true;
+}
@@ -0,0 +1,61 @@
+#ifndef MappedFile_H
+#define MappedFile_H
+
+#include <string>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ A file mapped read only, as the index, explorer, training, book and tablebase files are read. The file is
+ opened first so its header can be read and checked, and only then mapped whole; whatever fails along the
+ way leaves it closed. Also holds the loops for reading and writing at an offset, which pread and pwrite
+ may do in several goes.
+ */
+class MappedFile {
+private:
+    int fd = -1;
+    void* mapping = nullptr;
+    size_t fileBytes = 0;
+
+public:
+
+    MappedFile() { }
+    ~MappedFile() {
+        close();
+    }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    //Opens the file to read, returning false if it is missing
+    bool open(const std::string& fileName);
+    //Maps the whole of the open file, closing it if it can not be.
+    //random - for files read at scattered places, where reading ahead would only bring in pages never used
+    bool map(bool random);
+    //Lets the kernel read further ahead of a mapping read once from start to end, and drop what is behind
+    void adviseSequential() const;
+    void close();
+
+    //Reads from the open file, whether or not it is mapped yet
+    bool read(void* data, size_t bytes, uint64_t offset) const {
+        return fd >= 0 && readAll(fd, static_cast<char*>(data), bytes, offset);
+    }
+
+    bool isMapped() const {
+        return mapping != nullptr;
+    }
+    //The size of the open file
+    size_t size() const {
+        return fileBytes;
+    }
+    //The mapped bytes, null until map succeeds
+    const char* data() const {
+        return static_cast<const char*>(mapping);
+    }
+
+    //Writes all of the bytes, as pwrite may write fewer than asked
+    static bool writeAll(int fd, const char* data, size_t bytes, uint64_t offset);
+    //Reads all of the bytes, failing at the end of the file
+    static bool readAll(int fd, char* data, size_t bytes, uint64_t offset);
+};
+
+#endif
@@ -0,0 +1,262 @@
+#include "MateSolver.h"
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+
+static const uint32_t Infinite = 1u << 30;
+
+//Adds proof numbers, stopping at Infinite
+static uint32_t addNumbers(uint32_t a, uint32_t b) {
+    uint64_t sum = (uint64_t)a + b;
+    return (sum >= Infinite) ? Infinite : (uint32_t)sum;
+}
+
+MateSolver::MateSolver(size_t megabytes) {
+    size_t count = 2;
+    while (count * 2 * sizeof(Entry) <= megabytes * 1024 * 1024)
+        count *= 2;
+    table.resize(count);
+    mask = count - 1;
+    clear();
+}
+
+void MateSolver::clear() {
+    for (auto it = table.begin(); it != table.end(); it++) {
+        it->key = 0;
+        it->phi = 1;
+        it->delta = 1;
+        it->work = 0;
+    }
+}
+
+uint64_t MateSolver::nodeKey(const Position& pos, int plies) {
+    return pos.key() ^ ((uint64_t)(plies + 1) * 0x9E3779B97F4A7C15ULL);
+}
+
+//Entries live in pairs, so a new entry only pushes out the less worked-on of two
+void MateSolver::lookup(uint64_t key, uint32_t& phi, uint32_t& delta) const {
+    size_t index = key & mask & ~(uint64_t)1;
+    for (size_t i = index; i < index + 2; i++) {
+        if (table[i].key == key) {
+            phi = table[i].phi;
+            delta = table[i].delta;
+            return;
+        }
+    }
+}
+
+void MateSolver::store(uint64_t key, uint32_t phi, uint32_t delta, uint32_t work) {
+    size_t index = key & mask & ~(uint64_t)1;
+    Entry* slot = &table[index];
+    if (table[index + 1].key == key || (table[index].key != key && table[index + 1].work < table[index].work))
+        slot = &table[index + 1];
+    slot->key = key;
+    slot->phi = phi;
+    slot->delta = delta;
+    slot->work = work;
+}
+
+/*
+ Multiple iterative deepening: expands the most proving child until this node's numbers pass a threshold.
+ Numbers are held from the point of view of the side to move, phi being the cost of reaching its goal
+ (mating as the attacker, escaping as the defender) and delta the cost of the opponent reaching theirs.
+ pos - the node
+ thPhi, thDelta - the thresholds
+ plies - the plies left for the attacker to mate in
+ */
+void MateSolver::mid(Position& pos, uint32_t thPhi, uint32_t thDelta, int plies) {
+    uint64_t startNodes = nodes++;
+    uint64_t key = nodeKey(pos, plies);
+    bool attacker = (plies % 2) == 1;
+
+    MoveList moves;
+    pos.generateLegalMoves(moves);
+
+    //Terminal nodes: no moves at all, or the defender has survived every ply
+    if (moves.count == 0 || (!attacker && plies == 0)) {
+        bool moverWins = (moves.count != 0) || (!attacker && !pos.inCheck());
+        store(key, moverWins ? 0 : Infinite, moverWins ? Infinite : 0, 1);
+        return;
+    }
+
+    //Children not yet in the table start from estimates. Below the attacker, the defender's number of
+    //replies is used, so checks which leave few replies are tried first
+    uint64_t childKeys[256];
+    uint32_t startPhi[256];
+    uint32_t startDelta[256];
+    for (int i = 0; i < moves.count; i++) {
+        UndoInfo undo;
+        pos.makeMove(moves[i], undo);
+        childKeys[i] = nodeKey(pos, plies - 1);
+        startPhi[i] = 1;
+        startDelta[i] = 1;
+        if (attacker) {
+            MoveList replies;
+            pos.generateLegalMoves(replies);
+            if (replies.count == 0) {
+                bool mated = pos.inCheck();
+                startPhi[i] = mated ? Infinite : 0;
+                startDelta[i] = mated ? 0 : Infinite;
+                store(childKeys[i], startPhi[i], startDelta[i], 1);
+            } else {
+                startDelta[i] = (uint32_t)replies.count;
+            }
+        }
+        pos.unmakeMove(moves[i], undo);
+    }
+
+    uint32_t phi = 0, delta = 0;
+    while (true) {
+        //This node's phi is the cheapest child delta, and its delta is the sum of the child phis
+        phi = Infinite;
+        delta = 0;
+        uint32_t secondDelta = Infinite;
+        uint32_t bestPhi = 0;
+        int best = 0;
+        for (int i = 0; i < moves.count; i++) {
+            uint32_t childPhi = startPhi[i], childDelta = startDelta[i];
+            lookup(childKeys[i], childPhi, childDelta);
+            delta = addNumbers(delta, childPhi);
+            if (childDelta < phi) {
+                secondDelta = phi;
+                phi = childDelta;
+                bestPhi = childPhi;
+                best = i;
+            } else if (childDelta < secondDelta) {
+                secondDelta = childDelta;
+            }
+        }
+
+        if (phi >= thPhi || delta >= thDelta || (nodeLimit != 0 && nodes >= nodeLimit))
+            break;
+
+        uint32_t childThPhi = addNumbers(thDelta - delta, bestPhi);
+        uint32_t childThDelta = std::min(thPhi, addNumbers(secondDelta, 1));
+
+        UndoInfo undo;
+        pos.makeMove(moves[best], undo);
+        mid(pos, childThPhi, childThDelta, plies - 1);
+        pos.unmakeMove(moves[best], undo);
+    }
+
+    uint64_t work = nodes - startNodes;
+    store(key, phi, delta, (uint32_t)std::min<uint64_t>(work, 0xFFFFFFFF));
+}
+
+/*
+ Searches for the shortest mate, trying one move, then two, up to maxMoves
+ root - the position, with the attacker to move
+ maxMoves - the longest mate to look for
+ nodeLimit - the most nodes to search, over every length, or 0 for no limit
+ mateIn, best - filled with the length and first move of the mate, when one is found
+ */
+MateResult MateSolver::solve(const Position& root, int maxMoves, uint64_t nodeLimit, int& mateIn, CompactMove& best) {
+    Position pos = root;
+    nodes = 0;
+    this->nodeLimit = nodeLimit;
+
+    for (int n = 1; n <= maxMoves; n++) {
+        int plies = 2 * n - 1;
+        uint64_t key = nodeKey(pos, plies);
+        uint32_t phi = 1, delta = 1;
+        mid(pos, Infinite, Infinite, plies);
+        lookup(key, phi, delta);
+
+        if (phi == 0) {
+            //The mating move is the one leading to a position the defender has lost
+            MoveList moves;
+            pos.generateLegalMoves(moves);
+            uint32_t bestDelta = Infinite;
+            for (int i = 0; i < moves.count; i++) {
+                UndoInfo undo;
+                uint32_t childPhi = 1, childDelta = 1;
+                pos.makeMove(moves[i], undo);
+                lookup(nodeKey(pos, plies - 1), childPhi, childDelta);
+                pos.unmakeMove(moves[i], undo);
+                if (childDelta < bestDelta || (childDelta == bestDelta && best.isNull())) {
+                    bestDelta = childDelta;
+                    best = moves[i];
+                }
+            }
+            mateIn = n;
+            return MateFound;
+        }
+        if (phi != Infinite)
+            return MateUnknown;
+    }
+    return NoMate;
+}
+
+int MateSolver::solveFile(std::string fileName, int defaultMoves, uint64_t nodeLimit, std::ostream& output) {
+    std::ifstream input(fileName);
+    if (!input.is_open()) {
+        output << "The file " << fileName << " could not be opened." << std::endl;
+        return 0;
+    }
+
+    std::vector<std::string> fens;
+    std::vector<int> lengths;
+    std::string line;
+    while (getline(input, line)) {
+        if (line.empty() || line[0] == '#')
+            continue;
+        size_t split = line.find(';');
+        int moves = defaultMoves;
+        if (split != std::string::npos) {
+            std::istringstream(line.substr(split + 1)) >> moves;
+            line = line.substr(0, split);
+        }
+        fens.push_back(line);
+        lengths.push_back(moves);
+    }
+
+    std::vector<std::string> results(fens.size());
+    std::atomic<size_t> next(0);
+    std::atomic<int> solved(0);
+    auto start = std::chrono::steady_clock::now();
+
+    int threadCount = std::max(1, (int)std::thread::hardware_concurrency());
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threadCount; t++) {
+        workers.push_back(std::thread([&] () {
+            MateSolver solver(8);
+            size_t i;
+            while ((i = next++) < fens.size()) {
+                std::ostringstream result;
+                Position pos;
+                int mateIn = 0;
+                CompactMove best;
+                if (!pos.setFromFen(fens[i])) {
+                    result << "invalid position";
+                } else {
+                    switch (solver.solve(pos, lengths[i], nodeLimit, mateIn, best)) {
+                        case MateFound:
+                            result << "mate in " << mateIn << ", starting " << Position::moveName(best);
+                            solved++;
+                            break;
+                        case NoMate:
+                            result << "no mate in " << lengths[i];
+                            solved++;
+                            break;
+                        case MateUnknown:
+                            result << "unknown after " << solver.nodeCount() << " nodes";
+                            break;
+                    }
+                }
+                results[i] = result.str();
+            }
+        }));
+    }
+    for (auto it = workers.begin(); it != workers.end(); it++)
+        it->join();
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    for (size_t i = 0; i < results.size(); i++)
+        output << (i + 1) << ": " << results[i] << std::endl;
+    output << "Solved " << solved << " of " << fens.size() << " positions in " << seconds << " seconds ("
+           << (seconds > 0 ? solved / seconds : 0) << " solved/sec)" << std::endl;
+    return solved;
+}
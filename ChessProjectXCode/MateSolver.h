@@ -0,0 +1,73 @@
+#ifndef MateSolver_H
+#define MateSolver_H
+
+#include "Position.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <ostream>
+
+//The answer to a mate search
+enum MateResult {
+    MateFound,
+    NoMate,         //Proven that there is no mate within the moves allowed
+    MateUnknown     //The node budget ran out first
+};
+
+/*
+ Solves "mate in N" problems with depth-first proof-number search (df-pn).
+ Rather than searching every line to a fixed depth, df-pn always expands the line which is
+ closest to proving or disproving the mate, so forced mates are found in a small fraction of
+ the nodes an alpha-beta search would need. Proof and disproof numbers are kept in a bounded
+ table, which forgets the least worked-on entries when it fills.
+ */
+class MateSolver {
+private:
+    struct Entry {
+        uint64_t key;
+        uint32_t phi;
+        uint32_t delta;
+        uint32_t work;
+    };
+
+    std::vector<Entry> table;
+    uint64_t mask;
+    uint64_t nodes = 0;
+    uint64_t nodeLimit = 0;
+
+    //Looks up the numbers for a node key, leaving phi and delta untouched if it is not in the table
+    void lookup(uint64_t key, uint32_t& phi, uint32_t& delta) const;
+    void store(uint64_t key, uint32_t phi, uint32_t delta, uint32_t work);
+
+    //The key of a position with the given plies remaining, since a proof with fewer plies left means something different
+    static uint64_t nodeKey(const Position& pos, int plies);
+
+    //Expands the node until its numbers pass either threshold
+    void mid(Position& pos, uint32_t thPhi, uint32_t thDelta, int plies);
+
+public:
+
+    //megabytes - size of the proof number table
+    MateSolver(size_t megabytes = 16);
+
+    //Looks for a mate in at most maxMoves moves for the side to move, searching at most nodeLimit nodes
+    //(0 for no limit). On success, mateIn holds the shortest mate found and best the first move of it
+    MateResult solve(const Position& root, int maxMoves, uint64_t nodeLimit, int& mateIn, CompactMove& best);
+
+    //Empties the table
+    void clear();
+
+    uint64_t nodeCount() const {
+        return nodes;
+    }
+
+    /*
+     Solves every position in a file across all cores. Each line holds a FEN, optionally followed
+     by ';' and the number of moves to search for a mate in, otherwise defaultMoves is used.
+     Results are written to output in the order of the file, followed by the solving rate.
+     Returns the number of positions solved
+     */
+    static int solveFile(std::string fileName, int defaultMoves, uint64_t nodeLimit, std::ostream& output);
+};
+
+#endif
@@ -0,0 +1,285 @@
+#include "MonteCarlo.h"
+#include <thread>
+#include <cmath>
+#include <algorithm>
+
+enum NodeState : uint8_t {
+    Unexpanded = 0,
+    Expanding,
+    Expanded
+};
+
+//Visits added to a node while a thread is below it, so other threads look elsewhere
+static const uint32_t VirtualLoss = 3;
+//The exploration constant of UCT
+static const double Exploration = 1.0;
+//Deepest the tree is walked, which is far more than it ever grows
+static const int MaxTreeDepth = 128;
+
+//xorshift64*, which is plenty random for picking moves and costs almost nothing
+static uint64_t nextRandom(uint64_t& state) {
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * 0x2545F4914F6CDD1DULL;
+}
+
+MonteCarloNodePool::MonteCarloNodePool(size_t megabytes) : nodes(std::max<size_t>(megabytes * 1024 * 1024 / sizeof(MonteCarloNode), 1024)) {
+    clear();
+}
+
+//Index 0 is never handed out, so it can mean "no node"
+void MonteCarloNodePool::clear() {
+    used = 1;
+}
+
+uint32_t MonteCarloNodePool::allocate(int count) {
+    uint32_t first = used.fetch_add(count);
+    if (first + (size_t)count > nodes.size()) {
+        used = (uint32_t)nodes.size();
+        return 0;
+    }
+    for (uint32_t i = first; i < first + count; i++) {
+        nodes[i].firstChild.store(0, std::memory_order_relaxed);
+        nodes[i].visits.store(0, std::memory_order_relaxed);
+        nodes[i].halfPoints.store(0, std::memory_order_relaxed);
+        nodes[i].state.store(Unexpanded, std::memory_order_relaxed);
+        nodes[i].childCount = 0;
+    }
+    return first;
+}
+
+MonteCarloSearch::MonteCarloSearch(size_t megabytes) : pool(megabytes), stopFlag(false), playouts(0) {
+}
+
+/*
+ Plays random moves until the game ends. Pseudo legal moves are generated and tried in a random
+ order, throwing away any which leave the king in check, which is far cheaper than generating only
+ legal moves. Half of the time a capture is tried first when there is one, so that pieces left
+ hanging are usually taken as a real player would.
+ pos - the position to play out, which is left at the end of the game
+ rng - the random state of the calling thread
+ */
+int MonteCarloSearch::playout(Position& pos, uint64_t& rng) {
+    bool startingSide = pos.isWhiteToMove();
+    MoveList list;
+
+    for (int ply = 0; ply < MaxPlayoutPlies; ply++) {
+        if (pos.getHalfmoveClock() >= 100)
+            return 1;
+
+        pos.generatePseudoLegalMoves(list);
+
+        //Moves the captures to the front of the list
+        int captures = 0;
+        for (int i = 0; i < list.count; i++) {
+            if (pos.at(list[i].to()) != NoPiece || list[i].special() == EnPassant)
+                std::swap(list[i], list[captures++]);
+        }
+
+        bool moved = false;
+        while (list.count > 0) {
+            bool capture = captures > 0 && (int)(nextRandom(rng) % 100) < CaptureBias;
+            int i = capture ? (int)(nextRandom(rng) % captures) : (int)(nextRandom(rng) % list.count);
+
+            CompactMove m = list[i];
+            UndoInfo undo;
+            pos.makeMove(m, undo);
+            if (!pos.isAttacked(pos.kingLocation(!pos.isWhiteToMove()), pos.isWhiteToMove())) {
+                moved = true;
+                break;
+            }
+            pos.unmakeMove(m, undo);
+
+            //Drops the illegal move, keeping the captures at the front
+            if (i < captures) {
+                std::swap(list[i], list[captures - 1]);
+                i = --captures;
+            }
+            std::swap(list[i], list[--list.count]);
+        }
+
+        if (!moved) {
+            //Checkmate scores nothing for the side that is mated, and stalemate is a draw
+            if (!pos.inCheck())
+                return 1;
+            return (pos.isWhiteToMove() == startingSide) ? 0 : 2;
+        }
+    }
+
+    //Games which run too long are decided by the evaluation, calling anything close a draw
+    int score = Evaluation::evaluate(pos);
+    if (!startingSide)
+        score = -score;
+    return (score > 150) ? 2 : (score < -150) ? 0 : 1;
+}
+
+/*
+ Allocates a child for every legal move of the node
+ index - the node to expand
+ pos - the position at the node
+ onlyMoves - if not empty, the only moves to give children to
+ */
+bool MonteCarloSearch::expand(uint32_t index, Position& pos, const std::vector<CompactMove>& onlyMoves) {
+    MonteCarloNode& node = pool[index];
+    uint8_t expected = Unexpanded;
+    if (!node.state.compare_exchange_strong(expected, Expanding))
+        return false;
+
+    MoveList legal;
+    pos.generateLegalMoves(legal);
+    if (!onlyMoves.empty()) {
+        int kept = 0;
+        for (int i = 0; i < legal.count; i++) {
+            if (std::find(onlyMoves.begin(), onlyMoves.end(), legal[i]) != onlyMoves.end())
+                legal[kept++] = legal[i];
+        }
+        legal.count = kept;
+    }
+
+    uint32_t first = (legal.count > 0) ? pool.allocate(legal.count) : 0;
+    if (legal.count > 0 && first == 0) {
+        //Out of nodes, so this stays a leaf and the search winds up
+        node.state = Unexpanded;
+        stopFlag = true;
+        return false;
+    }
+
+    for (int i = 0; i < legal.count; i++)
+        pool[first + i].move = legal[i];
+    node.childCount = (uint8_t)std::min(legal.count, 255);
+    node.firstChild.store(first, std::memory_order_release);
+    node.state.store(Expanded, std::memory_order_release);
+    return true;
+}
+
+/*
+ UCT: the child with the best average score plus a bonus which grows for children visited less than
+ their siblings. Unvisited children are always tried first.
+ index - the node, which must be expanded and have children
+ */
+uint32_t MonteCarloSearch::select(uint32_t index) {
+    MonteCarloNode& node = pool[index];
+    uint32_t first = node.firstChild.load(std::memory_order_acquire);
+    double logVisits = std::log((double)std::max<uint32_t>(node.visits.load(std::memory_order_relaxed), 1));
+
+    uint32_t best = first;
+    double bestValue = -1;
+    for (uint32_t c = first; c < first + node.childCount; c++) {
+        uint32_t visits = pool[c].visits.load(std::memory_order_relaxed);
+        if (visits == 0)
+            return c;
+        double mean = pool[c].halfPoints.load(std::memory_order_relaxed) / (2.0 * visits);
+        double value = mean + Exploration * std::sqrt(logVisits / visits);
+        if (value > bestValue) {
+            bestValue = value;
+            best = c;
+        }
+    }
+    return best;
+}
+
+/*
+ One search thread. Each pass walks down the tree adding virtual losses, grows the tree by one node,
+ plays a random game from it, then replaces the virtual losses with the real result.
+ rootPos - the position at the root
+ limits - when to stop
+ seed - seeds this thread's random moves
+ */
+void MonteCarloSearch::worker(const Position& rootPos, const SearchLimits& limits, uint64_t seed) {
+    uint64_t rng = seed * 0x9E3779B97F4A7C15ULL + 1;
+    uint32_t path[MaxTreeDepth + 1];
+    std::vector<CompactMove> noFilter;
+
+    for (uint64_t count = 0; !stopFlag; count++) {
+        Position pos = rootPos;
+        int depth = 0;
+        uint32_t index = root;
+        path[depth++] = index;
+        pool[index].visits.fetch_add(VirtualLoss, std::memory_order_relaxed);
+
+        //Walks down to a leaf
+        while (depth < MaxTreeDepth && pool[index].state.load(std::memory_order_acquire) == Expanded &&
+               pool[index].childCount > 0) {
+            index = select(index);
+            UndoInfo undo;
+            pos.makeMove(pool[index].move, undo);
+            path[depth++] = index;
+            pool[index].visits.fetch_add(VirtualLoss, std::memory_order_relaxed);
+        }
+
+        //Grows the tree below a leaf which has been visited before, and steps into one of the new children
+        if (depth < MaxTreeDepth && pool[index].visits.load(std::memory_order_relaxed) > VirtualLoss &&
+            expand(index, pos, noFilter) && pool[index].childCount > 0) {
+            index = select(index);
+            UndoInfo undo;
+            pos.makeMove(pool[index].move, undo);
+            path[depth++] = index;
+            pool[index].visits.fetch_add(VirtualLoss, std::memory_order_relaxed);
+        }
+
+        //The result for the side to move at the leaf, which is the opponent of whoever played into it
+        int result = playout(pos, rng);
+        for (int d = depth - 1; d >= 0; d--) {
+            result = 2 - result;
+            pool[path[d]].halfPoints.fetch_add(result, std::memory_order_relaxed);
+            pool[path[d]].visits.fetch_sub(VirtualLoss - 1, std::memory_order_relaxed);
+        }
+
+        uint64_t total = ++playouts;
+        if (limits.nodes != 0 && total >= limits.nodes)
+            stopFlag = true;
+        if (limits.timeMs != 0 && (count & 63) == 0 &&
+            std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count() >= limits.timeMs)
+            stopFlag = true;
+    }
+}
+
+/*
+ Builds a fresh tree for the position across every thread asked for, then plays the root move which
+ was visited the most.
+ root - the position to search, which must have a legal move
+ limits - playouts (nodes) and time allowed; with neither set the search would never end, so one second is used
+ rootMoves - if not empty, only these moves are considered at the root
+ */
+MonteCarloResult MonteCarloSearch::search(const Position& rootPos, const SearchLimits& limits,
+                                          const std::vector<CompactMove>& rootMoves) {
+    MonteCarloResult result;
+    SearchLimits used = limits;
+    if (used.nodes == 0 && used.timeMs == 0)
+        used.timeMs = 1000;
+
+    start = std::chrono::steady_clock::now();
+    stopFlag = false;
+    playouts = 0;
+    pool.clear();
+    root = pool.allocate(1);
+
+    Position pos = rootPos;
+    expand(root, pos, rootMoves);
+    if (pool[root].childCount == 0)
+        return result;
+
+    int threadCount = (used.threads > 0) ? used.threads : (int)std::thread::hardware_concurrency();
+    threadCount = std::max(threadCount, 1);
+    std::vector<std::thread> threads;
+    for (int t = 1; t < threadCount; t++)
+        threads.push_back(std::thread(&MonteCarloSearch::worker, this, std::cref(rootPos), std::cref(used), (uint64_t)t));
+    worker(rootPos, used, 0);
+    for (auto it = threads.begin(); it != threads.end(); it++)
+        it->join();
+
+    uint32_t first = pool[root].firstChild;
+    uint32_t best = first;
+    for (uint32_t c = first; c < first + pool[root].childCount; c++) {
+        if (pool[c].visits > pool[best].visits)
+            best = c;
+    }
+
+    result.best = pool[best].move;
+    result.winRate = pool[best].visits ? pool[best].halfPoints / (2.0 * pool[best].visits) : 0;
+    result.playouts = playouts;
+    result.treeNodes = pool.size();
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
@@ -0,0 +1,110 @@
+#ifndef MonteCarlo_H
+#define MonteCarlo_H
+
+#include "Position.h"
+#include "Engine.h"
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <stdint.h>
+
+//The outcome of a Monte Carlo search
+struct MonteCarloResult {
+    CompactMove best;
+    double winRate = 0;         //Expected score of the best move for the side to move, from 0 to 1
+    uint64_t playouts = 0;      //Summed over all threads
+    uint64_t treeNodes = 0;
+    double seconds = 0;
+
+    double playoutsPerSecond() const {
+        return seconds > 0 ? playouts / seconds : 0;
+    }
+};
+
+/*
+ A tree node. Children of a node are allocated together, so a node only needs the index of its first
+ child. Scores are kept in half points so draws can be counted without floating point atomics.
+ */
+struct MonteCarloNode {
+    std::atomic<uint32_t> firstChild;
+    std::atomic<uint32_t> visits;
+    std::atomic<uint32_t> halfPoints;   //For the side which played move
+    std::atomic<uint8_t> state;         //Unexpanded, Expanding or Expanded
+    uint8_t childCount;
+    CompactMove move;
+};
+
+/*
+ Hands out nodes from one preallocated array, so building the tree never touches the heap and the
+ whole tree is dropped at once by resetting the count.
+ */
+class MonteCarloNodePool {
+private:
+    std::vector<MonteCarloNode> nodes;
+    std::atomic<uint32_t> used;
+
+public:
+
+    MonteCarloNodePool(size_t megabytes);
+
+    //Allocates count consecutive nodes, returning the index of the first, or 0 if the pool is full
+    uint32_t allocate(int count);
+
+    void clear();
+
+    MonteCarloNode& operator[](uint32_t index) {
+        return nodes[index];
+    }
+
+    uint32_t size() const {
+        return used;
+    }
+    size_t capacity() const {
+        return nodes.size();
+    }
+};
+
+/*
+ Plays with Monte Carlo tree search: moves are chosen with UCT, and positions are scored by playing
+ random games out to the end, preferring captures. Threads share one tree, adding a virtual loss to
+ each node on their way down so that other threads spread out to different lines.
+ Limits use the engine's SearchLimits, with nodes counting playouts.
+ */
+class MonteCarloSearch {
+private:
+    MonteCarloNodePool pool;
+    std::atomic<bool> stopFlag;
+    std::atomic<uint64_t> playouts;
+    std::chrono::steady_clock::time_point start;
+    uint32_t root = 0;
+
+    //Gives a node one child per legal move, returning false if another thread got there first or the pool is full
+    bool expand(uint32_t index, Position& pos, const std::vector<CompactMove>& onlyMoves);
+    //Picks the child with the best upper confidence bound
+    uint32_t select(uint32_t index);
+    void worker(const Position& rootPos, const SearchLimits& limits, uint64_t seed);
+
+public:
+
+    //Plies a playout may last before it is scored from the material left
+    static const int MaxPlayoutPlies = 200;
+    //Chance out of 100 that a playout captures when it can
+    static const int CaptureBias = 50;
+
+    MonteCarloSearch(size_t megabytes = 64);
+
+    //Searches the position within the limits.
+    //rootMoves - if not empty, only these moves are considered at the root
+    MonteCarloResult search(const Position& root, const SearchLimits& limits,
+                            const std::vector<CompactMove>& rootMoves = std::vector<CompactMove>());
+
+    //Asks a running search to stop as soon as it can
+    void stop() {
+        stopFlag = true;
+    }
+
+    //Plays one random game from the position and returns the half points it scores for the side to move
+    static int playout(Position& pos, uint64_t& rng);
+};
+
+#endif
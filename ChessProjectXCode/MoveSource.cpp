@@ -0,0 +1,139 @@
+#include "MoveSource.h"
+#include "GameLoop.h"
+#include <memory>
+#include <random>
+#include <thread>
+
+void MoveSource::Pending::complete(CompactMove m) {
+    move = m;
+    if (scheduler != nullptr)
+        scheduler->post(waiter);
+    else
+        waiter.resume();
+}
+
+CompactMove MoveSource::parseMove(const Position& pos, const std::string& text) {
+    Position copy = pos;
+    CompactMove m = copy.fromSan(text);
+    if (!m.isNull())
+        return m;
+    MoveList legal;
+    copy.generateLegalMoves(legal);
+    for (int i = 0; i < legal.count; i++)
+        if (Position::moveName(legal[i]) == text)
+            return legal[i];
+    return CompactMove();
+}
+
+void MoveSource::storableMoves(const Position& pos, MoveList& list) {
+    Position copy = pos;
+    MoveList legal;
+    copy.generateLegalMoves(legal);
+    list.count = 0;
+    for (int i = 0; i < legal.count; i++)
+        if (!legal[i].isPromotion() || legal[i].promotionType() == QueenType)
+            list.add(legal[i]);
+}
+
+bool RandomMoveSource::choose(const Position& pos, Pending& pending) {
+    static thread_local std::mt19937 random((unsigned)std::hash<std::thread::id>()(std::this_thread::get_id()));
+    MoveList candidates;
+    storableMoves(pos, candidates);
+    setMove(pending, candidates.count > 0 ? candidates[(int)(random() % candidates.count)] : CompactMove());
+    return true;
+}
+
+EngineMoveSource::EngineMoveSource(SearchLimits limits) : limits(limits) {
+    //The games share out the cores between them
+    this->limits.threads = 1;
+}
+
+bool EngineMoveSource::choose(const Position& pos, Pending& pending) {
+    //A small table each, as a thread may be playing many games
+    static thread_local std::unique_ptr<Engine> engine(new Engine(4));
+    MoveList candidates;
+    storableMoves(pos, candidates);
+    if (candidates.count == 0) {
+        setMove(pending, CompactMove());
+        return true;
+    }
+    std::vector<CompactMove> rootMoves(candidates.moves, candidates.moves + candidates.count);
+    setMove(pending, engine->search(pos, limits, rootMoves).best);
+    return true;
+}
+
+bool ReplayMoveSource::choose(const Position& pos, Pending& pending) {
+    CompactMove m;
+    if (next < moves.size())
+        m = pos.fromStoredMove(moves[next++]);
+    setMove(pending, m);
+    return true;
+}
+
+bool StreamMoveSource::choose(const Position& pos, Pending& pending) {
+    std::string line;
+    while (true) {
+        if (prompt != nullptr)
+            *prompt << (pos.isWhiteToMove() ? "White" : "Black") << " to move> " << std::flush;
+        if (!std::getline(input, line)) {
+            setMove(pending, CompactMove());
+            return true;
+        }
+        size_t start = line.find_first_not_of(" \t\r");
+        if (start == std::string::npos)
+            continue;
+        line = line.substr(start, line.find_last_not_of(" \t\r") + 1 - start);
+        CompactMove m = parseMove(pos, line);
+        if (!m.isNull() || prompt == nullptr) {
+            setMove(pending, m);
+            return true;
+        }
+        *prompt << line << " is not a legal move." << std::endl;
+    }
+}
+
+bool QueuedMoveSource::choose(const Position& pos, Pending& pending) {
+    std::lock_guard<std::mutex> guard(lock);
+    if (!queued.empty()) {
+        setMove(pending, parseMove(pos, queued.front()));
+        queued.pop_front();
+        return true;
+    }
+    if (closed) {
+        setMove(pending, CompactMove());
+        return true;
+    }
+    waiting = &pending;
+    waitingPosition = &pos;
+    return false;
+}
+
+void QueuedMoveSource::push(const std::string& move) {
+    Pending* pending;
+    CompactMove m;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (waiting == nullptr) {
+            queued.push_back(move);
+            return;
+        }
+        pending = waiting;
+        m = parseMove(*waitingPosition, move);
+        waiting = nullptr;
+    }
+    //Completed outside the lock, as the game may carry on here and ask for its next move at once
+    pending->complete(m);
+}
+
+void QueuedMoveSource::close() {
+    Pending* pending;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        closed = true;
+        if (waiting == nullptr)
+            return;
+        pending = waiting;
+        waiting = nullptr;
+    }
+    pending->complete(CompactMove());
+}
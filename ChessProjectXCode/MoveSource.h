@@ -0,0 +1,151 @@
+#ifndef MoveSource_H
+#define MoveSource_H
+
+#include "Position.h"
+#include "Engine.h"
+#include "Move.h"
+#include <coroutine>
+#include <deque>
+#include <istream>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+class GameScheduler;
+
+/*
+ Where one side of a game gets its moves, which a game coroutine waits on with
+    CompactMove m = co_await source.move(pos);
+ A source either chooses at once, as an engine or a saved game does, or keeps the request and completes
+ it later from any thread, as a player on a socket does, the game waiting meanwhile without a thread.
+ */
+class MoveSource {
+public:
+    //A request for a move, completed by the source when it is not answered at once
+    class Pending {
+    private:
+        CompactMove move;
+        std::coroutine_handle<> waiter;
+        GameScheduler* scheduler = nullptr;
+
+        friend class MoveSource;
+
+    public:
+        //Gives the waiting game its move, a null move to resign, and sets it going again
+        void complete(CompactMove m);
+    };
+
+    struct Request {
+        MoveSource* source;
+        const Position* position;
+    };
+
+    class Awaiter {
+    private:
+        Request request;
+        Pending pending;
+
+    public:
+        Awaiter(Request request, GameScheduler* scheduler) : request(request) {
+            pending.scheduler = scheduler;
+        }
+        bool await_ready() const noexcept {
+            return false;
+        }
+        //Only stays suspended if the source has kept the request for later
+        bool await_suspend(std::coroutine_handle<> handle) {
+            pending.waiter = handle;
+            return !request.source->choose(*request.position, pending);
+        }
+        CompactMove await_resume() const noexcept {
+            return pending.move;
+        }
+    };
+
+    virtual ~MoveSource() { }
+
+    //Asks for a move in the position, which must stay as it is until the move is given
+    Request move(const Position& pos) {
+        return Request{this, &pos};
+    }
+
+    //Chooses a move in the position. Returns true having set the move, with setMove, or false having kept the
+    //request to complete once a move arrives
+    virtual bool choose(const Position& pos, Pending& pending) = 0;
+
+protected:
+    static void setMove(Pending& pending, CompactMove m) {
+        pending.move = m;
+    }
+
+    //The legal moves a game file can hold: every one but knight, bishop and rook promotions, which
+    //Position::toStoredMove would store as queen promotions
+    static void storableMoves(const Position& pos, MoveList& list);
+
+    //Reads a move given as SAN or as coordinates, such as e2e4 or e7e8q. Returns a null move if it is not legal
+    static CompactMove parseMove(const Position& pos, const std::string& text);
+};
+
+//Plays a random legal move, promoting only to a queen so the game can be saved. May be shared by any number of games
+class RandomMoveSource : public MoveSource {
+public:
+    bool choose(const Position& pos, Pending& pending) override;
+};
+
+//Plays the engine's move, searched within the limits on one thread and promoting only to a queen as
+//GameManager::computerTurn does. Each thread keeps an engine of its own to search with, so one source
+//may be shared by any number of games
+class EngineMoveSource : public MoveSource {
+private:
+    SearchLimits limits;
+
+public:
+    EngineMoveSource(SearchLimits limits);
+    bool choose(const Position& pos, Pending& pending) override;
+};
+
+//Plays the moves of a saved game in order, resigning once they run out. One source replays one game
+class ReplayMoveSource : public MoveSource {
+private:
+    std::vector<Move> moves;
+    size_t next = 0;
+
+public:
+    ReplayMoveSource(const std::vector<Move>& moves) : moves(moves) { }
+    bool choose(const Position& pos, Pending& pending) override;
+};
+
+//Reads a move a line from a stream, as SAN or coordinates, resigning at the end of the stream. With a prompt
+//stream it is a player at the console, and is asked again after anything which is not a legal move
+class StreamMoveSource : public MoveSource {
+private:
+    std::istream& input;
+    std::ostream* prompt;
+
+public:
+    StreamMoveSource(std::istream& input, std::ostream* prompt = nullptr) : input(input), prompt(prompt) { }
+    bool choose(const Position& pos, Pending& pending) override;
+};
+
+//Plays moves handed to it from elsewhere, such as read from a socket by another thread. A game asking for a
+//move before one has arrived waits until it does
+class QueuedMoveSource : public MoveSource {
+private:
+    std::mutex lock;
+    std::deque<std::string> queued;
+    Pending* waiting = nullptr;
+    const Position* waitingPosition = nullptr;
+    bool closed = false;
+
+public:
+    bool choose(const Position& pos, Pending& pending) override;
+
+    //Hands over a move as text, to be read in the position it is played in. Safe to call from any thread
+    void push(const std::string& move);
+
+    //Resigns, now or at the next move, as when the player disconnects
+    void close();
+};
+
+#endif
@@ -0,0 +1,189 @@
+#include "OpeningExplorer.h"
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <thread>
+#include <unordered_map>
+
+static const char explorerMagic[8] = {'C', 'H', 'E', 'S', 'S', 'O', 'E', '1'};
+static const uint32_t explorerVersion = 1;
+//Games are handed to the build threads this many at a time
+static const int gameBlock = 64;
+//The bits of the key kept beside the move
+static const uint64_t keyBits = ~(uint64_t)0xFFFF;
+
+/*
+ Replays the openings of the database on several threads, each counting into its own map, then sorts
+ the counts of every thread together into the file. The file is written to a temporary name and renamed over the old one.
+ storage - the games to count
+ fileName - the explorer file
+ maxPly - the number of plies of each game to count
+ threads - the threads to replay with, or 0 for every core
+ */
+bool OpeningExplorer::build(const GameStorage& storage, std::string fileName, int maxPly, int threads) {
+    if (threads <= 0)
+        threads = std::max(1, (int)std::thread::hardware_concurrency());
+
+    struct Counts {
+        uint32_t games = 0;
+        uint32_t whiteWins = 0;
+        uint32_t draws = 0;
+        uint32_t blackWins = 0;
+    };
+    //Every game passes through the same few opening positions, so a map shared between threads would have
+    //them all waiting on the lock around those; each thread counts on its own instead
+    std::vector<std::unordered_map<uint64_t, Counts>> counts(threads);
+    std::atomic<int> nextGame(0);
+
+    auto worker = [&](int t) {
+        std::unordered_map<uint64_t, Counts>& mine = counts[t];
+        std::vector<Move> moves;
+        int first;
+        while ((first = nextGame.fetch_add(gameBlock)) < storage.size()) {
+            int last = std::min(first + gameBlock, storage.size());
+            for (int id = first; id < last; id++) {
+                if (!storage.loadGame(id, moves))
+                    continue;
+                GameResult result = storage.info(id).result;
+                Position pos;
+                pos.reset();
+                for (int ply = 0; ply < maxPly && ply < (int)moves.size(); ply++) {
+                    CompactMove m = pos.fromStoredMove(moves[ply]);
+                    if (m.isNull())
+                        break;
+                    Counts& c = mine[(pos.key() & keyBits) | m.data];
+                    c.games++;
+                    c.whiteWins += (result == WhiteWins);
+                    c.draws += (result == DrawnGame);
+                    c.blackWins += (result == BlackWins);
+                    UndoInfo undo;
+                    pos.makeMove(m, undo);
+                }
+            }
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (int t = 0; t < threads; t++)
+        pool.push_back(std::thread(worker, t));
+    for (auto it = pool.begin(); it != pool.end(); it++)
+        it->join();
+
+    std::vector<Entry> all;
+    for (auto map = counts.begin(); map != counts.end(); map++) {
+        for (auto it = map->begin(); it != map->end(); it++)
+            all.push_back(Entry{it->first, it->second.games, it->second.whiteWins, it->second.draws, it->second.blackWins});
+        map->clear();
+    }
+    std::sort(all.begin(), all.end(), [](const Entry& a, const Entry& b) { return a.keyMove < b.keyMove; });
+
+    //A pair counted by several threads is now in a run of entries, which are added into the first
+    size_t kept = 0;
+    for (size_t i = 0; i < all.size(); i++) {
+        if (kept > 0 && all[kept - 1].keyMove == all[i].keyMove) {
+            Entry& e = all[kept - 1];
+            e.games += all[i].games;
+            e.whiteWins += all[i].whiteWins;
+            e.draws += all[i].draws;
+            e.blackWins += all[i].blackWins;
+        } else {
+            all[kept++] = all[i];
+        }
+    }
+    all.resize(kept);
+
+    Header header = {};
+    memcpy(header.magic, explorerMagic, sizeof(explorerMagic));
+    header.version = explorerVersion;
+    header.entrySize = sizeof(Entry);
+    header.count = all.size();
+    header.maxPly = (uint32_t)maxPly;
+    header.games = (uint64_t)storage.size();
+    char headerBytes[HeaderBytes] = {};
+    memcpy(headerBytes, &header, sizeof(header));
+
+    std::string temporary = fileName + ".new";
+    std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+    out.write(headerBytes, sizeof(headerBytes));
+    out.write(reinterpret_cast<const char*>(all.data()), all.size() * sizeof(Entry));
+    out.close();
+    if (out.fail() || rename(temporary.c_str(), fileName.c_str()) != 0) {
+        remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool OpeningExplorer::open(std::string fileName) {
+    close();
+
+    Header header;
+    bool valid = file.open(fileName) && file.size() >= HeaderBytes && file.read(&header, sizeof(header), 0) &&
+                 memcmp(header.magic, explorerMagic, sizeof(explorerMagic)) == 0 &&
+                 header.version == explorerVersion && header.entrySize == sizeof(Entry) &&
+                 (uint64_t)file.size() == HeaderBytes + header.count * sizeof(Entry);
+    if (!valid || !file.map(false)) {
+        close();
+        return false;
+    }
+
+    entries = reinterpret_cast<const Entry*>(file.data() + HeaderBytes);
+    count = header.count;
+    games = header.games;
+    maxPly = (int)header.maxPly;
+    return true;
+}
+
+void OpeningExplorer::close() {
+    file.close();
+    entries = nullptr;
+    count = 0;
+    games = 0;
+    maxPly = 0;
+}
+
+std::vector<ExplorerMove> OpeningExplorer::lookup(uint64_t key) const {
+    std::vector<ExplorerMove> moves;
+    uint64_t low = 0, high = count;
+    uint64_t first = key & keyBits;
+    while (low < high) {
+        uint64_t middle = low + (high - low) / 2;
+        if (entries[middle].keyMove < first)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    for (uint64_t i = low; i < count && (entries[i].keyMove & keyBits) == first; i++) {
+        ExplorerMove m;
+        m.move.data = (uint16_t)(entries[i].keyMove & 0xFFFF);
+        m.games = entries[i].games;
+        m.whiteWins = entries[i].whiteWins;
+        m.draws = entries[i].draws;
+        m.blackWins = entries[i].blackWins;
+        moves.push_back(m);
+    }
+    std::stable_sort(moves.begin(), moves.end(), [](const ExplorerMove& a, const ExplorerMove& b) { return a.games > b.games; });
+    return moves;
+}
+
+//The explorer behind defaultExplorer, which is tried again each time until the file exists
+static OpeningExplorer& sharedExplorer() {
+    static OpeningExplorer explorer;
+    return explorer;
+}
+
+const OpeningExplorer* OpeningExplorer::defaultExplorer() {
+    OpeningExplorer& explorer = sharedExplorer();
+    if (!explorer.isOpen())
+        explorer.open("openings.explorer");
+    return explorer.isOpen() ? &explorer : nullptr;
+}
+
+bool OpeningExplorer::rebuildDefault(const GameStorage& storage, int maxPly) {
+    if (!build(storage, "openings.explorer", maxPly))
+        return false;
+    return sharedExplorer().open("openings.explorer");
+}
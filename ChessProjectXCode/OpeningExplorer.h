@@ -0,0 +1,95 @@
+#ifndef OpeningExplorer_H
+#define OpeningExplorer_H
+
+#include "GameStorage.h"
+#include "Position.h"
+#include "MappedFile.h"
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+//How often a move was played from a position in the saved games, and how those games ended
+struct ExplorerMove {
+    CompactMove move;
+    uint32_t games = 0;
+    uint32_t whiteWins = 0;
+    uint32_t draws = 0;
+    uint32_t blackWins = 0;
+};
+
+/*
+ The moves played from each position in the opening of the saved games, with their results, like an
+ opening explorer.
+ Building replays the first plies of every game across threads, each counting the (position, move) pairs
+ it sees in a hash map of its own, so no thread waits on another. The counts are then sorted, the
+ threads' counts of the same pair added together, and written to a file of fixed size entries, each the
+ top 48 bits of the position key with the move in the low 16 bits, followed by the counts. The file is
+ memory mapped, and a position's moves are found with one binary search, so looking one up costs
+ microseconds.
+ */
+class OpeningExplorer {
+private:
+    struct Entry {
+        uint64_t keyMove;       //The position key with its low 16 bits replaced by the move
+        uint32_t games;
+        uint32_t whiteWins;
+        uint32_t draws;
+        uint32_t blackWins;
+    };
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t entrySize;
+        uint64_t count;
+        uint32_t maxPly;
+        uint32_t unused;
+        uint64_t games;         //Games in the database when the explorer was built
+    };
+
+    MappedFile file;
+    const Entry* entries = nullptr;
+    uint64_t count = 0;
+    uint64_t games = 0;
+    int maxPly = 0;
+
+public:
+
+    //Bytes before the first entry
+    static const size_t HeaderBytes = 64;
+
+    OpeningExplorer() { }
+    ~OpeningExplorer() {
+        close();
+    }
+
+    //Counts the moves of the first maxPly plies of every game in the database, and writes them to the file.
+    //threads - 0 uses every core
+    static bool build(const GameStorage& storage, std::string fileName, int maxPly = 20, int threads = 0);
+
+    //Maps an explorer file, returning false if it is missing or not an explorer
+    bool open(std::string fileName);
+    void close();
+
+    bool isOpen() const {
+        return file.isMapped();
+    }
+
+    //The moves played from the position, most played first
+    std::vector<ExplorerMove> lookup(uint64_t key) const;
+
+    //The number of plies of each game counted
+    int depth() const {
+        return maxPly;
+    }
+    //The number of games counted, to tell whether the database has grown since
+    uint64_t gameCount() const {
+        return games;
+    }
+
+    //The explorer shown while analysing games, read from openings.explorer. Returns nullptr if there is none
+    static const OpeningExplorer* defaultExplorer();
+    //Builds openings.explorer again from the database, and switches the default explorer over to it
+    static bool rebuildDefault(const GameStorage& storage, int maxPly);
+};
+
+#endif
@@ -0,0 +1,216 @@
+#include "PgnExporter.h"
+#include "RAFile.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <thread>
+
+//Games are handed to the worker threads this many at a time
+static const int gameBlock = 64;
+//Movetext lines are kept to this many columns
+static const size_t lineColumns = 80;
+
+PgnExporter::PgnExporter(int threads) {
+    threadCount = (threads > 0) ? threads : (int)std::thread::hardware_concurrency();
+    if (threadCount < 1)
+        threadCount = 1;
+}
+
+const char* PgnExporter::resultText(GameResult result) {
+    switch (result) {
+        case WhiteWins: return "1-0";
+        case BlackWins: return "0-1";
+        case DrawnGame: return "1/2-1/2";
+        default: return "*";
+    }
+}
+
+/*
+ Replays the game on the given position, writing a move number before each of white's moves.
+ pos - the position to replay on, which is reset first and left at the end of the game
+ moves - the game
+ result - the game's result, written after the last move
+ out - the text is added to the end
+ bookPlies - the number of plies played from an opening book
+ */
+bool PgnExporter::writeMoves(Position& pos, const std::vector<Move>& moves, GameResult result, std::string& out, int bookPlies) {
+    pos.reset();
+    size_t lineStart = out.size();
+    bool fits = true;
+    std::string token;
+    for (size_t ply = 0; ply <= moves.size(); ply++) {
+        CompactMove m;
+        if (ply < moves.size()) {
+            m = pos.fromStoredMove(moves[ply]);
+            if (m.isNull())
+                fits = false;
+        }
+        if (ply == moves.size() || !fits) {
+            token = fits ? resultText(result) : "*";
+        } else {
+            token.clear();
+            if (ply % 2 == 0)
+                token = std::to_string(ply / 2 + 1) + ". ";
+            token += pos.toSan(m);
+            if (ply + 1 == (size_t)bookPlies && ply + 1 < moves.size())
+                token += " {end of book}";
+        }
+
+        if (out.size() > lineStart && out.size() - lineStart + 1 + token.size() > lineColumns) {
+            out += '\n';
+            lineStart = out.size();
+        } else if (out.size() > lineStart) {
+            out += ' ';
+        }
+        out += token;
+        if (ply == moves.size() || !fits)
+            break;
+        UndoInfo undo;
+        pos.makeMove(m, undo);
+    }
+    out += '\n';
+    return fits;
+}
+
+bool PgnExporter::writeGame(Position& pos, const std::string& name, const std::vector<Move>& moves, GameResult result, std::string& out) {
+    std::string movetext;
+    bool fits = writeMoves(pos, moves, result, movetext);
+
+    std::string event;
+    for (auto it = name.begin(); it != name.end(); it++) {
+        if (*it == '"' || *it == '\\')
+            event += '\\';
+        event += *it;
+    }
+    out += "[Event \"" + event + "\"]\n";
+    out += "[Site \"?\"]\n[Date \"????.??.??\"]\n[Round \"?\"]\n[White \"?\"]\n[Black \"?\"]\n";
+    out += std::string("[Result \"") + (fits ? resultText(result) : "*") + "\"]\n\n";
+    out += movetext;
+    out += '\n';
+    return fits;
+}
+
+PgnExportStats PgnExporter::exportGames(const GameStorage& storage, std::string fileName) {
+    return run(storage.size(), [&](int id, std::string& name, std::vector<Move>& moves, GameResult& result) {
+        if (!storage.loadGame(id, moves))
+            return false;
+        GameInfo info = storage.info(id);
+        name = info.name;
+        result = info.result;
+        return true;
+    }, fileName);
+}
+
+PgnExportStats PgnExporter::exportFiles(const std::vector<std::string>& files, std::string fileName) {
+    return run((int)files.size(), [&](int i, std::string& name, std::vector<Move>& moves, GameResult& result) {
+        if (!RAFile<Move>::readAll(files[i], moves))
+            return false;
+        size_t slash = files[i].find_last_of('/');
+        name = (slash == std::string::npos) ? files[i] : files[i].substr(slash + 1);
+        result = GameStorage::resultOf(moves);
+        return true;
+    }, fileName);
+}
+
+/*
+ Workers claim the next block of games and write their text, and the calling thread writes the blocks
+ to the file strictly in order as they are finished.
+ games - the number of games
+ load - reads a game by its number
+ fileName - the PGN file, which is replaced
+ */
+PgnExportStats PgnExporter::run(int games, const std::function<bool(int, std::string&, std::vector<Move>&, GameResult&)>& load, std::string fileName) {
+    PgnExportStats stats;
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<char> outputBuffer(OutputBufferBytes);
+    std::ofstream out;
+    out.rdbuf()->pubsetbuf(outputBuffer.data(), outputBuffer.size());
+    out.open(fileName, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        stats.failed = (uint64_t)games;
+        return stats;
+    }
+
+    struct Block {
+        std::string text;
+        uint64_t games = 0;
+        uint64_t failed = 0;
+        uint64_t plies = 0;
+    };
+    std::mutex lock;
+    std::condition_variable changed;
+    std::map<int, Block> finished;
+    int nextBlock = 0;              //The first game of the next block claimed
+    int nextWritten = 0;            //The first game of the block the calling thread is waiting for
+    int inFlight = threadCount * 4 * gameBlock;
+
+    auto worker = [&]() {
+        Position pos;
+        std::string name;
+        std::vector<Move> moves;
+        while (true) {
+            int first;
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                changed.wait(guard, [&]() { return nextBlock >= games || nextBlock < nextWritten + inFlight; });
+                if (nextBlock >= games)
+                    return;
+                first = nextBlock;
+                nextBlock += gameBlock;
+            }
+
+            Block block;
+            int last = std::min(first + gameBlock, games);
+            for (int i = first; i < last; i++) {
+                GameResult result = ResultUnknown;
+                if (!load(i, name, moves, result)) {
+                    block.failed++;
+                    continue;
+                }
+                if (writeGame(pos, name, moves, result, block.text)) {
+                    block.games++;
+                    block.plies += moves.size();
+                } else {
+                    block.failed++;
+                }
+            }
+
+            std::lock_guard<std::mutex> guard(lock);
+            finished[first] = std::move(block);
+            changed.notify_all();
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (int t = 0; t < threadCount; t++)
+        pool.push_back(std::thread(worker));
+
+    while (nextWritten < games) {
+        Block block;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            changed.wait(guard, [&]() { return finished.count(nextWritten) > 0; });
+            block = std::move(finished[nextWritten]);
+            finished.erase(nextWritten);
+            nextWritten += gameBlock;
+            changed.notify_all();
+        }
+        out.write(block.text.data(), block.text.size());
+        stats.games += block.games;
+        stats.failed += block.failed;
+        stats.plies += block.plies;
+        stats.bytes += block.text.size();
+    }
+    for (auto it = pool.begin(); it != pool.end(); it++)
+        it->join();
+
+    out.close();
+    if (out.fail())
+        stats.bytes = 0;
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return stats;
+}
@@ -0,0 +1,60 @@
+#ifndef PgnExporter_H
+#define PgnExporter_H
+
+#include "GameStorage.h"
+#include "Move.h"
+#include "Position.h"
+#include <functional>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+//Totals for one export
+struct PgnExportStats {
+    uint64_t games = 0;
+    uint64_t failed = 0;            //Games which could not be read, or stopped at a move which did not fit
+    uint64_t plies = 0;
+    uint64_t bytes = 0;             //0 if the file could not be written
+    double seconds = 0;
+};
+
+/*
+ Writes saved games out as PGN, either every game in a database or every saved game file in a list.
+ Worker threads take games 64 at a time and write the SAN of each with their own Position, making and
+ taking back moves in place, and the text of each block is written to the file in order through a large
+ output buffer, with only a few blocks per thread waiting at once.
+ */
+class PgnExporter {
+private:
+    int threadCount;
+
+    //Writes the games, each read by load, which returns false if game number i can not be read
+    PgnExportStats run(int games, const std::function<bool(int, std::string&, std::vector<Move>&, GameResult&)>& load, std::string fileName);
+
+public:
+
+    //Bytes gathered before the output file is written to
+    static const size_t OutputBufferBytes = 1 << 20;
+
+    //threads - 0 uses every core
+    PgnExporter(int threads = 0);
+
+    //Writes every game of the database to one PGN file, in the order of their ids
+    PgnExportStats exportGames(const GameStorage& storage, std::string fileName);
+
+    //Writes every saved game file in the list to one PGN file, named by their file names
+    PgnExportStats exportFiles(const std::vector<std::string>& files, std::string fileName);
+
+    //Writes the numbered moves of a game from the starting position, then the result, wrapping lines at 80
+    //columns. Returns false if a move does not fit the position, in which case the moves before it are written.
+    //bookPlies - if above 0, the comment {end of book} follows that many plies, unless the whole game was in the book
+    static bool writeMoves(Position& pos, const std::vector<Move>& moves, GameResult result, std::string& out, int bookPlies = 0);
+
+    //Writes a game with the seven tags PGN requires, the name being the event
+    static bool writeGame(Position& pos, const std::string& name, const std::vector<Move>& moves, GameResult result, std::string& out);
+
+    //The result as PGN writes it, "*" when it is not known
+    static const char* resultText(GameResult result);
+};
+
+#endif
@@ -0,0 +1,326 @@
+#include "PgnImporter.h"
+#include "Position.h"
+#include "GameCodec.h"
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
+
+//Chunks end just before a line starting with this, which begins nearly every game in a PGN file
+static const char gameStart[] = "\n[Event ";
+
+void PgnImportStats::report(std::ostream& out) const {
+    double mb = bytes / (1024.0 * 1024.0);
+    out << "Imported " << games << " games (" << failed << " failed, " << plies << " plies, " << mb << " MB) in " << seconds << " seconds" << std::endl;
+    out << "  split: " << splitBytes / (1024.0 * 1024.0) << " MB searched, "
+        << (splitSeconds > 0 ? splitBytes / (1024.0 * 1024.0) / splitSeconds : 0) << " MB/sec" << std::endl;
+    out << "  parse: " << (parseSeconds > 0 ? (games + failed) / parseSeconds : 0) << " games/sec per thread, "
+        << (parseSeconds > 0 ? plies / parseSeconds : 0) << " plies/sec per thread" << std::endl;
+    out << "  store: " << (storeSeconds > 0 ? games / storeSeconds : 0) << " games/sec" << std::endl;
+    out << "  total: " << (seconds > 0 ? (games + failed) / seconds : 0) << " games/sec, " << (seconds > 0 ? mb / seconds : 0) << " MB/sec" << std::endl;
+}
+
+PgnImporter::PgnImporter(int threads, size_t chunkBytes) : chunkBytes(std::max<size_t>(chunkBytes, 4096)) {
+    threadCount = (threads > 0) ? threads : (int)std::thread::hardware_concurrency();
+    if (threadCount < 1)
+        threadCount = 1;
+}
+
+//The game being read, and what is needed to finish it
+struct GameInProgress {
+    PgnGame game;
+    Position pos;
+    std::string event, white, black, date;
+    bool started = false;           //Whether any tag or move has been seen
+    bool inMoves = false;           //Whether the moves have begun, so a tag starts the next game
+
+    void reset() {
+        game = PgnGame();
+        pos.reset();
+        event.clear();
+        white.clear();
+        black.clear();
+        date.clear();
+        started = false;
+        inMoves = false;
+    }
+
+    void finish(std::vector<PgnGame>& games) {
+        if (!started)
+            return;
+        if (!white.empty() || !black.empty()) {
+            game.name = (white.empty() ? "?" : white) + " - " + (black.empty() ? "?" : black);
+            if (!date.empty())
+                game.name += ", " + date;
+        } else {
+            game.name = event;
+        }
+        games.push_back(std::move(game));
+        reset();
+    }
+
+    void tag(const std::string& name, const std::string& value) {
+        started = true;
+        //Unknown values are written as question marks, and are left out of the name
+        bool known = !value.empty() && value.find_first_not_of("?.") != std::string::npos;
+        if (!known && name != "Result")
+            return;
+        if (name == "Event")
+            event = value;
+        else if (name == "White")
+            white = value;
+        else if (name == "Black")
+            black = value;
+        else if (name == "Date")
+            date = value;
+        else if (name == "Result")
+            game.result = (value == "1-0") ? WhiteWins : (value == "0-1") ? BlackWins : (value == "1/2-1/2") ? DrawnGame : ResultUnknown;
+        else if (name == "FEN")
+            game.valid = false;     //Only games from the starting position can be stored
+    }
+
+    void move(const std::string& san) {
+        started = true;
+        inMoves = true;
+        if (!game.valid)
+            return;
+        CompactMove m = pos.fromSan(san);
+        if (m.isNull() || (m.isPromotion() && m.promotionType() != QueenType)) {
+            game.valid = false;
+            return;
+        }
+        game.moves.push_back(pos.toStoredMove(m));
+        UndoInfo undo;
+        pos.makeMove(m, undo);
+    }
+};
+
+/*
+ Reads the tags and movetext of each game. Comments, variations, move numbers and numeric annotations are
+ skipped, and a game ends at its result or where the next game's tags begin.
+ begin, end - the text, holding whole games
+ games - the games are added to the end
+ */
+void PgnImporter::parseGames(const char* begin, const char* end, std::vector<PgnGame>& games) {
+    GameInProgress current;
+    current.reset();
+    const char* p = begin;
+    while (p < end) {
+        char c = *p;
+        if (isspace((unsigned char)c)) {
+            p++;
+        } else if (c == '[') {                              // A tag, as in [White "Name"]
+            if (current.inMoves)
+                current.finish(games);
+            const char* close = (const char*)memchr(p, '\n', end - p);
+            const char* lineEnd = close ? close : end;
+            const char* nameEnd = p + 1;
+            while (nameEnd < lineEnd && !isspace((unsigned char)*nameEnd) && *nameEnd != '"')
+                nameEnd++;
+            const char* quote = (const char*)memchr(nameEnd, '"', lineEnd - nameEnd);
+            const char* lastQuote = quote;
+            for (const char* q = lineEnd - 1; quote && q > quote; q--) {
+                if (*q == '"') {
+                    lastQuote = q;
+                    break;
+                }
+            }
+            std::string value;
+            for (const char* q = quote + 1; quote && q < lastQuote; q++) {
+                if (*q == '\\' && q + 1 < lastQuote)      // Escaped quotes and backslashes
+                    q++;
+                value += *q;
+            }
+            current.tag(std::string(p + 1, nameEnd), value);
+            p = lineEnd;
+        } else if (c == '{') {                              // A comment
+            const char* close = (const char*)memchr(p, '}', end - p);
+            p = close ? close + 1 : end;
+        } else if (c == ';' || c == '%') {                  // A comment or escape to the end of the line
+            const char* close = (const char*)memchr(p, '\n', end - p);
+            p = close ? close + 1 : end;
+        } else if (c == '(') {                              // A variation, which may hold others and comments
+            int depth = 0;
+            for (; p < end; p++) {
+                if (*p == '{') {
+                    const char* close = (const char*)memchr(p, '}', end - p);
+                    p = close ? close : end - 1;
+                } else if (*p == '(') {
+                    depth++;
+                } else if (*p == ')' && --depth == 0) {
+                    p++;
+                    break;
+                }
+            }
+        } else {
+            const char* tokenEnd = p;
+            while (tokenEnd < end && !isspace((unsigned char)*tokenEnd) && strchr("{}()[];", *tokenEnd) == nullptr)
+                tokenEnd++;
+            if (tokenEnd == p) {                            // A stray closing bracket
+                p++;
+                continue;
+            }
+            std::string token(p, tokenEnd);
+            p = tokenEnd;
+
+            if (token == "1-0" || token == "0-1" || token == "1/2-1/2" || token == "*") {
+                if (current.game.result == ResultUnknown && token != "*")
+                    current.game.result = (token == "1-0") ? WhiteWins : (token == "0-1") ? BlackWins : DrawnGame;
+                current.started = true;
+                current.finish(games);
+                continue;
+            }
+            if (token[0] == '$')                            // A numeric annotation
+                continue;
+
+            //Move numbers, which may run straight into the move as in 1.e4
+            size_t skip = 0;
+            while (skip < token.size() && isdigit((unsigned char)token[skip]))
+                skip++;
+            if (skip > 0 && skip < token.size() && token[skip] == '.') {
+                while (skip < token.size() && token[skip] == '.')
+                    skip++;
+                token.erase(0, skip);
+            } else if (skip == token.size()) {
+                continue;
+            }
+            if (!token.empty())
+                current.move(token);
+        }
+    }
+    current.finish(games);
+}
+
+/*
+ Runs the pipeline: workers claim the next chunk, which is where the file is cut, read its games, and
+ leave them for the calling thread, which stores chunks strictly in order.
+ fileName - the PGN file
+ storage - the database the games are added to
+ */
+PgnImportStats PgnImporter::run(const std::string& fileName, GameStorage& storage) {
+    PgnImportStats stats;
+    auto start = std::chrono::steady_clock::now();
+
+    MappedFile file;
+    if (!file.open(fileName) || !file.map(false))
+        return stats;
+    file.adviseSequential();
+    size_t size = file.size();
+    const char* text = file.data();
+    stats.bytes = size;
+
+    struct Chunk {
+        std::vector<PgnGame> games;
+        double parseSeconds = 0;
+    };
+    std::mutex lock;
+    std::condition_variable changed;
+    std::map<size_t, Chunk> finished;
+    size_t cursor = 0;              //Where the next chunk starts
+    size_t nextChunk = 0;           //The number the next chunk claimed gets
+    size_t nextStored = 0;          //The chunk the calling thread is waiting for
+    bool allClaimed = false;
+    size_t inFlight = (size_t)threadCount * 4;
+    double splitSeconds = 0;
+    uint64_t splitBytes = 0;
+    GameEncoding encoding = storage.getEncoding();
+
+    auto worker = [&]() {
+        while (true) {
+            size_t number, begin, end;
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                changed.wait(guard, [&]() { return allClaimed || nextChunk < nextStored + inFlight; });
+                if (allClaimed)
+                    return;
+
+                //Cuts the next chunk at the first game to start after chunkBytes
+                auto splitStart = std::chrono::steady_clock::now();
+                begin = cursor;
+                end = size;
+                if (size - begin > chunkBytes) {
+                    const char* from = text + begin + chunkBytes;
+                    const char* found = (const char*)memmem(from, text + size - from, gameStart, sizeof(gameStart) - 1);
+                    if (found != nullptr)
+                        end = (size_t)(found - text) + 1;
+                    splitBytes += (uint64_t)((found != nullptr ? found : text + size) - from);
+                }
+                cursor = end;
+                number = nextChunk++;
+                allClaimed = (cursor == size);
+                splitSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - splitStart).count();
+            }
+
+            Chunk chunk;
+            auto parseStart = std::chrono::steady_clock::now();
+            parseGames(text + begin, text + end, chunk.games);
+            for (auto it = chunk.games.begin(); it != chunk.games.end(); it++) {
+                if (!it->valid)
+                    continue;
+                it->encoding = encoding;
+                if (!GameCodec::encode(it->moves, it->encoding, it->payload)) {
+                    it->encoding = RawMoves;
+                    GameCodec::encode(it->moves, it->encoding, it->payload);
+                }
+            }
+            chunk.parseSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - parseStart).count();
+
+            std::lock_guard<std::mutex> guard(lock);
+            finished[number] = std::move(chunk);
+            changed.notify_all();
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (int t = 0; t < threadCount; t++)
+        pool.push_back(std::thread(worker));
+
+    //Stores the chunks in file order as they arrive
+    size_t gameNumber = 0;
+    while (true) {
+        Chunk chunk;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            changed.wait(guard, [&]() { return finished.count(nextStored) > 0 || (allClaimed && nextStored == nextChunk); });
+            if (finished.count(nextStored) == 0)
+                break;
+            chunk = std::move(finished[nextStored]);
+            finished.erase(nextStored);
+            nextStored++;
+            changed.notify_all();
+        }
+
+        auto storeStart = std::chrono::steady_clock::now();
+        stats.parseSeconds += chunk.parseSeconds;
+        for (auto it = chunk.games.begin(); it != chunk.games.end(); it++) {
+            gameNumber++;
+            if (!it->valid) {
+                stats.failed++;
+                continue;
+            }
+            std::string name = it->name.empty() ? fileName + " #" + std::to_string(gameNumber) : it->name;
+            if (storage.addEncodedGame(name, it->payload, (int)it->moves.size(), it->encoding, it->result) < 0) {
+                stats.failed++;
+                continue;
+            }
+            stats.games++;
+            stats.plies += it->moves.size();
+        }
+        stats.storeSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - storeStart).count();
+    }
+    for (auto it = pool.begin(); it != pool.end(); it++)
+        it->join();
+
+    auto storeStart = std::chrono::steady_clock::now();
+    storage.commit(true);
+    stats.storeSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - storeStart).count();
+
+    file.close();
+    stats.splitBytes = splitBytes;
+    stats.splitSeconds = splitSeconds;
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return stats;
+}
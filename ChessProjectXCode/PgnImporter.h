@@ -0,0 +1,66 @@
+#ifndef PgnImporter_H
+#define PgnImporter_H
+
+#include "GameStorage.h"
+#include "MappedFile.h"
+#include "Move.h"
+#include <ostream>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+//A game read from a PGN file
+struct PgnGame {
+    std::string name;               //"White - Black, Date" from the tags, the event if the players are unknown, or empty
+    std::vector<Move> moves;
+    std::vector<uint8_t> payload;   //The moves as the database stores them, once encoded
+    GameEncoding encoding = RawMoves;
+    GameResult result = ResultUnknown;
+    bool valid = true;              //False if a move could not be read, or the game can not be stored
+};
+
+//Totals for one import, with the time each stage of the pipeline spent working
+struct PgnImportStats {
+    uint64_t bytes = 0;
+    uint64_t games = 0;             //Games stored
+    uint64_t failed = 0;            //Games which could not be read
+    uint64_t plies = 0;
+    uint64_t splitBytes = 0;        //Bytes searched for game boundaries
+    double splitSeconds = 0;        //Finding game boundaries
+    double parseSeconds = 0;        //Reading and encoding moves, summed over the worker threads
+    double storeSeconds = 0;        //Adding games to the database
+    double seconds = 0;             //From start to finish
+
+    //Writes the rate of every stage and of the whole import
+    void report(std::ostream& out) const;
+};
+
+/*
+ Imports PGN files of any size into a game database.
+ The file is memory mapped and cut into chunks of about chunkBytes, each ending where a game ends, as
+ worker threads ask for them. The workers read the SAN of each game against the legal moves of their
+ own Position and compress it as the database would, and the finished chunks are handed to the calling thread, which stores them in the
+ order they appear in the file. No more than a few chunks per thread are held at once, so memory stays
+ bounded however large the file is.
+ Games set up from a FEN, and games with underpromotions, which a stored Move can not describe, are
+ counted as failed.
+ */
+class PgnImporter {
+private:
+    int threadCount;
+    size_t chunkBytes;
+
+public:
+
+    //threads - 0 uses every core
+    //chunkBytes - how much of the file each worker takes at a time
+    PgnImporter(int threads = 0, size_t chunkBytes = 1 << 20);
+
+    //Adds every game of the file to the database and commits it
+    PgnImportStats run(const std::string& fileName, GameStorage& storage);
+
+    //Reads the games in a piece of PGN text holding whole games
+    static void parseGames(const char* begin, const char* end, std::vector<PgnGame>& games);
+};
+
+#endif
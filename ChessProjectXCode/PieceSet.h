@@ -86,10 +86,71 @@ public:
     }
     
     void reset() {
+        removeExtraPieces();
         *this = PieceSet(isWhite());
+    }
+    
+    //Deletes the pieces made by promotions
+    void removeExtraPieces() {
+        for (auto it = extraPieces.begin(); it != extraPieces.end(); it++)
+            delete *it;
         extraPieces.clear();
     }
     
+    //Takes every piece off the board, leaving them ready to be placed again by placePiece
+    void deactivateAll() {
+        removeExtraPieces();
+        forEveryActivePiece([] (Piece* p) {
+            p->deactivate();
+            p->setLocation(Location(-1, -1));
+        });
+    }
+    
+    //Puts an unused piece of the given kind on the location, making a new one if they have all been used.
+    //Returns nullptr if there is no piece to place
+    Piece* placePiece(char iden, Location l) {
+        Piece* candidates[8];
+        int count = 0;
+        switch (iden) {
+            case 'P':
+                for (int i = 0; i < 8; i++)
+                    candidates[count++] = &pawns[i];
+                break;
+            case 'R':
+                candidates[count++] = &r1;
+                candidates[count++] = &r2;
+                break;
+            case 'N':
+                candidates[count++] = &n1;
+                candidates[count++] = &n2;
+                break;
+            case 'B':
+                candidates[count++] = &b1;
+                candidates[count++] = &b2;
+                break;
+            case 'Q':
+                candidates[count++] = &q;
+                break;
+            case 'K':
+                candidates[count++] = &k;
+                break;
+        }
+        for (int i = 0; i < count; i++) {
+            if (!candidates[i]->isActive()) {
+                candidates[i]->setLocation(l);
+                candidates[i]->activate();
+                return candidates[i];
+            }
+        }
+        
+        //Only promotions give extra pieces
+        if (iden == 'Q')
+            return addQueen(l, isWhite());
+        if (iden == 'N')
+            return addKnight(l, isWhite());
+        return nullptr;
+    }
+    
     void forEveryActivePiece(const std::function<void(Piece*)> func) {
         for (int i = 0; i < 8; i++)
             if (pawns[i].isActive())
@@ -0,0 +1,112 @@
+#include "PlyAnalyzer.h"
+#include <algorithm>
+
+PlyAnalyzer::PlyAnalyzer(const std::vector<Move>& moves, AnalysisCache* cache) : cursor(0), remaining(0), stopFlag(false), cache(cache) {
+    Position pos;
+    pos.reset();
+    positions.push_back(pos);
+    for (auto it = moves.begin(); it != moves.end(); it++) {
+        if (!pos.applyStoredMove(*it))
+            break;
+        positions.push_back(pos);
+    }
+
+    slots.reset(new Slot[positions.size()]);
+    for (size_t i = 0; i < positions.size(); i++) {
+        slots[i].claimed = false;
+        slots[i].ready = false;
+    }
+    remaining = (int)positions.size();
+
+    //Leaves a core for the interface
+    int threadCount = std::max(1, (int)std::thread::hardware_concurrency() - 1);
+    for (int t = 0; t < threadCount; t++)
+        workers.push_back(std::thread(&PlyAnalyzer::worker, this));
+}
+
+PlyAnalyzer::~PlyAnalyzer() {
+    stopFlag = true;
+    for (auto it = workers.begin(); it != workers.end(); it++)
+        it->join();
+}
+
+/*
+ Looks outwards from the cursor, alternating later and earlier plies, for one nobody has claimed.
+ Games are a few hundred plies at most, so the scan costs nothing next to the analysis.
+ */
+int PlyAnalyzer::claimNext() {
+    int n = (int)positions.size();
+    int c = std::max(0, std::min(cursor.load(), n - 1));
+    for (int d = 0; d < n; d++) {
+        int candidates[2] = {c + d, c - d - 1};
+        for (int i = 0; i < 2; i++) {
+            int ply = candidates[i];
+            if (ply < 0 || ply >= n || slots[ply].claimed.load(std::memory_order_relaxed))
+                continue;
+            if (!slots[ply].claimed.exchange(true))
+                return ply;
+        }
+    }
+    return -1;
+}
+
+void PlyAnalyzer::worker() {
+    Engine engine(8);
+    int ply;
+    while (!stopFlag && (ply = claimNext()) != -1) {
+        slots[ply].analysis = analyse(positions[ply], engine, cache);
+        slots[ply].ready.store(true, std::memory_order_release);
+        remaining--;
+    }
+}
+
+bool PlyAnalyzer::get(int ply, PlyAnalysis& analysis) const {
+    if (ply < 0 || ply >= (int)positions.size() || !slots[ply].ready.load(std::memory_order_acquire))
+        return false;
+    analysis = slots[ply].analysis;
+    return true;
+}
+
+/*
+ Scores the position with a shallow search and notes check, mate and any piece which could be taken for free.
+ A piece is hanging when the opponent attacks it and no piece of its own color defends it; kings are left out.
+ pos - the position to analyse
+ engine - the calling thread's search
+ cache - where searched results are looked up and kept, or nullptr
+ */
+PlyAnalysis PlyAnalyzer::analyse(Position pos, Engine& engine, AnalysisCache* cache) {
+    PlyAnalysis result;
+    result.inCheck = pos.inCheck();
+    if (!pos.hasLegalMove()) {
+        result.checkmate = result.inCheck;
+        result.stalemate = !result.inCheck;
+        result.score = result.checkmate ? (pos.isWhiteToMove() ? -MateScore : MateScore) : 0;
+    } else {
+        CachedAnalysis cached;
+        if (cache == nullptr || !cache->probe(pos.key(), cached) || cached.depth < SearchDepth) {
+            SearchLimits limits;
+            limits.depth = SearchDepth;
+            limits.threads = 1;
+            SearchResult searched = engine.search(pos, limits);
+            cached.score = searched.score;
+            cached.depth = searched.depth;
+            cached.best = searched.best;
+            cached.flags = result.inCheck ? CacheInCheck : 0;
+            if (cache != nullptr)
+                cache->store(pos.key(), cached);
+        }
+        result.score = pos.isWhiteToMove() ? cached.score : -cached.score;
+        result.depth = cached.depth;
+        result.best = cached.best;
+    }
+
+    for (int sq = 0; sq < 64; sq++) {
+        uint8_t p = pos.at(sq);
+        if (p == NoPiece || Position::typeOf(p) == KingType)
+            continue;
+        bool white = Position::isWhitePiece(p);
+        if (pos.isAttacked(sq, !white) && !pos.isAttacked(sq, white))
+            (white ? result.hangingWhite : result.hangingBlack) |= (uint64_t)1 << sq;
+    }
+    return result;
+}
@@ -0,0 +1,86 @@
+#ifndef PlyAnalyzer_H
+#define PlyAnalyzer_H
+
+#include "Position.h"
+#include "Move.h"
+#include "Engine.h"
+#include "AnalysisCache.h"
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+
+//What is known about the position after one ply of a game
+struct PlyAnalysis {
+    int score = 0;              //Evaluation in centipawns, positive when white is better
+    int depth = 0;              //Depth the score was searched to
+    CompactMove best;           //Best move found for the side to move
+    bool inCheck = false;       //Whether the side to move is in check
+    bool checkmate = false;
+    bool stalemate = false;
+    uint64_t hangingWhite = 0;  //Squares of pieces attacked by the opponent and not defended, one bit per square
+    uint64_t hangingBlack = 0;
+};
+
+/*
+ Analyses every ply of a game on background threads as soon as it is opened, starting from the ply the
+ user is looking at and working outwards. Each ply's result is written once by the thread which claimed
+ it and then published with a flag, so the interface can read finished results at any time without
+ waiting on a lock.
+ */
+class PlyAnalyzer {
+private:
+    struct Slot {
+        std::atomic<bool> claimed;
+        std::atomic<bool> ready;
+        PlyAnalysis analysis;
+    };
+
+    std::vector<Position> positions;        //The position after each ply, from 0 for the start
+    std::unique_ptr<Slot[]> slots;
+    std::atomic<int> cursor;
+    std::atomic<int> remaining;
+    std::atomic<bool> stopFlag;
+    std::vector<std::thread> workers;
+
+    AnalysisCache* cache;
+
+    //Claims the unanalysed ply closest to the cursor, returning -1 once every ply is claimed
+    int claimNext();
+    void worker();
+
+public:
+
+    //Depth each ply is searched to
+    static const int SearchDepth = 5;
+
+    //Replays the moves and starts the worker threads. Stops at the first move which can not be played.
+    //cache - if given, plies analysed before are read from it rather than searched again
+    PlyAnalyzer(const std::vector<Move>& moves, AnalysisCache* cache = nullptr);
+    //Stops the workers, waiting for each to finish the ply it is on
+    ~PlyAnalyzer();
+
+    //Moves the analysis to work around the given ply next
+    void setCursor(int ply) {
+        cursor = ply;
+    }
+
+    //Copies out the analysis of a ply, returning false if it is not finished yet
+    bool get(int ply, PlyAnalysis& analysis) const;
+
+    //The number of plies which can be analysed, counting the starting position
+    int size() const {
+        return (int)positions.size();
+    }
+
+    //Whether every ply has been analysed
+    bool finished() const {
+        return remaining == 0;
+    }
+
+    //Analyses one position with the given search, using the cache when it holds a deep enough result
+    static PlyAnalysis analyse(Position pos, Engine& engine, AnalysisCache* cache);
+};
+
+#endif
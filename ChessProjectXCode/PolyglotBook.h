@@ -0,0 +1,76 @@
+#ifndef PolyglotBook_H
+#define PolyglotBook_H
+
+#include "Position.h"
+#include "Move.h"
+#include "MappedFile.h"
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+//A move the book gives for a position, with how often it should be played relative to the others
+struct BookMove {
+    CompactMove move;
+    int weight;
+};
+
+/*
+ Reads opening books in the Polyglot .bin format: 16 byte big endian entries of a position key, a move,
+ a weight and learning data, sorted by key.
+ The book is memory mapped, so opening it reads nothing but its size, and a lookup is a binary search
+ touching only the pages it lands on.
+
+ Polyglot keys are a Zobrist hash over Polyglot's own 781 fixed random numbers, which are held in the
+ program so any book written by other tools can be read.
+ */
+class PolyglotBook {
+private:
+    MappedFile file;
+    const unsigned char* entries = nullptr;
+    uint64_t count = 0;
+
+    //The key of entry i
+    uint64_t keyAt(uint64_t i) const;
+
+public:
+
+    static const int EntryBytes = 16;
+    static const int RandomCount = 781;
+
+    PolyglotBook() { }
+    ~PolyglotBook() {
+        close();
+    }
+
+    //Maps a book, returning false if it is missing or malformed
+    bool open(std::string bookFile);
+    void close();
+
+    bool isOpen() const {
+        return file.isMapped();
+    }
+    uint64_t size() const {
+        return count;
+    }
+
+    //The Polyglot key of a position
+    static uint64_t key(const Position& pos);
+
+    //Checks the random numbers give the keys the Polyglot format documents for known positions
+    static bool checkKeys();
+
+    //The book moves for a position, the most played first
+    std::vector<BookMove> lookup(const Position& pos) const;
+
+    //Picks a book move at random in proportion to the weights, or returns a null move if the position is not in the book
+    //random - any number, such as from a generator, which decides the choice
+    CompactMove choose(const Position& pos, uint64_t random) const;
+
+    //The number of plies from the start of the game which were all book moves
+    int bookPlies(const std::vector<Move>& moves) const;
+
+    //The book in book.bin, or nullptr if there is none
+    static const PolyglotBook* defaultBook();
+};
+
+#endif
@@ -0,0 +1,940 @@
+#include "Position.h"
+#include "ChessBoard.h"
+#include <stdlib.h>
+#include <algorithm>
+#include <ctype.h>
+#include <string.h>
+
+//Zobrist keys, filled once by the static initializer below
+static uint64_t pieceKeys[16][64];
+static uint64_t castleKeys[16];
+static uint64_t epKeys[8];
+static uint64_t sideKey;
+
+//Precomputed target squares for knights and kings
+static uint8_t knightTargets[64][8];
+static uint8_t knightCount[64];
+static uint8_t kingTargets[64][8];
+static uint8_t kingCount[64];
+
+//Castling rights which survive a move touching the given square
+static uint8_t castleMask[64];
+
+static const int rookDirections[4][2] = { {1, 0}, {-1, 0}, {0, 1}, {0, -1} };
+static const int bishopDirections[4][2] = { {1, 1}, {1, -1}, {-1, 1}, {-1, -1} };
+
+/*
+ Fills the static tables above. Keys come from a fixed seed so hashes are the same on every run,
+ which matters for anything written to disk.
+ */
+static struct PositionTables {
+    static uint64_t next(uint64_t& state) {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+    PositionTables() {
+        uint64_t state = 0x43686573734B6579ULL;
+        for (int p = 0; p < 16; p++)
+            for (int sq = 0; sq < 64; sq++)
+                pieceKeys[p][sq] = next(state);
+        for (int i = 0; i < 16; i++)
+            castleKeys[i] = next(state);
+        for (int i = 0; i < 8; i++)
+            epKeys[i] = next(state);
+        sideKey = next(state);
+
+        static const int knightSteps[8][2] = { {1, 2}, {2, 1}, {2, -1}, {1, -2}, {-1, -2}, {-2, -1}, {-2, 1}, {-1, 2} };
+        for (int sq = 0; sq < 64; sq++) {
+            int x = sq & 7, y = sq >> 3;
+            knightCount[sq] = 0;
+            kingCount[sq] = 0;
+            for (int i = 0; i < 8; i++) {
+                int nx = x + knightSteps[i][0], ny = y + knightSteps[i][1];
+                if (nx >= 0 && nx < 8 && ny >= 0 && ny < 8)
+                    knightTargets[sq][knightCount[sq]++] = (uint8_t)(ny * 8 + nx);
+            }
+            for (int dx = -1; dx <= 1; dx++)
+                for (int dy = -1; dy <= 1; dy++) {
+                    int nx = x + dx, ny = y + dy;
+                    if ((dx != 0 || dy != 0) && nx >= 0 && nx < 8 && ny >= 0 && ny < 8)
+                        kingTargets[sq][kingCount[sq]++] = (uint8_t)(ny * 8 + nx);
+                }
+            castleMask[sq] = 15;
+        }
+        castleMask[4] = 15 & ~3;
+        castleMask[7] = 15 & ~1;
+        castleMask[0] = 15 & ~2;
+        castleMask[60] = 15 & ~12;
+        castleMask[63] = 15 & ~4;
+        castleMask[56] = 15 & ~8;
+    }
+} positionTables;
+
+Position::Position() {
+    reset();
+}
+
+/*
+ Resets the position to the starting position, with white to move
+ */
+void Position::reset() {
+    static const uint8_t backRank[8] = { RookType, KnightType, BishopType, QueenType, KingType, BishopType, KnightType, RookType };
+    for (int sq = 0; sq < 64; sq++)
+        squares[sq] = NoPiece;
+    for (int x = 0; x < 8; x++) {
+        squares[square(x, 0)] = makePiece(backRank[x], true);
+        squares[square(x, 1)] = WhitePawn;
+        squares[square(x, 6)] = BlackPawn;
+        squares[square(x, 7)] = makePiece(backRank[x], false);
+    }
+    kingSquare[0] = 4;
+    kingSquare[1] = 60;
+    whiteToMove = true;
+    castling = 15;
+    epLane = -1;
+    halfmoveClock = 0;
+    fullmoveNumber = 1;
+    computeHash();
+}
+
+/*
+ Copies a ChessBoard into a Position
+ board - the board to copy
+ whiteToMove - the side whose turn it is on the board
+ fullmoveNumber - the number of the move being played, counting from 1
+ */
+Position Position::fromBoard(ChessBoard& board, bool whiteToMove, int fullmoveNumber) {
+    Position pos;
+    for (int sq = 0; sq < 64; sq++)
+        pos.squares[sq] = NoPiece;
+
+    for (int x = 0; x < 8; x++) {
+        for (int y = 0; y < 8; y++) {
+            Piece* p = board.at(x, y);
+            if (p == nullptr || !p->isActive())
+                continue;
+            int type = 0;
+            switch (p->getIdentifier()) {
+                case 'P': type = PawnType; break;
+                case 'N': type = KnightType; break;
+                case 'B': type = BishopType; break;
+                case 'R': type = RookType; break;
+                case 'Q': type = QueenType; break;
+                case 'K': type = KingType; break;
+            }
+            pos.squares[square(x, y)] = makePiece(type, p->isWhite());
+            if (type == KingType)
+                pos.kingSquare[p->isWhite() ? 0 : 1] = (uint8_t)square(x, y);
+        }
+    }
+
+    //ChessBoard only tracks king movement, so the rooks being home is the best we can do for them
+    pos.castling = 0;
+    if (!board.kingHasMoved(true) && pos.squares[4] == WhiteKing) {
+        if (pos.squares[7] == WhiteRook) pos.castling |= 1;
+        if (pos.squares[0] == WhiteRook) pos.castling |= 2;
+    }
+    if (!board.kingHasMoved(false) && pos.squares[60] == BlackKing) {
+        if (pos.squares[63] == BlackRook) pos.castling |= 4;
+        if (pos.squares[56] == BlackRook) pos.castling |= 8;
+    }
+
+    int lane = board.getPawnStartingLane();
+    pos.epLane = (int8_t)((lane >= 0 && lane <= 7) ? lane : -1);
+    pos.whiteToMove = whiteToMove;
+    pos.halfmoveClock = 0;
+    pos.fullmoveNumber = (uint16_t)std::max(1, fullmoveNumber);
+    pos.computeHash();
+    return pos;
+}
+
+/*
+ Reads a FEN string. The clocks may be left off, taken then as 0 and 1
+ fen - the position, such as "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"
+ */
+bool Position::setFromFen(const std::string& fen) {
+    //Split by hand rather than with a stream, since services read a FEN with every request
+    std::string fields[6];
+    int count = 0;
+    for (size_t i = 0; i < fen.size() && count < 6; ) {
+        while (i < fen.size() && isspace((unsigned char)fen[i]))
+            i++;
+        size_t start = i;
+        while (i < fen.size() && !isspace((unsigned char)fen[i]))
+            i++;
+        if (i > start)
+            fields[count++].assign(fen, start, i - start);
+    }
+    const std::string& placement = fields[0];
+    const std::string& side = fields[1];
+    const std::string& rights = fields[2];
+    const std::string& ep = fields[3];
+    if (placement.empty() || side.empty())
+        return false;
+    int halfmove = atoi(fields[4].c_str());
+    int fullmove = atoi(fields[5].c_str());
+
+    Position pos;
+    for (int sq = 0; sq < 64; sq++)
+        pos.squares[sq] = NoPiece;
+
+    int x = 0, y = 7;
+    int kings[2] = { 0, 0 };
+    for (auto it = placement.begin(); it != placement.end(); it++) {
+        char c = *it;
+        if (c == '/') {
+            if (x != 8 || y == 0)
+                return false;
+            x = 0;
+            y--;
+        } else if (c >= '1' && c <= '8') {
+            x += c - '0';
+            if (x > 8)
+                return false;
+        } else {
+            static const std::string ids = "PNBRQK";
+            size_t type = ids.find((char)toupper(c));
+            if (type == std::string::npos || x > 7)
+                return false;
+            bool white = isupper(c) != 0;
+            pos.squares[square(x, y)] = makePiece((int)type + 1, white);
+            if (type + 1 == KingType) {
+                pos.kingSquare[white ? 0 : 1] = (uint8_t)square(x, y);
+                kings[white ? 0 : 1]++;
+            }
+            x++;
+        }
+    }
+    if (x != 8 || y != 0 || kings[0] != 1 || kings[1] != 1)
+        return false;
+
+    if (side != "w" && side != "b")
+        return false;
+    pos.whiteToMove = (side == "w");
+
+    pos.castling = 0;
+    for (auto it = rights.begin(); it != rights.end(); it++) {
+        switch (*it) {
+            case 'K': pos.castling |= 1; break;
+            case 'Q': pos.castling |= 2; break;
+            case 'k': pos.castling |= 4; break;
+            case 'q': pos.castling |= 8; break;
+        }
+    }
+
+    pos.epLane = -1;
+    if (ep.size() == 2 && ep[0] >= 'a' && ep[0] <= 'h')
+        pos.epLane = (int8_t)(ep[0] - 'a');
+
+    pos.halfmoveClock = (uint16_t)std::max(0, halfmove);
+    pos.fullmoveNumber = (uint16_t)std::max(1, fullmove);
+    pos.computeHash();
+    *this = pos;
+    return true;
+}
+
+/*
+ Sets up a position directly from the contents of its squares, without going through text
+ board - the piece on each square, NoPiece where it is empty
+ whiteToMove - the side to move
+ castling - the castling rights, as held in castling
+ epLane - the lane a pawn has just moved two squares in, or -1
+ halfmoveClock - plies since the last capture or pawn move
+ fullmoveNumber - the number of the move being played, counting from 1
+ */
+bool Position::setFromSquares(const uint8_t board[64], bool whiteToMove, int castling, int epLane, int halfmoveClock, int fullmoveNumber) {
+    Position pos;
+    int kings[2] = { 0, 0 };
+    for (int sq = 0; sq < 64; sq++) {
+        uint8_t p = board[sq];
+        if (p != NoPiece && (typeOf(p) < PawnType || typeOf(p) > KingType))
+            return false;
+        pos.squares[sq] = p;
+        if (p != NoPiece && typeOf(p) == KingType) {
+            pos.kingSquare[isWhitePiece(p) ? 0 : 1] = (uint8_t)sq;
+            kings[isWhitePiece(p) ? 0 : 1]++;
+        }
+    }
+    if (kings[0] != 1 || kings[1] != 1)
+        return false;
+
+    pos.whiteToMove = whiteToMove;
+    pos.castling = (uint8_t)(castling & 15);
+    pos.epLane = (int8_t)((epLane >= 0 && epLane < 8) ? epLane : -1);
+    pos.halfmoveClock = (uint16_t)std::max(0, halfmoveClock);
+    pos.fullmoveNumber = (uint16_t)std::max(1, fullmoveNumber);
+    pos.computeHash();
+    *this = pos;
+    return true;
+}
+
+std::string Position::toFen() const {
+    std::string fen;
+    for (int y = 7; y >= 0; y--) {
+        int empty = 0;
+        for (int x = 0; x < 8; x++) {
+            uint8_t p = squares[square(x, y)];
+            if (p == NoPiece) {
+                empty++;
+                continue;
+            }
+            if (empty > 0)
+                fen += (char)('0' + empty);
+            empty = 0;
+            char c = identifier(p);
+            fen += isWhitePiece(p) ? c : (char)tolower(c);
+        }
+        if (empty > 0)
+            fen += (char)('0' + empty);
+        if (y > 0)
+            fen += '/';
+    }
+
+    fen += whiteToMove ? " w " : " b ";
+    if (castling == 0)
+        fen += '-';
+    if (castling & 1) fen += 'K';
+    if (castling & 2) fen += 'Q';
+    if (castling & 4) fen += 'k';
+    if (castling & 8) fen += 'q';
+
+    if (epLane >= 0) {
+        fen += ' ';
+        fen += (char)('a' + epLane);
+        fen += whiteToMove ? '6' : '3';
+    } else {
+        fen += " -";
+    }
+
+    fen += ' ' + std::to_string(halfmoveClock) + ' ' + std::to_string(fullmoveNumber);
+    return fen;
+}
+
+std::string Position::moveName(CompactMove m) {
+    std::string name = { (char)('a' + fileOf(m.from())), (char)('1' + rankOf(m.from())),
+                         (char)('a' + fileOf(m.to())), (char)('1' + rankOf(m.to())) };
+    if (m.isPromotion())
+        name += (char)tolower(identifier((uint8_t)m.promotionType()));
+    return name;
+}
+
+/*
+ Finds the legal move a SAN string describes. The piece letter, destination, any file or rank given to
+ tell pieces apart, and the promotion must all agree with exactly one legal move.
+ A pawn reaching the last rank with no promotion given is taken to become a queen.
+ */
+CompactMove Position::fromSan(const std::string& text) {
+    std::string san = text;
+    while (!san.empty() && (san.back() == '+' || san.back() == '#' || san.back() == '!' || san.back() == '?'))
+        san.pop_back();
+
+    MoveList list;
+    generateLegalMoves(list);
+
+    if (san == "O-O" || san == "0-0" || san == "O-O-O" || san == "0-0-0") {
+        int special = (san.size() == 3) ? KingSideCastle : QueenSideCastle;
+        for (int i = 0; i < list.count; i++)
+            if (list[i].special() == special)
+                return list[i];
+        return CompactMove();
+    }
+
+    int promotion = 0;
+    size_t equals = san.find('=');
+    if (equals != std::string::npos) {
+        if (equals + 1 >= san.size())
+            return CompactMove();
+        promotion = (int)std::string(" PNBRQK").find((char)toupper(san[equals + 1]));
+        if (promotion < KnightType || promotion > QueenType)
+            return CompactMove();
+        san.erase(equals);
+    } else if (san.size() >= 3 && strchr("NBRQ", san.back()) != nullptr && isdigit(san[san.size() - 2])) {
+        promotion = (int)std::string(" PNBRQK").find(san.back());      // Written without the =, as in e8Q
+        san.pop_back();
+    }
+
+    int type = PawnType;
+    size_t start = 0;
+    if (!san.empty() && strchr("NBRQK", san[0]) != nullptr) {
+        type = (int)std::string(" PNBRQK").find(san[0]);
+        start = 1;
+    }
+    if (san.size() < start + 2)
+        return CompactMove();
+    char toFile = san[san.size() - 2], toRank = san[san.size() - 1];
+    if (toFile < 'a' || toFile > 'h' || toRank < '1' || toRank > '8')
+        return CompactMove();
+    int to = square(toFile - 'a', toRank - '1');
+
+    //Whatever is left between the piece and the destination narrows down where the piece came from
+    int fromFile = -1, fromRank = -1;
+    for (size_t i = start; i < san.size() - 2; i++) {
+        char c = san[i];
+        if (c >= 'a' && c <= 'h')
+            fromFile = c - 'a';
+        else if (c >= '1' && c <= '8')
+            fromRank = c - '1';
+        else if (c != 'x' && c != ':' && c != '-')
+            return CompactMove();
+    }
+
+    CompactMove found;
+    int matches = 0;
+    for (int i = 0; i < list.count; i++) {
+        CompactMove m = list[i];
+        if (m.to() != to || typeOf(squares[m.from()]) != type || m.isCastle())
+            continue;
+        if ((fromFile >= 0 && fileOf(m.from()) != fromFile) || (fromRank >= 0 && rankOf(m.from()) != fromRank))
+            continue;
+        if (m.isPromotion() && m.promotionType() != (promotion != 0 ? promotion : (int)QueenType))
+            continue;
+        if (!m.isPromotion() && promotion != 0)
+            continue;
+        found = m;
+        matches++;
+    }
+    return (matches == 1) ? found : CompactMove();
+}
+
+/*
+ Writes a legal move in SAN. Another piece of the same type able to reach the square is told apart by the
+ file if that is enough, then the rank, then both, and pawn captures name the file they came from.
+ */
+std::string Position::toSan(CompactMove m) {
+    std::string san;
+    if (m.special() == KingSideCastle) {
+        san = "O-O";
+    } else if (m.special() == QueenSideCastle) {
+        san = "O-O-O";
+    } else {
+        int type = typeOf(squares[m.from()]);
+        bool capture = squares[m.to()] != NoPiece || m.special() == EnPassant;
+        if (type == PawnType) {
+            if (capture)
+                san += (char)('a' + fileOf(m.from()));
+        } else {
+            san += identifier(squares[m.from()]);
+            MoveList list;
+            generateLegalMoves(list);
+            bool ambiguous = false, sameFile = false, sameRank = false;
+            for (int i = 0; i < list.count; i++) {
+                CompactMove other = list[i];
+                if (other.to() != m.to() || other.from() == m.from() || typeOf(squares[other.from()]) != type)
+                    continue;
+                ambiguous = true;
+                sameFile |= fileOf(other.from()) == fileOf(m.from());
+                sameRank |= rankOf(other.from()) == rankOf(m.from());
+            }
+            if (ambiguous && (!sameFile || sameRank))
+                san += (char)('a' + fileOf(m.from()));
+            if (ambiguous && sameFile)
+                san += (char)('1' + rankOf(m.from()));
+        }
+        if (capture)
+            san += 'x';
+        san += (char)('a' + fileOf(m.to()));
+        san += (char)('1' + rankOf(m.to()));
+        if (m.isPromotion()) {
+            san += '=';
+            san += identifier((uint8_t)m.promotionType());
+        }
+    }
+
+    UndoInfo undo;
+    makeMove(m, undo);
+    if (inCheck())
+        san += hasLegalMove() ? '+' : '#';
+    unmakeMove(m, undo);
+    return san;
+}
+
+char Position::identifier(uint8_t piece) {
+    static const char ids[8] = { ' ', 'P', 'N', 'B', 'R', 'Q', 'K', ' ' };
+    return ids[typeOf(piece)];
+}
+
+void Position::put(int sq, uint8_t piece) {
+    squares[sq] = piece;
+    hash ^= pieceKeys[piece][sq];
+}
+
+void Position::remove(int sq) {
+    hash ^= pieceKeys[squares[sq]][sq];
+    squares[sq] = NoPiece;
+}
+
+bool Position::epCapturePossible(int lane) const {
+    int y = whiteToMove ? 4 : 3;
+    uint8_t pawn = whiteToMove ? WhitePawn : BlackPawn;
+    return (lane > 0 && squares[square(lane - 1, y)] == pawn) ||
+           (lane < 7 && squares[square(lane + 1, y)] == pawn);
+}
+
+void Position::computeHash() {
+    hash = 0;
+    for (int sq = 0; sq < 64; sq++)
+        if (squares[sq] != NoPiece)
+            hash ^= pieceKeys[squares[sq]][sq];
+    hash ^= castleKeys[castling];
+    if (epLane >= 0 && epCapturePossible(epLane))
+        hash ^= epKeys[epLane];
+    if (!whiteToMove)
+        hash ^= sideKey;
+}
+
+/*
+ Checks whether the square is attacked by a piece of the given color
+ sq - the square to check
+ byWhite - the color of the attacking pieces
+ */
+bool Position::isAttacked(int sq, bool byWhite) const {
+    int x = fileOf(sq), y = rankOf(sq);
+
+    //Pawns attack from the rank behind them
+    int pawnY = y + (byWhite ? -1 : 1);
+    uint8_t pawn = makePiece(PawnType, byWhite);
+    if (pawnY >= 0 && pawnY < 8) {
+        if (x > 0 && squares[square(x - 1, pawnY)] == pawn)
+            return true;
+        if (x < 7 && squares[square(x + 1, pawnY)] == pawn)
+            return true;
+    }
+
+    uint8_t knight = makePiece(KnightType, byWhite);
+    for (int i = 0; i < knightCount[sq]; i++)
+        if (squares[knightTargets[sq][i]] == knight)
+            return true;
+
+    uint8_t king = makePiece(KingType, byWhite);
+    for (int i = 0; i < kingCount[sq]; i++)
+        if (squares[kingTargets[sq][i]] == king)
+            return true;
+
+    uint8_t queen = makePiece(QueenType, byWhite);
+    uint8_t rook = makePiece(RookType, byWhite);
+    for (int d = 0; d < 4; d++) {
+        int nx = x + rookDirections[d][0], ny = y + rookDirections[d][1];
+        while (nx >= 0 && nx < 8 && ny >= 0 && ny < 8) {
+            uint8_t p = squares[square(nx, ny)];
+            if (p != NoPiece) {
+                if (p == rook || p == queen)
+                    return true;
+                break;
+            }
+            nx += rookDirections[d][0];
+            ny += rookDirections[d][1];
+        }
+    }
+
+    uint8_t bishop = makePiece(BishopType, byWhite);
+    for (int d = 0; d < 4; d++) {
+        int nx = x + bishopDirections[d][0], ny = y + bishopDirections[d][1];
+        while (nx >= 0 && nx < 8 && ny >= 0 && ny < 8) {
+            uint8_t p = squares[square(nx, ny)];
+            if (p != NoPiece) {
+                if (p == bishop || p == queen)
+                    return true;
+                break;
+            }
+            nx += bishopDirections[d][0];
+            ny += bishopDirections[d][1];
+        }
+    }
+
+    return false;
+}
+
+void Position::addPawnMoves(int from, MoveList& list, bool capturesOnly) const {
+    int x = fileOf(from), y = rankOf(from);
+    int dir = whiteToMove ? 1 : -1;
+    int lastRank = whiteToMove ? 7 : 0;
+    int startRank = whiteToMove ? 1 : 6;
+    int ny = y + dir;
+
+    auto addWithPromotions = [&list, ny, lastRank, capturesOnly] (int from, int to) {
+        if (ny == lastRank) {
+            list.add(CompactMove(from, to, QueenPromotion));
+            if (!capturesOnly) {
+                list.add(CompactMove(from, to, KnightPromotion));
+                list.add(CompactMove(from, to, RookPromotion));
+                list.add(CompactMove(from, to, BishopPromotion));
+            }
+        } else {
+            list.add(CompactMove(from, to));
+        }
+    };
+
+    //Forward movement, of which only promotions count as captures
+    int forward = square(x, ny);
+    if (squares[forward] == NoPiece) {
+        if (!capturesOnly || ny == lastRank)
+            addWithPromotions(from, forward);
+        if (!capturesOnly && y == startRank && squares[square(x, ny + dir)] == NoPiece)
+            list.add(CompactMove(from, square(x, ny + dir), DoublePush));
+    }
+
+    //Diagonal taking and en passant
+    for (int dx = -1; dx <= 1; dx += 2) {
+        int nx = x + dx;
+        if (nx < 0 || nx > 7)
+            continue;
+        int to = square(nx, ny);
+        uint8_t target = squares[to];
+        if (target != NoPiece && isWhitePiece(target) != whiteToMove)
+            addWithPromotions(from, to);
+        else if (target == NoPiece && nx == epLane && y == (whiteToMove ? 4 : 3))
+            list.add(CompactMove(from, to, EnPassant));
+    }
+}
+
+void Position::addPieceMoves(int from, MoveList& list, bool capturesOnly) const {
+    uint8_t piece = squares[from];
+    int type = typeOf(piece);
+
+    auto consider = [this, &list, from, capturesOnly] (int to) {
+        uint8_t target = squares[to];
+        if (target == NoPiece) {
+            if (!capturesOnly)
+                list.add(CompactMove(from, to));
+        } else if (isWhitePiece(target) != whiteToMove) {
+            list.add(CompactMove(from, to));
+        }
+    };
+
+    if (type == KnightType) {
+        for (int i = 0; i < knightCount[from]; i++)
+            consider(knightTargets[from][i]);
+        return;
+    }
+    if (type == KingType) {
+        for (int i = 0; i < kingCount[from]; i++)
+            consider(kingTargets[from][i]);
+        return;
+    }
+
+    int x = fileOf(from), y = rankOf(from);
+    for (int pass = 0; pass < 2; pass++) {
+        const int (*dirs)[2] = (pass == 0) ? rookDirections : bishopDirections;
+        if (pass == 0 && type == BishopType)
+            continue;
+        if (pass == 1 && type == RookType)
+            continue;
+        for (int d = 0; d < 4; d++) {
+            int nx = x + dirs[d][0], ny = y + dirs[d][1];
+            while (nx >= 0 && nx < 8 && ny >= 0 && ny < 8) {
+                int to = square(nx, ny);
+                consider(to);
+                if (squares[to] != NoPiece)
+                    break;
+                nx += dirs[d][0];
+                ny += dirs[d][1];
+            }
+        }
+    }
+}
+
+void Position::addCastles(MoveList& list) const {
+    int rank = whiteToMove ? 0 : 7;
+    int kingSide = whiteToMove ? 1 : 4;
+    int queenSide = whiteToMove ? 2 : 8;
+    uint8_t king = makePiece(KingType, whiteToMove);
+    uint8_t rook = makePiece(RookType, whiteToMove);
+    int k = square(4, rank);
+
+    if (squares[k] != king || !(castling & (kingSide | queenSide)) || inCheck())
+        return;
+
+    if ((castling & kingSide) && squares[square(7, rank)] == rook &&
+        squares[square(5, rank)] == NoPiece && squares[square(6, rank)] == NoPiece &&
+        !isAttacked(square(5, rank), !whiteToMove) && !isAttacked(square(6, rank), !whiteToMove))
+        list.add(CompactMove(k, square(6, rank), KingSideCastle));
+
+    if ((castling & queenSide) && squares[square(0, rank)] == rook &&
+        squares[square(1, rank)] == NoPiece && squares[square(2, rank)] == NoPiece && squares[square(3, rank)] == NoPiece &&
+        !isAttacked(square(3, rank), !whiteToMove) && !isAttacked(square(2, rank), !whiteToMove))
+        list.add(CompactMove(k, square(2, rank), QueenSideCastle));
+}
+
+void Position::generatePseudoLegalMoves(MoveList& list) const {
+    list.count = 0;
+    for (int sq = 0; sq < 64; sq++) {
+        uint8_t p = squares[sq];
+        if (p == NoPiece || isWhitePiece(p) != whiteToMove)
+            continue;
+        if (typeOf(p) == PawnType)
+            addPawnMoves(sq, list, false);
+        else
+            addPieceMoves(sq, list, false);
+    }
+    addCastles(list);
+}
+
+void Position::generateCaptures(MoveList& list) const {
+    list.count = 0;
+    for (int sq = 0; sq < 64; sq++) {
+        uint8_t p = squares[sq];
+        if (p == NoPiece || isWhitePiece(p) != whiteToMove)
+            continue;
+        if (typeOf(p) == PawnType)
+            addPawnMoves(sq, list, true);
+        else
+            addPieceMoves(sq, list, true);
+    }
+}
+
+bool Position::isLegal(CompactMove m) {
+    bool mover = whiteToMove;
+    UndoInfo undo;
+    makeMove(m, undo);
+    bool legal = !isAttacked(kingSquare[mover ? 0 : 1], !mover);
+    unmakeMove(m, undo);
+    return legal;
+}
+
+void Position::generateLegalMoves(MoveList& list) {
+    MoveList pseudo;
+    generatePseudoLegalMoves(pseudo);
+    list.count = 0;
+    for (int i = 0; i < pseudo.count; i++)
+        if (isLegal(pseudo.moves[i]))
+            list.add(pseudo.moves[i]);
+}
+
+int Position::mobility(int sq) const {
+    uint8_t piece = squares[sq];
+    int type = typeOf(piece);
+    bool white = isWhitePiece(piece);
+    int count = 0;
+
+    if (type == KnightType || type == KingType) {
+        const uint8_t* targets = (type == KnightType) ? knightTargets[sq] : kingTargets[sq];
+        int n = (type == KnightType) ? knightCount[sq] : kingCount[sq];
+        for (int i = 0; i < n; i++) {
+            uint8_t target = squares[targets[i]];
+            if (target == NoPiece || isWhitePiece(target) != white)
+                count++;
+        }
+        return count;
+    }
+    if (type != BishopType && type != RookType && type != QueenType)
+        return 0;
+
+    int x = fileOf(sq), y = rankOf(sq);
+    for (int pass = 0; pass < 2; pass++) {
+        const int (*dirs)[2] = (pass == 0) ? rookDirections : bishopDirections;
+        if ((pass == 0 && type == BishopType) || (pass == 1 && type == RookType))
+            continue;
+        for (int d = 0; d < 4; d++) {
+            int nx = x + dirs[d][0], ny = y + dirs[d][1];
+            while (nx >= 0 && nx < 8 && ny >= 0 && ny < 8) {
+                uint8_t target = squares[square(nx, ny)];
+                if (target == NoPiece || isWhitePiece(target) != white)
+                    count++;
+                if (target != NoPiece)
+                    break;
+                nx += dirs[d][0];
+                ny += dirs[d][1];
+            }
+        }
+    }
+    return count;
+}
+
+/*
+ Makes a move, which must at least be pseudo legal
+ m - the move to make
+ undo - filled with the state needed by unmakeMove
+ */
+void Position::makeMove(CompactMove m, UndoInfo& undo) {
+    undo.hash = hash;
+    undo.castling = castling;
+    undo.epLane = epLane;
+    undo.halfmoveClock = halfmoveClock;
+    undo.captured = NoPiece;
+
+    int from = m.from(), to = m.to(), special = m.special();
+    uint8_t piece = squares[from];
+    bool white = whiteToMove;
+
+    if (epLane >= 0 && epCapturePossible(epLane))
+        hash ^= epKeys[epLane];
+    hash ^= castleKeys[castling];
+
+    if (special == EnPassant) {
+        int captureSquare = to + (white ? -8 : 8);
+        undo.captured = squares[captureSquare];
+        remove(captureSquare);
+    } else if (squares[to] != NoPiece) {
+        undo.captured = squares[to];
+        remove(to);
+    }
+
+    remove(from);
+    put(to, m.isPromotion() ? makePiece(m.promotionType(), white) : piece);
+
+    if (special == KingSideCastle || special == QueenSideCastle) {
+        int rank = white ? 0 : 7;
+        int rookFrom = square(special == KingSideCastle ? 7 : 0, rank);
+        int rookTo = square(special == KingSideCastle ? 5 : 3, rank);
+        uint8_t rook = squares[rookFrom];
+        remove(rookFrom);
+        put(rookTo, rook);
+    }
+
+    if (typeOf(piece) == KingType)
+        kingSquare[white ? 0 : 1] = (uint8_t)to;
+
+    castling &= castleMask[from] & castleMask[to];
+    halfmoveClock = (typeOf(piece) == PawnType || undo.captured != NoPiece) ? 0 : halfmoveClock + 1;
+    epLane = (int8_t)((special == DoublePush) ? fileOf(to) : -1);
+    if (!white)
+        fullmoveNumber++;
+
+    whiteToMove = !whiteToMove;
+    hash ^= sideKey;
+    hash ^= castleKeys[castling];
+    if (epLane >= 0 && epCapturePossible(epLane))
+        hash ^= epKeys[epLane];
+}
+
+void Position::unmakeMove(CompactMove m, const UndoInfo& undo) {
+    whiteToMove = !whiteToMove;
+    bool white = whiteToMove;
+    if (!white)
+        fullmoveNumber--;
+    int from = m.from(), to = m.to(), special = m.special();
+
+    uint8_t piece = m.isPromotion() ? makePiece(PawnType, white) : squares[to];
+    squares[from] = piece;
+    if (special == EnPassant) {
+        squares[to] = NoPiece;
+        squares[to + (white ? -8 : 8)] = undo.captured;
+    } else {
+        squares[to] = undo.captured;
+    }
+
+    if (special == KingSideCastle || special == QueenSideCastle) {
+        int rank = white ? 0 : 7;
+        int rookFrom = square(special == KingSideCastle ? 7 : 0, rank);
+        int rookTo = square(special == KingSideCastle ? 5 : 3, rank);
+        squares[rookFrom] = squares[rookTo];
+        squares[rookTo] = NoPiece;
+    }
+
+    if (typeOf(piece) == KingType)
+        kingSquare[white ? 0 : 1] = (uint8_t)from;
+
+    castling = undo.castling;
+    epLane = undo.epLane;
+    halfmoveClock = undo.halfmoveClock;
+    hash = undo.hash;
+}
+
+void Position::makeNullMove(UndoInfo& undo) {
+    undo.hash = hash;
+    undo.castling = castling;
+    undo.epLane = epLane;
+    undo.halfmoveClock = halfmoveClock;
+    undo.captured = NoPiece;
+
+    if (epLane >= 0 && epCapturePossible(epLane))
+        hash ^= epKeys[epLane];
+    epLane = -1;
+    if (!whiteToMove)
+        fullmoveNumber++;
+    whiteToMove = !whiteToMove;
+    hash ^= sideKey;
+    halfmoveClock++;
+}
+
+void Position::unmakeNullMove(const UndoInfo& undo) {
+    whiteToMove = !whiteToMove;
+    if (!whiteToMove)
+        fullmoveNumber--;
+    epLane = undo.epLane;
+    halfmoveClock = undo.halfmoveClock;
+    hash = undo.hash;
+}
+
+/*
+ Converts a move from a game file into a CompactMove, following the rules of ChessBoard::doMove, and checks
+ that it is legal here. Only the moves of the piece being moved are generated to check it against.
+ m - the move to convert
+ */
+CompactMove Position::fromStoredMove(const Move& m) const {
+    int k = kingSquare[whiteToMove ? 0 : 1];
+    CompactMove cm;
+    MoveList pseudo;
+    if (m == KING_CASTLE || m == QUEEN_CASTLE) {
+        cm = (m == KING_CASTLE) ? CompactMove(k, k + 2, KingSideCastle) : CompactMove(k, k - 2, QueenSideCastle);
+        addCastles(pseudo);
+    } else {
+        if (m.from.x < 0 || m.from.x > 7 || m.from.y < 0 || m.from.y > 7 ||
+            m.to.x < 0 || m.to.x > 7 || m.to.y < 0 || m.to.y > 7)
+            return CompactMove();
+
+        int from = square(m.from.x, m.from.y);
+        int to = square(m.to.x, m.to.y);
+        uint8_t piece = squares[from];
+        if (piece == NoPiece || isWhitePiece(piece) != whiteToMove || from == to)
+            return CompactMove();
+
+        cm = CompactMove(from, to);
+        if (typeOf(piece) == PawnType) {
+            if (std::abs(m.to.y - m.from.y) == 2)
+                cm = CompactMove(from, to, DoublePush);
+            else if (m.to.y == (whiteToMove ? 7 : 0))
+                cm = CompactMove(from, to, QueenPromotion);
+            else if (m.to.x != m.from.x && squares[to] == NoPiece)
+                cm = CompactMove(from, to, EnPassant);
+            addPawnMoves(from, pseudo, false);
+        } else {
+            addPieceMoves(from, pseudo, false);
+        }
+    }
+
+    for (int i = 0; i < pseudo.count; i++) {
+        if (pseudo[i] == cm) {
+            Position copy = *this;
+            return copy.isLegal(cm) ? cm : CompactMove();
+        }
+    }
+    return CompactMove();
+}
+
+Move Position::toStoredMove(CompactMove m) const {
+    if (m.special() == KingSideCastle)
+        return KING_CASTLE;
+    if (m.special() == QueenSideCastle)
+        return QUEEN_CASTLE;
+    return Move(Location(fileOf(m.from()), rankOf(m.from())), Location(fileOf(m.to()), rankOf(m.to())));
+}
+
+bool Position::applyStoredMove(const Move& m) {
+    CompactMove cm = fromStoredMove(m);
+    if (cm.isNull())
+        return false;
+    UndoInfo undo;
+    makeMove(cm, undo);
+    return true;
+}
+
+bool Position::hasLegalMove() {
+    MoveList pseudo;
+    generatePseudoLegalMoves(pseudo);
+    for (int i = 0; i < pseudo.count; i++)
+        if (isLegal(pseudo.moves[i]))
+            return true;
+    return false;
+}
+
+bool Position::isCheckmate() {
+    return inCheck() && !hasLegalMove();
+}
+
+bool Position::isStalemate() {
+    return !inCheck() && !hasLegalMove();
+}
@@ -0,0 +1,214 @@
+#ifndef Position_H
+#define Position_H
+
+#include <stdint.h>
+#include <string>
+#include "Move.h"
+
+class ChessBoard;
+
+//Piece codes used by Position. The low three bits hold the piece type, and bit 3 is set for black pieces
+enum PieceCode : uint8_t {
+    NoPiece = 0,
+    WhitePawn = 1, WhiteKnight, WhiteBishop, WhiteRook, WhiteQueen, WhiteKing,
+    BlackPawn = 9, BlackKnight, BlackBishop, BlackRook, BlackQueen, BlackKing
+};
+
+//Piece types, as held in the low three bits of a PieceCode
+enum PieceType {
+    PawnType = 1,
+    KnightType,
+    BishopType,
+    RookType,
+    QueenType,
+    KingType
+};
+
+//Special move kinds, held in the top four bits of a CompactMove
+enum MoveSpecial {
+    NormalMove = 0,
+    DoublePush,
+    EnPassant,
+    KingSideCastle,
+    QueenSideCastle,
+    KnightPromotion,
+    BishopPromotion,
+    RookPromotion,
+    QueenPromotion
+};
+
+//A move packed into 16 bits. Squares are numbered y * 8 + x, so A1 is 0 and H8 is 63
+struct CompactMove {
+    uint16_t data = 0;
+
+    CompactMove() { }
+    CompactMove(int from, int to, int special = NormalMove) : data((uint16_t)(from | (to << 6) | (special << 12))) { }
+
+    int from() const { return data & 63; }
+    int to() const { return (data >> 6) & 63; }
+    int special() const { return data >> 12; }
+
+    bool isNull() const { return data == 0; }
+    bool isCastle() const { return special() == KingSideCastle || special() == QueenSideCastle; }
+    bool isPromotion() const { return special() >= KnightPromotion; }
+
+    //The piece type a promotion turns into, or 0 if the move is not a promotion
+    int promotionType() const {
+        return isPromotion() ? special() - KnightPromotion + KnightType : 0;
+    }
+
+    bool operator==(const CompactMove& rhs) const { return data == rhs.data; }
+    bool operator!=(const CompactMove& rhs) const { return data != rhs.data; }
+};
+
+//A fixed capacity list of moves, large enough for any legal position
+struct MoveList {
+    CompactMove moves[256];
+    int count = 0;
+
+    void add(CompactMove m) { moves[count++] = m; }
+    CompactMove& operator[](int i) { return moves[i]; }
+    const CompactMove& operator[](int i) const { return moves[i]; }
+    int size() const { return count; }
+};
+
+//State needed to take back a move made with Position::makeMove
+struct UndoInfo {
+    uint64_t hash;
+    uint8_t captured;
+    uint8_t castling;
+    int8_t epLane;
+    uint16_t halfmoveClock;
+};
+
+/*
+ A compact copy of a board, used wherever positions must be searched or replayed in bulk.
+ ChessBoard stores pointers into its piece sets, which makes it expensive to copy and impossible
+ to take moves back. Position is a plain 64 byte mailbox, so it can be copied freely and moves
+ can be made and unmade without allocation.
+ */
+class Position {
+private:
+    uint8_t squares[64];
+    bool whiteToMove;
+    uint8_t castling;           //1 white king side, 2 white queen side, 4 black king side, 8 black queen side
+    int8_t epLane;              //Same meaning as ChessBoard::pawnStartingLane, -1 when there is none
+    uint8_t kingSquare[2];      //[0] white, [1] black
+    uint16_t halfmoveClock;
+    uint16_t fullmoveNumber;    //Starts at 1 and goes up after each of black's moves, as in a FEN
+    uint64_t hash;
+
+    //Helpers for the move generator
+    void addPawnMoves(int from, MoveList& list, bool capturesOnly) const;
+    void addPieceMoves(int from, MoveList& list, bool capturesOnly) const;
+    void addCastles(MoveList& list) const;
+
+    //Places or removes a piece, keeping the hash up to date
+    void put(int sq, uint8_t piece);
+    void remove(int sq);
+
+    //Recomputes the hash from scratch
+    void computeHash();
+
+    //Checks if the side to move has a pawn able to capture en passant on the given lane
+    bool epCapturePossible(int lane) const;
+
+public:
+
+    Position();
+
+    //Resets to the starting position
+    void reset();
+
+    //Copies the state of a ChessBoard, with the given side to move and move number, which the board does not keep
+    static Position fromBoard(ChessBoard& board, bool whiteToMove, int fullmoveNumber = 1);
+
+    //Reads a position in Forsyth-Edwards Notation, returning false and leaving the position unchanged if it is malformed
+    bool setFromFen(const std::string& fen);
+
+    //Sets up a position from its squares and state, returning false unless each side has one king
+    bool setFromSquares(const uint8_t board[64], bool whiteToMove, int castling, int epLane, int halfmoveClock, int fullmoveNumber = 1);
+    std::string toFen() const;
+
+    uint8_t at(int sq) const { return squares[sq]; }
+    uint8_t at(int x, int y) const { return squares[y * 8 + x]; }
+
+    bool isWhiteToMove() const { return whiteToMove; }
+    int getEpLane() const { return epLane; }
+    int getCastling() const { return castling; }
+    int getHalfmoveClock() const { return halfmoveClock; }
+    int getFullmoveNumber() const { return fullmoveNumber; }
+    int kingLocation(bool whitesKing) const { return kingSquare[whitesKing ? 0 : 1]; }
+
+    //A 64 bit Zobrist key for the position
+    uint64_t key() const { return hash; }
+
+    //Checks whether the square is attacked by the given side
+    bool isAttacked(int sq, bool byWhite) const;
+
+    //Checks whether the side to move is in check
+    bool inCheck() const {
+        return isAttacked(kingSquare[whiteToMove ? 0 : 1], !whiteToMove);
+    }
+
+    //Generates moves which obey piece movement, but may leave the king in check
+    void generatePseudoLegalMoves(MoveList& list) const;
+
+    //Generates captures and promotions only, which may leave the king in check
+    void generateCaptures(MoveList& list) const;
+
+    //Generates all legal moves for the side to move
+    void generateLegalMoves(MoveList& list);
+
+    //Checks that a pseudo legal move does not leave the mover's king in check
+    bool isLegal(CompactMove m);
+
+    //Number of squares a non-pawn piece on sq could move to, ignoring checks
+    int mobility(int sq) const;
+
+    //Makes a move, filling the undo information needed to take it back
+    void makeMove(CompactMove m, UndoInfo& undo);
+    void unmakeMove(CompactMove m, const UndoInfo& undo);
+
+    //Passes the turn without moving, for null move searches
+    void makeNullMove(UndoInfo& undo);
+    void unmakeNullMove(const UndoInfo& undo);
+
+    //Converts between the Move stored in game files and a CompactMove in this position.
+    //fromStoredMove follows ChessBoard::doMove, so pawns reaching the end always become queens.
+    //A null move is returned if the stored move is not legal in the position
+    CompactMove fromStoredMove(const Move& m) const;
+    Move toStoredMove(CompactMove m) const;
+
+    //Makes a move read from a game file, returning false if it is not legal in the position
+    bool applyStoredMove(const Move& m);
+
+    //Checks if the side to move has any legal move at all, stopping at the first one found
+    bool hasLegalMove();
+
+    //Checks if the side to move has been checkmated / stalemated
+    bool isCheckmate();
+    bool isStalemate();
+
+    //Helpers for working with piece codes and squares
+    static int typeOf(uint8_t piece) { return piece & 7; }
+    static bool isWhitePiece(uint8_t piece) { return piece != NoPiece && (piece & 8) == 0; }
+    static uint8_t makePiece(int type, bool white) { return (uint8_t)(type | (white ? 0 : 8)); }
+    static int square(int x, int y) { return y * 8 + x; }
+    static int fileOf(int sq) { return sq & 7; }
+    static int rankOf(int sq) { return sq >> 3; }
+    static char identifier(uint8_t piece);
+
+    //Names a move by its squares, such as e2e4 or e7e8q
+    static std::string moveName(CompactMove m);
+
+    //Reads a move in standard algebraic notation, such as Nbd7, exd8=Q+ or O-O-O, returning a null move
+    //if it is not exactly one legal move. Check, mate and annotation marks are ignored
+    CompactMove fromSan(const std::string& san);
+
+    //Names a legal move in standard algebraic notation, such as Nbd7, exd8=Q+ or O-O-O, with + or # when it
+    //gives check or mate. The move is made and taken back to find these, so the position is left as it was
+    std::string toSan(CompactMove m);
+};
+
+#endif
@@ -0,0 +1,270 @@
+#include "PositionIndex.h"
+#include "Position.h"
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <fstream>
+
+static const char indexMagic[8] = {'C', 'H', 'E', 'S', 'S', 'P', 'I', '1'};
+static const uint32_t indexVersion = 1;
+//Games are handed to the build threads this many at a time
+static const int gameBlock = 64;
+//Entries read from each run at a time while merging
+static const size_t mergeBufferEntries = 16384;
+//The most runs merged at once, which keeps the open files and buffers within bounds however many runs there are
+static const size_t mergeFanIn = 64;
+
+/*
+ Replays the database into sorted runs on several threads, then merges the runs into the index. The index
+ is written to a temporary name and renamed over the old one, so readers never see half an index.
+ storage - the games to index
+ fileName - the index file
+ threads - the threads to replay with, or 0 for every core
+ runBytes - the memory all the threads' runs may use together
+ */
+bool PositionIndex::build(const GameStorage& storage, std::string fileName, int threads, size_t runBytes) {
+    if (threads <= 0)
+        threads = std::max(1, (int)std::thread::hardware_concurrency());
+    size_t runEntries = std::max<size_t>(1024, runBytes / sizeof(Entry) / threads);
+
+    std::atomic<int> nextGame(0);
+    std::atomic<int> nextRun(0);
+    std::atomic<bool> failed(false);
+    std::mutex runLock;
+    std::vector<std::string> runs;
+
+    //Sorts the run and writes it out, leaving it empty
+    auto writeRun = [&](std::vector<Entry>& run) {
+        if (run.empty())
+            return;
+        std::sort(run.begin(), run.end(), [](const Entry& a, const Entry& b) {
+            return a.key != b.key ? a.key < b.key : (a.game != b.game ? a.game < b.game : a.ply < b.ply);
+        });
+        std::string name = fileName + ".run" + std::to_string(nextRun++);
+        std::ofstream out(name, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(run.data()), run.size() * sizeof(Entry));
+        out.close();
+        if (out.fail())
+            failed = true;
+        std::lock_guard<std::mutex> guard(runLock);
+        runs.push_back(name);
+        run.clear();
+    };
+
+    auto worker = [&]() {
+        std::vector<Entry> run;
+        run.reserve(runEntries);
+        std::vector<Move> moves;
+        int first;
+        while (!failed && (first = nextGame.fetch_add(gameBlock)) < storage.size()) {
+            int last = std::min(first + gameBlock, storage.size());
+            for (int id = first; id < last; id++) {
+                if (!storage.loadGame(id, moves))
+                    continue;
+                Position pos;
+                pos.reset();
+                for (uint32_t ply = 0; ; ply++) {
+                    run.push_back(Entry{pos.key(), (uint32_t)id, ply});
+                    if (run.size() == runEntries)
+                        writeRun(run);
+                    if (ply == moves.size() || !pos.applyStoredMove(moves[ply]))
+                        break;
+                }
+            }
+        }
+        writeRun(run);
+    };
+
+    std::vector<std::thread> pool;
+    for (int t = 0; t < threads; t++)
+        pool.push_back(std::thread(worker));
+    for (auto it = pool.begin(); it != pool.end(); it++)
+        it->join();
+
+    bool built = !failed && mergeRuns(runs, fileName + ".new", (uint64_t)storage.size()) &&
+                 rename((fileName + ".new").c_str(), fileName.c_str()) == 0;
+    //The merge removes the runs it has read, so only those of a failed build are left
+    for (auto it = runs.begin(); it != runs.end(); it++)
+        remove(it->c_str());
+    if (!built)
+        remove((fileName + ".new").c_str());
+    return built;
+}
+
+/*
+ Merges runs with a heap holding the smallest unread entry of each, reading every run and writing out in
+ large sequential blocks.
+ runs - the sorted run files, no more than mergeFanIn of them
+ out - where the merged entries go, from its current position
+ written - set to the number of entries written
+ */
+bool PositionIndex::mergeFiles(const std::vector<std::string>& runs, std::ofstream& out, uint64_t& written) {
+    struct Source {
+        std::ifstream in;
+        std::vector<Entry> buffer;
+        size_t position = 0;
+
+        bool refill() {
+            buffer.resize(mergeBufferEntries);
+            in.read(reinterpret_cast<char*>(buffer.data()), buffer.size() * sizeof(Entry));
+            buffer.resize((size_t)in.gcount() / sizeof(Entry));
+            position = 0;
+            return !buffer.empty();
+        }
+    };
+
+    std::vector<Source> sources(runs.size());
+    typedef std::pair<Entry, size_t> Item;
+    auto later = [](const Item& a, const Item& b) {
+        if (a.first.key != b.first.key)
+            return a.first.key > b.first.key;
+        if (a.first.game != b.first.game)
+            return a.first.game > b.first.game;
+        return a.first.ply > b.first.ply;
+    };
+    std::priority_queue<Item, std::vector<Item>, decltype(later)> heap(later);
+    for (size_t i = 0; i < runs.size(); i++) {
+        sources[i].in.open(runs[i], std::ios::binary);
+        if (!sources[i].in.is_open())
+            return false;
+        if (sources[i].refill())
+            heap.push(Item(sources[i].buffer[0], i));
+    }
+
+    std::vector<Entry> block;
+    block.reserve(mergeBufferEntries);
+    written = 0;
+    while (!heap.empty()) {
+        Item top = heap.top();
+        heap.pop();
+        block.push_back(top.first);
+        if (block.size() == mergeBufferEntries) {
+            out.write(reinterpret_cast<const char*>(block.data()), block.size() * sizeof(Entry));
+            written += block.size();
+            block.clear();
+        }
+
+        Source& source = sources[top.second];
+        if (++source.position < source.buffer.size() || source.refill())
+            heap.push(Item(source.buffer[source.position], top.second));
+    }
+    out.write(reinterpret_cast<const char*>(block.data()), block.size() * sizeof(Entry));
+    written += block.size();
+    return !out.fail();
+}
+
+/*
+ Merges the runs into the index. Only mergeFanIn runs are open at once, so while there are more than that
+ they are merged in groups into longer runs, a pass at a time, until few enough are left for the last merge.
+ Each group of runs is removed as soon as it has been merged, so the runs and what they merge into are never
+ all on disk at once.
+ */
+bool PositionIndex::mergeRuns(const std::vector<std::string>& runs, const std::string& fileName, uint64_t games) {
+    std::vector<std::string> current = runs;
+    std::vector<std::string> merged;        //Every run the passes make, any left removed at the end
+    bool ok = true;
+    for (int pass = 0; ok && current.size() > mergeFanIn; pass++) {
+        std::vector<std::string> next;
+        for (size_t first = 0; ok && first < current.size(); first += mergeFanIn) {
+            std::vector<std::string> group(current.begin() + first, current.begin() + std::min(current.size(), first + mergeFanIn));
+            std::string name = fileName + ".pass" + std::to_string(pass) + "." + std::to_string(next.size());
+            std::ofstream out(name, std::ios::binary | std::ios::trunc);
+            uint64_t written;
+            merged.push_back(name);
+            ok = out.is_open() && mergeFiles(group, out, written);
+            out.close();
+            ok = ok && !out.fail();
+            if (ok)
+                for (auto it = group.begin(); it != group.end(); it++)
+                    remove(it->c_str());
+            next.push_back(name);
+        }
+        current.swap(next);
+    }
+
+    std::ofstream out;
+    if (ok)
+        out.open(fileName, std::ios::binary | std::ios::trunc);
+    ok = ok && out.is_open();
+    char headerBytes[HeaderBytes] = {};
+    uint64_t written = 0;
+    if (ok) {
+        out.write(headerBytes, sizeof(headerBytes));
+        ok = mergeFiles(current, out, written);
+    }
+    if (ok)
+        for (auto it = current.begin(); it != current.end(); it++)
+            remove(it->c_str());
+    for (auto it = merged.begin(); it != merged.end(); it++)
+        remove(it->c_str());
+    if (!ok)
+        return false;
+
+    //The header goes in last, once the count is known
+    Header header = {};
+    memcpy(header.magic, indexMagic, sizeof(indexMagic));
+    header.version = indexVersion;
+    header.entrySize = sizeof(Entry);
+    header.count = written;
+    header.games = games;
+    memcpy(headerBytes, &header, sizeof(header));
+    out.seekp(0);
+    out.write(headerBytes, sizeof(headerBytes));
+    out.close();
+    return !out.fail();
+}
+
+bool PositionIndex::open(std::string fileName) {
+    close();
+
+    Header header;
+    bool valid = file.open(fileName) && file.size() >= HeaderBytes && file.read(&header, sizeof(header), 0) &&
+                 memcmp(header.magic, indexMagic, sizeof(indexMagic)) == 0 &&
+                 header.version == indexVersion && header.entrySize == sizeof(Entry) &&
+                 (uint64_t)file.size() == HeaderBytes + header.count * sizeof(Entry);
+    //Lookups jump around the file, so reading ahead would only waste memory
+    if (!valid || !file.map(true)) {
+        close();
+        return false;
+    }
+
+    entries = reinterpret_cast<const Entry*>(file.data() + HeaderBytes);
+    count = header.count;
+    games = header.games;
+    return true;
+}
+
+void PositionIndex::close() {
+    file.close();
+    entries = nullptr;
+    count = 0;
+    games = 0;
+}
+
+uint64_t PositionIndex::lowerBound(uint64_t key) const {
+    uint64_t low = 0, high = count;
+    while (low < high) {
+        uint64_t middle = low + (high - low) / 2;
+        if (entries[middle].key < key)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return low;
+}
+
+std::vector<PositionHit> PositionIndex::lookup(uint64_t key, size_t limit) const {
+    std::vector<PositionHit> hits;
+    for (uint64_t i = lowerBound(key); i < count && entries[i].key == key && hits.size() < limit; i++)
+        hits.push_back(PositionHit{entries[i].game, entries[i].ply});
+    return hits;
+}
+
+uint64_t PositionIndex::occurrences(uint64_t key) const {
+    uint64_t last = (key == UINT64_MAX) ? count : lowerBound(key + 1);
+    return last - lowerBound(key);
+}
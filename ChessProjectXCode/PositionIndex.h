@@ -0,0 +1,95 @@
+#ifndef PositionIndex_H
+#define PositionIndex_H
+
+#include "GameStorage.h"
+#include "MappedFile.h"
+#include <fstream>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+//One place a position was reached: the game's id in the database, and the number of plies played before it
+struct PositionHit {
+    uint32_t game;
+    uint32_t ply;
+};
+
+/*
+ An inverted index from positions to the games which reached them, so finding them is a binary search
+ rather than a replay of the whole archive.
+ The file is a header and then one entry per ply of every game, the position's key with the game and ply,
+ sorted by key. It is memory mapped, so a lookup touches only the few pages its search lands on.
+
+ Building replays the games on every core. Each thread gathers entries into a run of bounded size, sorts
+ it and writes it to a temporary file when it fills, and the runs are then merged into the index, a
+ bounded number at a time, so an archive of any size is indexed in a fixed amount of memory and files.
+ */
+class PositionIndex {
+private:
+    struct Entry {
+        uint64_t key;
+        uint32_t game;
+        uint32_t ply;
+    };
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t entrySize;
+        uint64_t count;
+        uint64_t games;         //Games in the database when the index was built
+    };
+
+    MappedFile file;
+    const Entry* entries = nullptr;
+    uint64_t count = 0;
+    uint64_t games = 0;
+
+    //The first entry with the key, or count if there is none
+    uint64_t lowerBound(uint64_t key) const;
+    //Merges sorted run files into the index file, removing each once it is merged. Returns false if any could
+    //not be read or written
+    static bool mergeRuns(const std::vector<std::string>& runs, const std::string& fileName, uint64_t games);
+    //Merges up to mergeFanIn sorted run files into an open file, counting the entries written
+    static bool mergeFiles(const std::vector<std::string>& runs, std::ofstream& out, uint64_t& written);
+
+public:
+
+    //Bytes before the first entry
+    static const size_t HeaderBytes = 64;
+    //The memory the build may use for runs, across all its threads
+    static const size_t DefaultRunBytes = 64 * 1024 * 1024;
+
+    PositionIndex() { }
+    ~PositionIndex() {
+        close();
+    }
+
+    //Indexes every game in the database, replacing the file once the new index is complete.
+    //threads - 0 uses every core
+    //runBytes - the memory the build may use, beyond which entries are sorted to temporary files
+    static bool build(const GameStorage& storage, std::string fileName, int threads = 0, size_t runBytes = DefaultRunBytes);
+
+    //Maps an index file, returning false if it is missing or not an index
+    bool open(std::string fileName);
+    void close();
+
+    bool isOpen() const {
+        return file.isMapped();
+    }
+
+    //Every place the position was reached, in game order, up to the limit
+    std::vector<PositionHit> lookup(uint64_t key, size_t limit = 1000) const;
+    //The number of times the position was reached
+    uint64_t occurrences(uint64_t key) const;
+
+    //The number of games indexed, to tell whether the database has grown since
+    uint64_t gameCount() const {
+        return games;
+    }
+    //The number of positions indexed
+    uint64_t size() const {
+        return count;
+    }
+};
+
+#endif
@@ -0,0 +1,356 @@
+#include "PositionService.h"
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <errno.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <functional>
+
+PositionService::PositionService(int threads) : started(std::chrono::steady_clock::now()) {
+    threadCount = (threads > 0) ? threads : std::max(1, (int)std::thread::hardware_concurrency());
+    for (int t = 0; t < threadCount; t++)
+        workers.push_back(std::thread(&PositionService::work, this));
+}
+
+PositionService::~PositionService() {
+    {
+        std::lock_guard<std::mutex> guard(queueLock);
+        stopping = true;
+    }
+    queueChanged.notify_all();
+    for (auto it = workers.begin(); it != workers.end(); it++)
+        it->join();
+}
+
+//Splits the next word off a request, moving p past it. Returns false when there are no words left
+static bool nextWord(const char*& p, const char* end, const char*& word, size_t& length) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+        p++;
+    word = p;
+    while (p < end && *p != ' ' && *p != '\t' && *p != '\r')
+        p++;
+    length = (size_t)(p - word);
+    return length > 0;
+}
+
+static bool wordIs(const char* word, size_t length, const char* text) {
+    return length == strlen(text) && memcmp(word, text, length) == 0;
+}
+
+static void appendMove(std::string& out, CompactMove m) {
+    out += (char)('a' + Position::fileOf(m.from()));
+    out += (char)('1' + Position::rankOf(m.from()));
+    out += (char)('a' + Position::fileOf(m.to()));
+    out += (char)('1' + Position::rankOf(m.to()));
+    if (m.isPromotion())
+        out += (char)tolower(Position::identifier((uint8_t)m.promotionType()));
+}
+
+/*
+ Finds the legal move a word names, as coordinates such as e7e8q or as SAN. A promotion given as
+ coordinates without a piece becomes a queen. Returns a null move if no legal move matches.
+ */
+static CompactMove findMove(Position& pos, const char* word, size_t length) {
+    bool coordinates = (length == 4 || length == 5) && word[0] >= 'a' && word[0] <= 'h' && word[1] >= '1' && word[1] <= '8' &&
+                       word[2] >= 'a' && word[2] <= 'h' && word[3] >= '1' && word[3] <= '8';
+    if (!coordinates)
+        return pos.fromSan(std::string(word, length));
+
+    int from = Position::square(word[0] - 'a', word[1] - '1');
+    int to = Position::square(word[2] - 'a', word[3] - '1');
+    int promotion = QueenType;
+    if (length == 5) {
+        static const char pieces[] = "nbrq";
+        const char* found = (word[4] != '\0') ? strchr(pieces, tolower(word[4])) : nullptr;
+        if (found == nullptr)
+            return CompactMove();
+        promotion = KnightType + (int)(found - pieces);
+    }
+    //Only the move named needs its legality checked, rather than every move as generateLegalMoves would
+    MoveList pseudo;
+    pos.generatePseudoLegalMoves(pseudo);
+    for (int i = 0; i < pseudo.count; i++) {
+        CompactMove m = pseudo[i];
+        if (m.from() == from && m.to() == to && (!m.isPromotion() || m.promotionType() == promotion))
+            return pos.isLegal(m) ? m : CompactMove();
+    }
+    return CompactMove();
+}
+
+bool PositionService::answer(const char* begin, const char* end, Position& pos, std::string& out) {
+    const char* p = begin;
+    const char *id, *query, *argument = nullptr, *word;
+    size_t idLength, queryLength, argumentLength = 0, length;
+    nextWord(p, end, id, idLength);
+    out.append(id, idLength);
+    auto fail = [&](const char* reason, const char* detail = nullptr, size_t detailLength = 0) {
+        out += " error ";
+        out += reason;
+        if (detail != nullptr) {
+            out += ' ';
+            out.append(detail, detailLength);
+        }
+        out += '\n';
+        return false;
+    };
+    if (!nextWord(p, end, query, queryLength))
+        return fail("no query");
+    bool needsArgument = wordIs(query, queryLength, "legal") || wordIs(query, queryLength, "san") || wordIs(query, queryLength, "coord");
+    if (needsArgument && !nextWord(p, end, argument, argumentLength))
+        return fail("no move given");
+
+    //The position, then any moves played from it
+    if (!nextWord(p, end, word, length))
+        return fail("no position");
+    if (wordIs(word, length, "startpos")) {
+        pos.reset();
+    } else {
+        //A FEN runs up to the word moves, or the end of the line
+        const char* fenStart = word;
+        const char* fenEnd = word + length;
+        for (const char* q = p; nextWord(q, end, word, length) && !wordIs(word, length, "moves"); p = q)
+            fenEnd = word + length;
+        if (!pos.setFromFen(std::string(fenStart, fenEnd)))
+            return fail("bad position");
+    }
+    if (nextWord(p, end, word, length)) {
+        if (!wordIs(word, length, "moves"))
+            return fail("unexpected", word, length);
+        while (nextWord(p, end, word, length)) {
+            CompactMove m = findMove(pos, word, length);
+            if (m.isNull())
+                return fail("illegal move", word, length);
+            UndoInfo undo;
+            pos.makeMove(m, undo);
+        }
+    }
+
+    out += " ok ";
+    if (wordIs(query, queryLength, "status")) {
+        bool check = pos.inCheck();
+        if (pos.hasLegalMove())
+            out += check ? "check" : "normal";
+        else
+            out += check ? "checkmate" : "stalemate";
+    } else if (wordIs(query, queryLength, "moves")) {
+        MoveList legal;
+        pos.generateLegalMoves(legal);
+        out += std::to_string(legal.count);
+        for (int i = 0; i < legal.count; i++) {
+            out += ' ';
+            appendMove(out, legal[i]);
+        }
+    } else if (wordIs(query, queryLength, "legal")) {
+        out += findMove(pos, argument, argumentLength).isNull() ? "false" : "true";
+    } else if (wordIs(query, queryLength, "san") || wordIs(query, queryLength, "coord")) {
+        CompactMove m = findMove(pos, argument, argumentLength);
+        if (m.isNull()) {
+            out.resize(out.size() - 4);
+            return fail("illegal move", argument, argumentLength);
+        }
+        if (query[0] == 's')
+            out += pos.toSan(m);
+        else
+            appendMove(out, m);
+    } else if (wordIs(query, queryLength, "fen")) {
+        out += pos.toFen();
+    } else {
+        out.resize(out.size() - 4);
+        return fail("unknown query", query, queryLength);
+    }
+    out += '\n';
+    return true;
+}
+
+void PositionService::work() {
+    Position pos;
+    std::string out;
+    while (true) {
+        Batch batch;
+        {
+            std::unique_lock<std::mutex> guard(queueLock);
+            queueChanged.wait(guard, [&] { return stopping || !queue.empty(); });
+            if (queue.empty())
+                return;
+            batch = std::move(queue.front());
+            queue.pop_front();
+        }
+        queueChanged.notify_all();
+
+        out.clear();
+        uint64_t requests = 0, errors = 0;
+        const char* line = batch.requests.data();
+        const char* end = line + batch.requests.size();
+        while (line < end) {
+            const char* lineEnd = static_cast<const char*>(memchr(line, '\n', (size_t)(end - line)));
+            if (lineEnd == nullptr)
+                lineEnd = end;
+            const char* p = line;
+            const char* word;
+            size_t length;
+            if (nextWord(p, lineEnd, word, length)) {
+                requests++;
+                errors += !answer(line, lineEnd, pos, out);
+            }
+            line = lineEnd + 1;
+        }
+        requestCount += requests;
+        errorCount += errors;
+        batchCount++;
+
+        Connection& connection = *batch.connection;
+        {
+            std::lock_guard<std::mutex> guard(connection.lock);
+            if (!connection.failed)
+                connection.unwritten += out;
+            connection.pending--;
+        }
+        connection.changed.notify_all();
+    }
+}
+
+void PositionService::submit(Batch batch) {
+    Connection& connection = *batch.connection;
+    {
+        std::unique_lock<std::mutex> guard(connection.lock);
+        connection.changed.wait(guard, [&] { return connection.unwritten.size() < UnwrittenBytes || connection.failed; });
+        connection.pending++;
+    }
+    std::unique_lock<std::mutex> guard(queueLock);
+    queueChanged.wait(guard, [&] { return queue.size() < (size_t)threadCount * 4; });
+    queue.push_back(std::move(batch));
+    guard.unlock();
+    queueChanged.notify_all();
+}
+
+void PositionService::writeAnswers(Connection& connection) {
+    std::string answers;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> guard(connection.lock);
+            connection.changed.wait(guard, [&] { return !connection.unwritten.empty() || connection.finished; });
+            if (connection.unwritten.empty())
+                return;
+            answers.clear();
+            answers.swap(connection.unwritten);
+        }
+        //The reader may be waiting for room
+        connection.changed.notify_all();
+
+        size_t written = 0;
+        while (written < answers.size()) {
+            ssize_t n = write(connection.outputFd, answers.data() + written, answers.size() - written);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                break;
+            written += (size_t)n;
+        }
+        if (written < answers.size()) {
+            std::lock_guard<std::mutex> guard(connection.lock);
+            connection.failed = true;
+            connection.unwritten.clear();
+        }
+    }
+}
+
+/*
+ Reads whatever has arrived, up to a large buffer at a time, and hands every complete line on to the
+ workers in batches of about BatchBytes, keeping a partial last line until the rest of it arrives.
+ */
+void PositionService::serve(int inputFd, int outputFd) {
+    std::shared_ptr<Connection> connection(new Connection());
+    connection->outputFd = outputFd;
+    std::thread writer(&PositionService::writeAnswers, std::ref(*connection));
+
+    std::string pending;
+    std::vector<char> buffer(1 << 16);
+    while (true) {
+        ssize_t got = read(inputFd, buffer.data(), buffer.size());
+        if (got < 0 && errno == EINTR)
+            continue;
+        if (got <= 0)
+            break;
+        pending.append(buffer.data(), (size_t)got);
+        size_t lastEnd = pending.rfind('\n');
+        if (lastEnd == std::string::npos)
+            continue;
+        for (size_t start = 0; start <= lastEnd; ) {
+            size_t cut = (start + BatchBytes >= lastEnd) ? lastEnd : pending.find('\n', start + BatchBytes);
+            submit(Batch{connection, pending.substr(start, cut + 1 - start)});
+            start = cut + 1;
+        }
+        pending.erase(0, lastEnd + 1);
+    }
+    if (!pending.empty())
+        submit(Batch{connection, pending});
+
+    {
+        std::unique_lock<std::mutex> guard(connection->lock);
+        connection->changed.wait(guard, [&] { return connection->pending == 0; });
+        connection->finished = true;
+    }
+    connection->changed.notify_all();
+    writer.join();
+}
+
+void PositionService::serveStream(int inputFd, int outputFd) {
+    signal(SIGPIPE, SIG_IGN);
+    serve(inputFd, outputFd);
+}
+
+bool PositionService::serveSocket(const std::string& path) {
+    signal(SIGPIPE, SIG_IGN);
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path))
+        return false;
+    strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0)
+        return false;
+    unlink(path.c_str());
+    if (bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(listener, 64) != 0) {
+        close(listener);
+        return false;
+    }
+
+    while (true) {
+        int client = accept(listener, nullptr, nullptr);
+        if (client < 0 && errno == EINTR)
+            continue;
+        if (client < 0)
+            break;
+        {
+            std::lock_guard<std::mutex> guard(clientsLock);
+            clients++;
+        }
+        std::thread([this, client] {
+            serve(client, client);
+            close(client);
+            std::lock_guard<std::mutex> guard(clientsLock);
+            if (--clients == 0)
+                clientsDone.notify_all();
+        }).detach();
+    }
+    close(listener);
+    unlink(path.c_str());
+
+    //The reader threads use the workers, so they must all finish before the service can be destroyed
+    std::unique_lock<std::mutex> guard(clientsLock);
+    clientsDone.wait(guard, [&] { return clients == 0; });
+    return true;
+}
+
+ServiceStats PositionService::stats() const {
+    ServiceStats totals;
+    totals.requests = requestCount;
+    totals.errors = errorCount;
+    totals.batches = batchCount;
+    totals.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    return totals;
+}
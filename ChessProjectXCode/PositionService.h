@@ -0,0 +1,124 @@
+#ifndef PositionService_H
+#define PositionService_H
+
+#include "Position.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+
+//Totals of the requests a service has answered
+struct ServiceStats {
+    uint64_t requests = 0;
+    uint64_t errors = 0;            //Requests answered with an error
+    uint64_t batches = 0;
+    double seconds = 0;
+
+    double requestsPerSecond() const {
+        return seconds > 0 ? requests / seconds : 0;
+    }
+};
+
+/*
+ Answers questions about positions for other programs, one request a line, over standard input and output
+ or a Unix domain socket. A request is
+    <id> <query> [argument] <position> [moves <move> ...]
+ where the position is startpos or a FEN, and the moves, as coordinates such as e2e4 or e7e8q or as SAN,
+ are played from it first. The queries are
+    status          - normal, check, checkmate or stalemate
+    moves           - the number of legal moves, then each as coordinates
+    legal <move>    - true or false
+    san <move>      - the SAN of a legal move given as coordinates
+    coord <san>     - the coordinates of a legal move given as SAN
+    fen             - the FEN of the position after the moves
+ and each is answered with a line of "<id> ok <answer>" or "<id> error <reason>".
+
+ Requests are read in large chunks and cut at line ends into batches of about BatchBytes, which the worker
+ threads answer with a Position of their own, handing each batch's answers to the connection's writer in
+ one piece. Batches finish in any order, so answers can come back out of the order the requests were sent, and clients match
+ them by id. Pipelining many requests gives the best throughput; a lone request is still answered as soon
+ as its line is read. Only a few batches per thread are queued at once, and a connection's requests stop
+ being read while too many of its answers are waiting to be written, so a fast client is slowed to the
+ speed of the workers and a client which does not read its answers is slowed to nothing, rather than
+ either filling memory.
+ */
+class PositionService {
+private:
+    //One stream of requests, whose answers a writer thread of its own sends on, so that a client slow to
+    //read its answers holds up only its own requests rather than the workers
+    struct Connection {
+        int outputFd;
+        std::mutex lock;
+        std::condition_variable changed;
+        std::string unwritten;                  //Answers waiting for the writer
+        int pending = 0;                        //Batches read but not yet answered
+        bool finished = false;                  //Set once the input has ended and every batch is answered
+        bool failed = false;                    //Set once a write fails, after which answers are dropped
+    };
+    struct Batch {
+        std::shared_ptr<Connection> connection;
+        std::string requests;
+    };
+
+    int threadCount;
+    std::vector<std::thread> workers;
+    std::deque<Batch> queue;
+    std::mutex queueLock;
+    std::condition_variable queueChanged;
+    bool stopping = false;
+
+    std::atomic<uint64_t> requestCount{0};
+    std::atomic<uint64_t> errorCount{0};
+    std::atomic<uint64_t> batchCount{0};
+    std::chrono::steady_clock::time_point started;
+
+    //Socket clients still being served
+    int clients = 0;
+    std::mutex clientsLock;
+    std::condition_variable clientsDone;
+
+    void work();
+    //Queues a batch, waiting while the queue is full
+    void submit(Batch batch);
+    //Sends a connection's answers on as they are made, until it is finished
+    static void writeAnswers(Connection& connection);
+    //Reads requests from a descriptor until it ends, then waits for every answer to be written
+    void serve(int inputFd, int outputFd);
+
+public:
+
+    //The size batches are cut to
+    static const size_t BatchBytes = 16 * 1024;
+    //How much a connection may have waiting to be written before no more of its requests are read
+    static const size_t UnwrittenBytes = 1024 * 1024;
+
+    //threads - 0 uses every core
+    PositionService(int threads = 0);
+    ~PositionService();
+
+    int threads() const {
+        return threadCount;
+    }
+
+    //Answers one request line, without its line end, appending the answer and its line end to out
+    //Returns false if the answer is an error
+    static bool answer(const char* begin, const char* end, Position& pos, std::string& out);
+
+    //Serves requests from one descriptor and writes the answers to another, until the input ends
+    void serveStream(int inputFd, int outputFd);
+
+    //Listens on a Unix domain socket, serving each client as a stream on its own reader thread. Runs until
+    //the socket fails; returns false if it could not be created
+    bool serveSocket(const std::string& path);
+
+    //The totals since the service started
+    ServiceStats stats() const;
+};
+
+#endif
@@ -2,10 +2,16 @@
 #define RAFile_H
 
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
 #include <unistd.h>
+#include <string.h>
 #include <string>
 #include <vector>
 #include <fstream>
+#include <functional>
+#include <span>
+#include <algorithm>
 
 template <class T>
 class RAFile {
@@ -19,8 +25,59 @@ private:
     int length = 0;
     int byteOffset;
     
+    // The memory mapped mode, used instead of the fstream when mapped is true
+    bool mapped = false;
+    bool mappedWritable = false;
+    int descriptor = -1;
+    char* mapping = nullptr;
+    size_t mappedBytes = 0;                     // The size of the mapping, which may run past the last record
+    
+    // Records appended to the fstream but not yet written, kept as raw bytes so a flush is one write
+    std::vector<char> pending;
+    int flushedLength = 0;                      // The records already written, and counted by the header on disk
+    
+    // Asks the system to put everything written to the file so far on the disk
+    bool syncToDisk() {
+        int fd = ::open(fileName.c_str(), O_WRONLY);
+        if (fd < 0)
+            return false;
+        bool synced = fsync(fd) == 0;
+        ::close(fd);
+        return synced;
+    }
+    
+    // Maps the first bytes of the open descriptor, returning false if it could not be done
+    bool remap(size_t bytes) {
+        if (mapping != nullptr)
+            munmap(mapping, mappedBytes);
+        mapping = nullptr;
+        mappedBytes = 0;
+        if (bytes == 0)
+            return true;
+        void* m = mmap(nullptr, bytes, mappedWritable ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED, descriptor, 0);
+        if (m == MAP_FAILED)
+            return false;
+        mapping = static_cast<char*>(m);
+        mappedBytes = bytes;
+        return true;
+    }
+    
+    // Makes room for at least count records, doubling the file so that appends only rarely remap
+    bool reserveMapped(int count) {
+        size_t needed = intOffset + (size_t)count * sizeof(T);
+        if (needed <= mappedBytes)
+            return true;
+        size_t bytes = std::max(needed, mappedBytes * 2);
+        if (ftruncate(descriptor, (off_t)bytes) != 0)
+            return false;
+        return remap(bytes);
+    }
+    
 public:
     
+    // The most bytes of records held back before they are written out by themselves
+    static const size_t AppendBufferBytes = 64 * 1024;
+    
     //Constructor that sets the byteOffset
     RAFile() {
         byteOffset = sizeof(T);
@@ -37,12 +94,16 @@ public:
             return false;
         
         length = 0;
+        flushedLength = 0;
         initialized = true;
+        fileName = name;
         file = std::fstream(name, std::ios::in | std::ios::out | std::ios::trunc | std::ios::binary);
-        return !file.fail();
+        if (file.fail())
+            return false;
         
         file.seekp(0);
         file.write(reinterpret_cast<const char*>(&length), intOffset);
+        return !file.fail();
     }
     
     // Loads a file from memory, without truncating it
@@ -54,18 +115,122 @@ public:
         bool alreadyExists = (stat (name.c_str(), &buffer) == 0);
         
         initialized = true;
-        file.open(name, std::ios::in | std::ios::app | std::ios::binary);
+        fileName = name;
+        // Opened without app, which would send every write, the header included, to the end of the file
+        if (alreadyExists)
+            file.open(name, std::ios::in | std::ios::out | std::ios::binary);
+        else
+            file.open(name, std::ios::in | std::ios::out | std::ios::trunc | std::ios::binary);
         if (file.fail())
             return false;
         
         if (!alreadyExists) {
             length = 0;
+            file.write(reinterpret_cast<const char*>(&length), intOffset);
         } else {
             file.seekg(0);
             // We pull the integer stored at the beginning of the file, to the length
             file.read(reinterpret_cast<char*>(&length), RAFile::intOffset);
         }
+        flushedLength = length;
         
+        return !file.fail();
+    }
+    
+    /*
+     Opens a file by mapping it into memory, so records are read straight from the page cache with no
+     copying and no system call per record. A writable mapping creates the file if it does not exist, and
+     grows it by doubling as records are appended; closing trims it back to the records written.
+     name - the file to map
+     writable - whether records may be appended or overwritten
+     */
+    bool mapFile(std::string name, bool writable = false) {
+        if (initialized)    // A file is already open
+            return false;
+        
+        mappedWritable = writable;
+        descriptor = writable ? ::open(name.c_str(), O_RDWR | O_CREAT, 0644) : ::open(name.c_str(), O_RDONLY);
+        if (descriptor < 0)
+            return false;
+        
+        struct stat buffer;
+        bool valid = fstat(descriptor, &buffer) == 0;
+        if (valid && buffer.st_size == 0 && writable) {     // A new file, which starts with an empty header
+            buffer.st_size = intOffset;
+            valid = ftruncate(descriptor, intOffset) == 0;
+        }
+        valid = valid && buffer.st_size >= intOffset && remap((size_t)buffer.st_size);
+        
+        // The header must agree with the real size, so any other file is rejected
+        if (valid) {
+            memcpy(&length, mapping, intOffset);
+            valid = length >= 0 && (size_t)intOffset + (size_t)length * sizeof(T) <= mappedBytes;
+        }
+        if (!valid) {
+            remap(0);
+            ::close(descriptor);
+            descriptor = -1;
+            length = 0;
+            return false;
+        }
+        
+        fileName = name;
+        mapped = true;
+        initialized = true;
+        adviseSequential(true);
+        return true;
+    }
+    
+    // Tells the system how the mapped records will be read: sequentially, so it reads far ahead, or randomly
+    void adviseSequential(bool sequential) {
+        if (mapped && mapping != nullptr)
+            madvise(mapping, mappedBytes, sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+    }
+    
+    // The records of a mapped file, read in place. The view is invalidated by appending to the file
+    std::span<const T> entries() const {
+        static_assert(alignof(T) <= sizeof(int), "Records must be aligned by the header size to be viewed in place");
+        if (!mapped || mapping == nullptr)
+            return std::span<const T>();
+        return std::span<const T>(reinterpret_cast<const T*>(mapping + intOffset), length);
+    }
+    
+    // Returns true if the file was opened with mapFile
+    bool isMapped() const {
+        return mapped;
+    }
+    
+    /*
+     Commits every record appended since the last flush as one group: the records go out in a single
+     sequential write, and only after them the header with the new length, so a crash part way through
+     leaves a file whose header still counts only records that were fully written.
+     durable - waits for the records, and then the header, to reach the disk rather than the page cache
+     */
+    bool flush(bool durable = false) {
+        if (!initialized)
+            return false;
+        if (mapped) {
+            if (mappedWritable && mapping != nullptr)
+                return msync(mapping, mappedBytes, durable ? MS_SYNC : MS_ASYNC) == 0;
+            return true;
+        }
+        if (pending.empty())
+            return !file.fail();
+        
+        file.seekp(intOffset + (size_t)flushedLength * byteOffset);
+        file.write(pending.data(), pending.size());
+        file.flush();
+        if (file.fail() || (durable && !syncToDisk()))
+            return false;
+        
+        file.seekp(0);
+        file.write(reinterpret_cast<const char*>(&length), intOffset);
+        file.flush();
+        if (file.fail() || (durable && !syncToDisk()))
+            return false;
+        
+        pending.clear();
+        flushedLength = length;
         return true;
     }
     
@@ -74,23 +239,52 @@ public:
         if (!initialized)
             return false;
         
-        // Writes the length of the file to the file itself
-        file.seekp(0);
-        file.write(reinterpret_cast<const char*>(&length), RAFile::intOffset);
+        if (mapped) {
+            // Writes the length, and trims the room left for appends off the end of the file
+            if (mappedWritable) {
+                memcpy(mapping, &length, intOffset);
+                msync(mapping, mappedBytes, MS_SYNC);
+            }
+            remap(0);
+            if (mappedWritable) {
+                int trimmed = ftruncate(descriptor, (off_t)(intOffset + (size_t)length * sizeof(T)));
+                (void)trimmed;      // A file left untrimmed still reads correctly, as the header holds the length
+            }
+            ::close(descriptor);
+            descriptor = -1;
+            mapped = false;
+            length = 0;
+            initialized = false;
+            return true;
+        }
         
-        file.seekg(0);
-        file.read(reinterpret_cast<char*>(&length), RAFile::intOffset);
+        // Writes what is left of the records, and then the length of the file to the file itself
+        bool flushed = flush();
         
         length = 0;
+        flushedLength = 0;
+        pending.clear();
         file.close();
         initialized = false;
-        return true;
+        return flushed;
     }
     
-    // Gets the value at a given index (Works off of 0 -> size - 1
+    // Gets the value at a given index (Works off of 1 -> size)
     bool get(int index, T& ref) {
         if (!initialized)
             return false;
+        if (mapped) {
+            if (index < 1 || index > length)
+                return false;
+            memcpy(static_cast<void*>(&ref), mapping + intOffset + (size_t)(index - 1) * sizeof(T), sizeof(T));
+            return true;
+        }
+        if (index > flushedLength) {     // Still waiting in the append buffer
+            if (index > length)
+                return false;
+            memcpy(static_cast<void*>(&ref), pending.data() + (size_t)(index - flushedLength - 1) * sizeof(T), sizeof(T));
+            return true;
+        }
         file.seekg(intOffset + (index - 1) * sizeof(T), std::ios::beg);
         file.read(reinterpret_cast<char*>(&ref), sizeof(T));
         return true;
@@ -100,6 +294,18 @@ public:
     bool overwrite(int index, T element) {
         if (!initialized)
             return false;
+        if (mapped) {
+            if (!mappedWritable || index < 1 || index > length)
+                return false;
+            memcpy(mapping + intOffset + (size_t)(index - 1) * sizeof(T), &element, sizeof(T));
+            return true;
+        }
+        if (index > flushedLength) {     // Still waiting in the append buffer
+            if (index > length)
+                return false;
+            memcpy(pending.data() + (size_t)(index - flushedLength - 1) * sizeof(T), &element, sizeof(T));
+            return true;
+        }
         //We must take into account, the size at the beginning of the file
         file.seekp(intOffset + (index - 1) * byteOffset);
         file.write(reinterpret_cast<const char*>(&element), byteOffset);
@@ -110,30 +316,69 @@ public:
     bool append(T element) {
         if (!initialized)
             return false;
+        if (mapped) {
+            if (!mappedWritable || !reserveMapped(length + 1))
+                return false;
+            memcpy(mapping + intOffset + (size_t)length * sizeof(T), &element, sizeof(T));
+            length++;
+            memcpy(mapping, &length, intOffset);
+            return true;
+        }
         
-        file.seekp(intOffset + (length++ * byteOffset));
-        file.write(reinterpret_cast<const char*>(&element), byteOffset);
+        // Held back until the buffer fills or the file is flushed, so records go out in large writes
+        const char* bytes = reinterpret_cast<const char*>(&element);
+        pending.insert(pending.end(), bytes, bytes + byteOffset);
+        length++;
+        if (pending.size() >= AppendBufferBytes)
+            return flush();
         return true;
     }
     
     // Appenda a list of elements to the end of the file
-    bool append(std::vector<T> elements) {
+    bool append(const std::vector<T>& elements) {
         if (!initialized)
             return false;
+        if (mapped) {
+            for (auto it = elements.cbegin(); it != elements.cend(); it++)
+                if (!append(*it))
+                    return false;
+            return true;
+        }
         
-        for (auto it = elements.cbegin(); it != elements.cend(); it++)
-            append(*it);
+        const char* bytes = reinterpret_cast<const char*>(elements.data());
+        pending.insert(pending.end(), bytes, bytes + elements.size() * sizeof(T));
+        length += (int)elements.size();
+        if (pending.size() >= AppendBufferBytes)
+            return flush();
         return true;
     }
     
-    // Performs the function for every entry, until the function returns false
+    // Performs the function for every entry, in order, until the function returns false
     void forEveryEntry(std::function<bool(T input)> func) {
         if (!isOpen()) return;
-        for (int i = 0; i < length; i++)
-            if (!func(get(i))) return;
+        if (mapped) {
+            std::span<const T> view = entries();
+            for (auto it = view.begin(); it != view.end(); it++)
+                if (!func(*it)) return;
+            return;
+        }
+        T entry;
+        for (int i = 1; i <= length; i++)
+            if (!get(i, entry) || !func(entry)) return;
     }
 
     
+    // Reads every entry of a file at once by mapping it, without opening it for writing.
+    // Returns false if the file can not be read, or is shorter than its header claims
+    static bool readAll(std::string name, std::vector<T>& entries) {
+        RAFile<T> mappedFile;
+        if (!mappedFile.mapFile(name))
+            return false;
+        std::span<const T> view = mappedFile.entries();
+        entries.assign(view.begin(), view.end());
+        return true;
+    }
+
     // Returns true iff a file is open, and false otherwise
     bool isOpen() const {
         return initialized;
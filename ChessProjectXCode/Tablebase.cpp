@@ -0,0 +1,873 @@
+#include "Tablebase.h"
+#include <sys/stat.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <thread>
+
+static const char tablebaseMagic[8] = {'C', 'H', 'E', 'S', 'S', 'T', 'B', '1'};
+static const uint32_t tablebaseVersion = 1;
+static const int MaxPieces = Tablebases::MaxPieces;
+
+//Values a position can hold while its table is generated. Wins and losses are stored as in the file
+static const uint8_t Unsettled = 0;
+static const uint8_t SettledDraw = 254;
+static const uint8_t Invalid = 255;
+static const uint8_t LossBase = 128;
+//The longest distance to mate a value can hold, leaving 254 and 255 free
+static const int MaxPlies = 125;
+
+//The order pieces are written in a material, after the king
+static const std::string pieceLetters = "QRBNP";
+static const int pieceValues[5] = {9, 5, 3, 3, 1};
+
+//The pieces of one table, in the order their squares make up an index
+struct Layout {
+    std::string name;
+    int count = 0;
+    uint8_t pieces[MaxPieces];      //White's king, white's other pieces, black's king, then black's other pieces
+    bool pawns = false;
+    uint64_t perSide = 0;           //Positions with each side to move
+    uint64_t nodes = 0;
+};
+
+//Squares the symmetries of the board move each square to, and the a1-d1-d4 triangle the white king is kept in
+struct SquareTables {
+    int transform[8][64];
+    int triangleIndex[64];
+    int triangleSquare[10];
+    uint64_t knight[64];
+    uint64_t king[64];
+
+    SquareTables() {
+        int triangle = 0;
+        for (int sq = 0; sq < 64; sq++) {
+            int x = sq & 7, y = sq >> 3;
+            for (int t = 0; t < 8; t++) {
+                int tx = x, ty = y;
+                if (t & 4)
+                    std::swap(tx, ty);
+                if (t & 1)
+                    tx = 7 - tx;
+                if (t & 2)
+                    ty = 7 - ty;
+                transform[t][sq] = ty * 8 + tx;
+            }
+            triangleIndex[sq] = -1;
+            if (x <= 3 && y <= x) {
+                triangleIndex[sq] = triangle;
+                triangleSquare[triangle++] = sq;
+            }
+
+            knight[sq] = king[sq] = 0;
+            static const int knightSteps[8][2] = {{1, 2}, {2, 1}, {2, -1}, {1, -2}, {-1, -2}, {-2, -1}, {-2, 1}, {-1, 2}};
+            for (int i = 0; i < 8; i++) {
+                int nx = x + knightSteps[i][0], ny = y + knightSteps[i][1];
+                if (nx >= 0 && nx < 8 && ny >= 0 && ny < 8)
+                    knight[sq] |= (uint64_t)1 << (ny * 8 + nx);
+            }
+            for (int dx = -1; dx <= 1; dx++)
+                for (int dy = -1; dy <= 1; dy++)
+                    if ((dx != 0 || dy != 0) && x + dx >= 0 && x + dx < 8 && y + dy >= 0 && y + dy < 8)
+                        king[sq] |= (uint64_t)1 << ((y + dy) * 8 + x + dx);
+        }
+    }
+};
+
+static const SquareTables& squareTables() {
+    static const SquareTables tables;
+    return tables;
+}
+
+static uint64_t slide(int sq, uint64_t occupied, const int directions[][2], int directionCount) {
+    uint64_t attacks = 0;
+    for (int d = 0; d < directionCount; d++) {
+        int x = (sq & 7) + directions[d][0], y = (sq >> 3) + directions[d][1];
+        while (x >= 0 && x < 8 && y >= 0 && y < 8) {
+            attacks |= (uint64_t)1 << (y * 8 + x);
+            if (occupied & ((uint64_t)1 << (y * 8 + x)))
+                break;
+            x += directions[d][0];
+            y += directions[d][1];
+        }
+    }
+    return attacks;
+}
+
+//The squares a piece attacks, which for a pawn are only its captures
+static uint64_t attacksFrom(uint8_t piece, int sq, uint64_t occupied) {
+    static const int straight[4][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+    static const int diagonal[4][2] = {{1, 1}, {1, -1}, {-1, 1}, {-1, -1}};
+    switch (Position::typeOf(piece)) {
+        case PawnType: {
+            int x = sq & 7, y = (sq >> 3) + (Position::isWhitePiece(piece) ? 1 : -1);
+            uint64_t attacks = 0;
+            if (y >= 0 && y < 8) {
+                if (x > 0)
+                    attacks |= (uint64_t)1 << (y * 8 + x - 1);
+                if (x < 7)
+                    attacks |= (uint64_t)1 << (y * 8 + x + 1);
+            }
+            return attacks;
+        }
+        case KnightType: return squareTables().knight[sq];
+        case BishopType: return slide(sq, occupied, diagonal, 4);
+        case RookType: return slide(sq, occupied, straight, 4);
+        case QueenType: return slide(sq, occupied, diagonal, 4) | slide(sq, occupied, straight, 4);
+        case KingType: return squareTables().king[sq];
+    }
+    return 0;
+}
+
+/*
+ Reads a material such as KRKP into the order of a table. The pieces of each side are sorted queen first,
+ and the name is written back in that order.
+ */
+static bool parseMaterial(const std::string& text, Layout& layout) {
+    size_t second = text.find('K', 1);
+    if (text.empty() || text[0] != 'K' || second == std::string::npos)
+        return false;
+    std::string sides[2] = {text.substr(1, second - 1), text.substr(second + 1)};
+    if (sides[0].size() + sides[1].size() + 2 > (size_t)MaxPieces)
+        return false;
+
+    layout = Layout();
+    for (int side = 0; side < 2; side++) {
+        for (auto it = sides[side].begin(); it != sides[side].end(); it++)
+            if (pieceLetters.find(*it) == std::string::npos)
+                return false;
+        std::sort(sides[side].begin(), sides[side].end(), [](char a, char b) { return pieceLetters.find(a) < pieceLetters.find(b); });
+        layout.name += "K" + sides[side];
+        layout.pieces[layout.count++] = Position::makePiece(KingType, side == 0);
+        for (auto it = sides[side].begin(); it != sides[side].end(); it++) {
+            int type = (int)std::string(" PNBRQK").find(*it);
+            layout.pieces[layout.count++] = Position::makePiece(type, side == 0);
+            layout.pawns |= (type == PawnType);
+        }
+    }
+    layout.perSide = (uint64_t)(layout.pawns ? 32 : 10) << (6 * (layout.count - 1));
+    layout.nodes = layout.perSide * 2;
+    return true;
+}
+
+/*
+ Names the material of a set of pieces with the stronger side first, as its table is named.
+ flip - set if black holds the stronger side, so the colours must be swapped to look it up
+ */
+static std::string materialName(const uint8_t* pieces, int count, bool& flip) {
+    std::string sides[2];
+    int values[2] = {0, 0};
+    for (int i = 0; i < count; i++) {
+        int side = Position::isWhitePiece(pieces[i]) ? 0 : 1;
+        int type = Position::typeOf(pieces[i]);
+        if (type == KingType)
+            continue;
+        char letter = " PNBRQK"[type];
+        sides[side] += letter;
+        values[side] += pieceValues[pieceLetters.find(letter)];
+    }
+    for (int side = 0; side < 2; side++)
+        std::sort(sides[side].begin(), sides[side].end(), [](char a, char b) { return pieceLetters.find(a) < pieceLetters.find(b); });
+
+    //Ties go to the side whose pieces come first in the order letters are written, so each material has one name
+    auto rank = [](const std::string& s) {
+        std::string r;
+        for (auto it = s.begin(); it != s.end(); it++)
+            r += (char)('0' + pieceLetters.find(*it));
+        return r;
+    };
+    flip = values[1] > values[0] || (values[1] == values[0] && rank(sides[1]) < rank(sides[0]));
+    return flip ? "K" + sides[1] + "K" + sides[0] : "K" + sides[0] + "K" + sides[1];
+}
+
+//Materials with which neither side can mate, which need no table
+static bool insufficient(const std::string& name) {
+    std::string pieces;
+    for (auto it = name.begin(); it != name.end(); it++)
+        if (*it != 'K')
+            pieces += *it;
+    return pieces.empty() || pieces == "B" || pieces == "N";
+}
+
+/*
+ Moves the squares of a table's pieces to the one arrangement stored for all their symmetries. With pawns
+ the board can only be mirrored, which puts the white king on files a to d. Without, the king goes into the
+ a1-d1-d4 triangle, and when two symmetries both manage that the arrangement with the lowest squares is kept.
+ */
+static void canonicalize(int8_t* squares, int count, bool pawns) {
+    const SquareTables& tables = squareTables();
+    if (pawns) {
+        if ((squares[0] & 7) >= 4)
+            for (int i = 0; i < count; i++)
+                squares[i] ^= 7;
+        return;
+    }
+    int8_t best[MaxPieces];
+    bool found = false;
+    for (int t = 0; t < 8; t++) {
+        if (tables.triangleIndex[tables.transform[t][squares[0]]] < 0)
+            continue;
+        int8_t candidate[MaxPieces];
+        for (int i = 0; i < count; i++)
+            candidate[i] = (int8_t)tables.transform[t][squares[i]];
+        if (!found || std::lexicographical_compare(candidate, candidate + count, best, best + count)) {
+            memcpy(best, candidate, count);
+            found = true;
+        }
+    }
+    memcpy(squares, best, count);
+}
+
+//The index of an arrangement already made canonical
+static uint64_t indexOf(const Layout& layout, const int8_t* squares, bool whiteToMove) {
+    uint64_t index = layout.pawns ? (uint64_t)((squares[0] >> 3) * 4 + (squares[0] & 7)) : (uint64_t)squareTables().triangleIndex[squares[0]];
+    for (int i = 1; i < layout.count; i++)
+        index = (index << 6) | (uint64_t)squares[i];
+    return whiteToMove ? index : index + layout.perSide;
+}
+
+static void squaresOf(const Layout& layout, uint64_t index, int8_t* squares, bool& whiteToMove) {
+    whiteToMove = index < layout.perSide;
+    uint64_t rest = index % layout.perSide;
+    for (int i = layout.count - 1; i >= 1; i--) {
+        squares[i] = (int8_t)(rest & 63);
+        rest >>= 6;
+    }
+    squares[0] = (int8_t)(layout.pawns ? (rest / 4) * 8 + rest % 4 : (uint64_t)squareTables().triangleSquare[rest]);
+}
+
+//Whether the king of a side is attacked. Squares of -1 are pieces which have been captured
+static bool kingAttacked(const Layout& layout, const int8_t* squares, bool white) {
+    uint64_t occupied = 0;
+    int king = -1;
+    for (int i = 0; i < layout.count; i++) {
+        if (squares[i] < 0)
+            continue;
+        occupied |= (uint64_t)1 << squares[i];
+        if (layout.pieces[i] == Position::makePiece(KingType, white))
+            king = squares[i];
+    }
+    for (int i = 0; i < layout.count; i++)
+        if (squares[i] >= 0 && Position::isWhitePiece(layout.pieces[i]) != white &&
+            (attacksFrom(layout.pieces[i], squares[i], occupied) & ((uint64_t)1 << king)))
+            return true;
+    return false;
+}
+
+/*
+ Calls visit for each legal move of the side to move with the squares after it, the slot of the piece
+ captured or -1, and the piece a pawn promoted to or NoPiece.
+ */
+template <typename Visit>
+static void forEachMove(const Layout& layout, const int8_t* squares, bool whiteToMove, Visit visit) {
+    uint64_t occupied = 0, own = 0;
+    int slotAt[64];
+    std::fill(slotAt, slotAt + 64, -1);
+    for (int i = 0; i < layout.count; i++) {
+        occupied |= (uint64_t)1 << squares[i];
+        if (Position::isWhitePiece(layout.pieces[i]) == whiteToMove)
+            own |= (uint64_t)1 << squares[i];
+        slotAt[squares[i]] = i;
+    }
+
+    int8_t after[MaxPieces];
+    auto tryMove = [&](int slot, int to, int captured, uint8_t promotion) {
+        memcpy(after, squares, layout.count);
+        after[slot] = (int8_t)to;
+        if (captured >= 0)
+            after[captured] = -1;
+        if (!kingAttacked(layout, after, whiteToMove))
+            visit(after, captured, promotion);
+    };
+    auto tryPawnMove = [&](int slot, int to, int captured) {
+        if ((to >> 3) == (whiteToMove ? 7 : 0)) {
+            for (int type = QueenType; type >= KnightType; type--)
+                tryMove(slot, to, captured, Position::makePiece(type, whiteToMove));
+        } else {
+            tryMove(slot, to, captured, NoPiece);
+        }
+    };
+
+    for (int i = 0; i < layout.count; i++) {
+        uint8_t piece = layout.pieces[i];
+        if (Position::isWhitePiece(piece) != whiteToMove)
+            continue;
+        int from = squares[i];
+        uint64_t targets = attacksFrom(piece, from, occupied) & ~own;
+        if (Position::typeOf(piece) == PawnType) {
+            targets &= occupied;
+            int step = whiteToMove ? 8 : -8;
+            if (slotAt[from + step] < 0) {
+                tryPawnMove(i, from + step, -1);
+                if ((from >> 3) == (whiteToMove ? 1 : 6) && slotAt[from + 2 * step] < 0)
+                    tryMove(i, from + 2 * step, -1, NoPiece);
+            }
+        }
+        for (; targets != 0; targets &= targets - 1) {
+            int to = __builtin_ctzll(targets);
+            int captured = slotAt[to];
+            if (captured >= 0 && Position::typeOf(layout.pieces[captured]) == KingType)
+                continue;
+            if (Position::typeOf(piece) == PawnType)
+                tryPawnMove(i, to, captured);
+            else
+                tryMove(i, to, captured, NoPiece);
+        }
+    }
+}
+
+/*
+ Calls visit with the index of every position from which the side which just moved could have reached
+ this one without a capture or promotion.
+ */
+template <typename Visit>
+static void forEachPredecessor(const Layout& layout, const int8_t* squares, bool whiteToMove, Visit visit) {
+    bool moverWhite = !whiteToMove;
+    uint64_t occupied = 0;
+    for (int i = 0; i < layout.count; i++)
+        occupied |= (uint64_t)1 << squares[i];
+
+    int8_t before[MaxPieces];
+    auto tryFrom = [&](int slot, int from) {
+        memcpy(before, squares, layout.count);
+        before[slot] = (int8_t)from;
+        //The side now to move can not have been left in check by its own move
+        if (kingAttacked(layout, before, whiteToMove))
+            return;
+        canonicalize(before, layout.count, layout.pawns);
+        visit(indexOf(layout, before, moverWhite));
+    };
+
+    for (int i = 0; i < layout.count; i++) {
+        uint8_t piece = layout.pieces[i];
+        if (Position::isWhitePiece(piece) != moverWhite)
+            continue;
+        int sq = squares[i];
+        if (Position::typeOf(piece) == PawnType) {
+            int step = moverWhite ? -8 : 8;
+            int rank = sq >> 3;
+            if ((occupied & ((uint64_t)1 << (sq + step))) == 0) {
+                if (((sq + step) >> 3) != (moverWhite ? 0 : 7))
+                    tryFrom(i, sq + step);
+                if (rank == (moverWhite ? 3 : 4) && (occupied & ((uint64_t)1 << (sq + 2 * step))) == 0)
+                    tryFrom(i, sq + 2 * step);
+            }
+            continue;
+        }
+        for (uint64_t from = attacksFrom(piece, sq, occupied) & ~occupied; from != 0; from &= from - 1)
+            tryFrom(i, __builtin_ctzll(from));
+    }
+}
+
+/*
+ Finds the table and index of a set of pieces, swapping the colours if black holds the stronger side.
+ Returns false if the pieces are too many or do not fit a table.
+ */
+static bool locate(const uint8_t* pieces, const int8_t* squares, int count, bool whiteToMove, Layout& layout, uint64_t& index) {
+    bool flip;
+    std::string name = materialName(pieces, count, flip);
+    if (layout.name != name && !parseMaterial(name, layout))
+        return false;
+
+    //Places each piece in the first free slot of its kind
+    int8_t ordered[MaxPieces];
+    bool used[MaxPieces] = {false};
+    for (int slot = 0; slot < layout.count; slot++) {
+        int found = -1;
+        for (int i = 0; i < count && found < 0; i++) {
+            uint8_t piece = flip ? (uint8_t)(pieces[i] ^ 8) : pieces[i];
+            if (!used[i] && squares[i] >= 0 && piece == layout.pieces[slot])
+                found = i;
+        }
+        if (found < 0)
+            return false;
+        used[found] = true;
+        ordered[slot] = (int8_t)(flip ? squares[found] ^ 56 : squares[found]);
+    }
+    canonicalize(ordered, layout.count, layout.pawns);
+    index = indexOf(layout, ordered, flip ? !whiteToMove : whiteToMove);
+    return true;
+}
+
+static TablebaseResult resultOf(uint8_t value) {
+    TablebaseResult result;
+    if (value >= 1 && value < LossBase) {
+        result.outcome = 1;
+        result.plies = value;
+    } else if (value >= LossBase && value < SettledDraw) {
+        result.outcome = -1;
+        result.plies = value - LossBase;
+    }
+    return result;
+}
+
+//Runs work over [0, count) in chunks, on the given number of threads
+static void parallelFor(int threads, uint64_t count, const std::function<void(int thread, uint64_t begin, uint64_t end)>& work) {
+    const uint64_t chunk = 4096;
+    std::atomic<uint64_t> next(0);
+    auto worker = [&](int thread) {
+        uint64_t begin;
+        while ((begin = next.fetch_add(chunk)) < count)
+            work(thread, begin, std::min(count, begin + chunk));
+    };
+    std::vector<std::thread> pool;
+    for (int t = 0; t < threads; t++)
+        pool.push_back(std::thread(worker, t));
+    for (auto it = pool.begin(); it != pool.end(); it++)
+        it->join();
+}
+
+bool Tablebase::open(std::string fileName) {
+    close();
+
+    Header header;
+    //Probes land anywhere in the table, so read ahead would only bring in pages which are never used
+    bool valid = file.open(fileName) && file.size() >= HeaderBytes && file.read(&header, sizeof(header), 0) &&
+                 memcmp(header.magic, tablebaseMagic, sizeof(tablebaseMagic)) == 0 &&
+                 header.version == tablebaseVersion && header.blockValues == BlockValues &&
+                 header.blocks == (header.count + BlockValues - 1) / BlockValues &&
+                 (uint64_t)file.size() >= HeaderBytes + (header.blocks + 1) * sizeof(uint32_t) &&
+                 file.map(true);
+    if (valid) {
+        offsets = reinterpret_cast<const uint32_t*>(file.data() + HeaderBytes);
+        data = reinterpret_cast<const uint8_t*>(offsets + header.blocks + 1);
+        valid = (size_t)(reinterpret_cast<const char*>(data) - file.data()) + offsets[header.blocks] == file.size();
+    }
+    if (!valid) {
+        close();
+        return false;
+    }
+    count = header.count;
+    material = std::string(header.material, strnlen(header.material, sizeof(header.material)));
+    return true;
+}
+
+void Tablebase::close() {
+    file.close();
+    offsets = nullptr;
+    data = nullptr;
+    count = 0;
+    material.clear();
+}
+
+uint8_t Tablebase::value(uint64_t index) const {
+    if (index >= count)
+        return 0;
+    uint64_t block = index / BlockValues;
+    const uint8_t* run = data + offsets[block];
+    const uint8_t* end = data + offsets[block + 1];
+    uint32_t remaining = (uint32_t)(index % BlockValues);
+    for (; run < end; run += 2) {
+        uint32_t length = (uint32_t)run[0] + 1;
+        if (remaining < length)
+            return run[1];
+        remaining -= length;
+    }
+    return 0;
+}
+
+void Tablebase::readAll(std::vector<uint8_t>& values) const {
+    values.clear();
+    values.reserve((size_t)count);
+    const uint8_t* end = data + offsets[(count + BlockValues - 1) / BlockValues];
+    for (const uint8_t* run = data; run < end; run += 2)
+        values.insert(values.end(), (size_t)run[0] + 1, run[1]);
+    values.resize((size_t)count);
+}
+
+/*
+ Run length encodes each block on its own, as pairs of the run's length less one and its value.
+ fileName - the table file
+ material - the name of the material
+ values - every value of the table
+ longest - the most plies to mate, kept in the header
+ */
+bool Tablebase::write(const std::string& fileName, const std::string& material, const std::vector<uint8_t>& values, int longest) {
+    //The name goes in the header with its terminator
+    if (material.size() >= sizeof(Header::material))
+        return false;
+    uint64_t blocks = (values.size() + BlockValues - 1) / BlockValues;
+    std::vector<uint32_t> blockOffsets;
+    std::vector<uint8_t> runs;
+    for (uint64_t b = 0; b < blocks; b++) {
+        blockOffsets.push_back((uint32_t)runs.size());
+        size_t end = std::min(values.size(), (size_t)(b + 1) * BlockValues);
+        for (size_t i = (size_t)b * BlockValues; i < end; ) {
+            size_t length = 1;
+            while (i + length < end && length < 256 && values[i + length] == values[i])
+                length++;
+            runs.push_back((uint8_t)(length - 1));
+            runs.push_back(values[i]);
+            i += length;
+        }
+    }
+    blockOffsets.push_back((uint32_t)runs.size());
+
+    Header header = {};
+    memcpy(header.magic, tablebaseMagic, sizeof(tablebaseMagic));
+    header.version = tablebaseVersion;
+    header.blockValues = BlockValues;
+    header.count = values.size();
+    header.blocks = blocks;
+    memcpy(header.material, material.data(), material.size());
+    header.material[material.size()] = '\0';
+    header.longest = (uint32_t)longest;
+    char headerBytes[HeaderBytes] = {};
+    memcpy(headerBytes, &header, sizeof(header));
+
+    std::string temporary = fileName + ".new";
+    std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+    out.write(headerBytes, sizeof(headerBytes));
+    out.write(reinterpret_cast<const char*>(blockOffsets.data()), blockOffsets.size() * sizeof(uint32_t));
+    out.write(reinterpret_cast<const char*>(runs.data()), runs.size());
+    out.close();
+    if (out.fail() || rename(temporary.c_str(), fileName.c_str()) != 0) {
+        remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
+Tablebases::Tablebases(std::string directory) : directory(directory) { }
+
+const Tablebase* Tablebases::table(const std::string& material) {
+    std::lock_guard<std::mutex> guard(lock);
+    auto found = tables.find(material);
+    if (found == tables.end()) {
+        std::unique_ptr<Tablebase> opened(new Tablebase());
+        if (!opened->open(directory + "/" + material + ".tb"))
+            opened.reset();
+        found = tables.emplace(material, std::move(opened)).first;
+    }
+    return found->second.get();
+}
+
+bool Tablebases::probe(const Position& pos, TablebaseResult& result) {
+    if (pos.getCastling() != 0)
+        return false;
+    uint8_t pieces[MaxPieces];
+    int8_t squares[MaxPieces];
+    int count = 0;
+    for (int sq = 0; sq < 64; sq++) {
+        if (pos.at(sq) == NoPiece)
+            continue;
+        if (count == MaxPieces)
+            return false;
+        pieces[count] = pos.at(sq);
+        squares[count++] = (int8_t)sq;
+    }
+    //The tables do not know about en passant, so positions where it can be taken are left alone
+    int lane = pos.getEpLane();
+    if (lane >= 0) {
+        int y = pos.isWhiteToMove() ? 4 : 3;
+        uint8_t pawn = pos.isWhiteToMove() ? WhitePawn : BlackPawn;
+        if ((lane > 0 && pos.at(lane - 1, y) == pawn) || (lane < 7 && pos.at(lane + 1, y) == pawn))
+            return false;
+    }
+
+    Layout layout;
+    uint64_t index;
+    if (!locate(pieces, squares, count, pos.isWhiteToMove(), layout, index))
+        return false;
+    if (insufficient(layout.name)) {
+        result = TablebaseResult();
+        return true;
+    }
+    const Tablebase* found = table(layout.name);
+    if (found == nullptr || found->size() != layout.nodes)
+        return false;
+    result = resultOf(found->value(index));
+    return true;
+}
+
+std::string Tablebases::describe(const TablebaseResult& result, bool whiteToMove) {
+    if (result.outcome == 0)
+        return "Draw";
+    bool whiteWins = (result.outcome > 0) == whiteToMove;
+    int moves = (result.plies + 1) / 2;
+    if (result.plies == 0)
+        return whiteWins ? "White has mated" : "Black has mated";
+    return std::string(whiteWins ? "White" : "Black") + " mates in " + std::to_string(moves);
+}
+
+/*
+ Generates a table by retrograde analysis, after the tables its captures and promotions lead to.
+ material - the pieces, such as KRKP
+ threads - the threads to use, or 0 for every core
+ log - where progress is written, if anywhere
+ */
+bool Tablebases::generate(std::string material, int threads, std::ostream* log) {
+    if (threads <= 0)
+        threads = std::max(1, (int)std::thread::hardware_concurrency());
+    Layout layout;
+    if (!parseMaterial(material, layout)) {
+        if (log != nullptr)
+            *log << material << " is not a material of at most " << MaxPieces << " pieces, such as KRKP" << std::endl;
+        return false;
+    }
+    bool flip;
+    if (!parseMaterial(materialName(layout.pieces, layout.count, flip), layout))
+        return false;
+    if (insufficient(layout.name) || table(layout.name) != nullptr)
+        return true;
+
+    //Every material one capture or promotion away needs its table first
+    std::vector<std::string> dependencies;
+    for (int captured = -1; captured < layout.count; captured++) {
+        if (captured >= 0 && Position::typeOf(layout.pieces[captured]) == KingType)
+            continue;
+        std::vector<uint8_t> after;
+        for (int i = 0; i < layout.count; i++)
+            if (i != captured)
+                after.push_back(layout.pieces[i]);
+        if (captured >= 0)
+            dependencies.push_back(materialName(after.data(), (int)after.size(), flip));
+
+        //A pawn of the other side promoting, by taking the captured piece or by moving forward
+        for (size_t p = 0; p < after.size(); p++) {
+            if (Position::typeOf(after[p]) != PawnType ||
+                (captured >= 0 && Position::isWhitePiece(after[p]) == Position::isWhitePiece(layout.pieces[captured])))
+                continue;
+            for (int promotion = KnightType; promotion <= QueenType; promotion++) {
+                std::vector<uint8_t> promoted = after;
+                promoted[p] = Position::makePiece(promotion, Position::isWhitePiece(after[p]));
+                dependencies.push_back(materialName(promoted.data(), (int)promoted.size(), flip));
+            }
+        }
+    }
+    std::sort(dependencies.begin(), dependencies.end());
+    dependencies.erase(std::unique(dependencies.begin(), dependencies.end()), dependencies.end());
+
+    std::map<std::string, std::vector<uint8_t>> loaded;
+    for (auto it = dependencies.begin(); it != dependencies.end(); it++) {
+        if (insufficient(*it))
+            continue;
+        if (table(*it) == nullptr && !generate(*it, threads, log))
+            return false;
+        const Tablebase* dependency = table(*it);
+        if (dependency == nullptr)
+            return false;
+        dependency->readAll(loaded[*it]);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    if (log != nullptr)
+        *log << "Generating " << layout.name << ", " << layout.nodes << " positions" << std::endl;
+
+    //The result for the side to move of a position in another table
+    auto probeOther = [&](const int8_t* after, int captured, uint8_t promotion, bool whiteToMove) {
+        uint8_t pieces[MaxPieces];
+        int8_t squares[MaxPieces];
+        int count = 0;
+        for (int i = 0; i < layout.count; i++) {
+            if (i == captured)
+                continue;
+            pieces[count] = layout.pieces[i];
+            if (promotion != NoPiece && Position::typeOf(layout.pieces[i]) == PawnType && after[i] >= 0 &&
+                (after[i] >> 3) == (Position::isWhitePiece(promotion) ? 7 : 0))
+                pieces[count] = promotion;
+            squares[count++] = after[i];
+        }
+        thread_local Layout other;
+        uint64_t index;
+        if (!locate(pieces, squares, count, whiteToMove, other, index) || insufficient(other.name))
+            return TablebaseResult();
+        return resultOf(loaded.at(other.name)[(size_t)index]);
+    };
+
+    std::vector<uint8_t> values((size_t)layout.nodes, Unsettled);
+    //For each position, the best the captures and promotions do for the side to move: a win in that many plies,
+    //SettledDraw if one draws, LossBase plus the longest loss if all lose, and Unsettled if there are none
+    std::vector<uint8_t> external((size_t)layout.nodes, Unsettled);
+    std::vector<std::vector<uint32_t>> buckets(MaxPlies + 2);
+    std::vector<std::vector<std::pair<int, uint32_t>>> found(threads);
+    std::atomic<bool> overflow(false);
+
+    parallelFor(threads, layout.nodes, [&](int thread, uint64_t begin, uint64_t end) {
+        int8_t squares[MaxPieces], check[MaxPieces];
+        bool whiteToMove;
+        for (uint64_t index = begin; index < end; index++) {
+            squaresOf(layout, index, squares, whiteToMove);
+            uint64_t occupied = 0;
+            bool valid = true;
+            for (int i = 0; i < layout.count && valid; i++) {
+                valid = (occupied & ((uint64_t)1 << squares[i])) == 0 &&
+                        (Position::typeOf(layout.pieces[i]) != PawnType || ((squares[i] >> 3) != 0 && (squares[i] >> 3) != 7));
+                occupied |= (uint64_t)1 << squares[i];
+            }
+            memcpy(check, squares, layout.count);
+            canonicalize(check, layout.count, layout.pawns);
+            if (!valid || memcmp(check, squares, layout.count) != 0 || kingAttacked(layout, squares, !whiteToMove)) {
+                values[(size_t)index] = Invalid;
+                continue;
+            }
+
+            int moves = 0, internal = 0, bestWin = MaxPlies + 1, longestLoss = -1;
+            bool draw = false;
+            forEachMove(layout, squares, whiteToMove, [&](const int8_t* after, int captured, uint8_t promotion) {
+                moves++;
+                if (captured < 0 && promotion == NoPiece) {
+                    internal++;
+                    return;
+                }
+                TablebaseResult r = probeOther(after, captured, promotion, !whiteToMove);
+                if (r.outcome < 0)
+                    bestWin = std::min(bestWin, r.plies + 1);
+                else if (r.outcome == 0)
+                    draw = true;
+                else
+                    longestLoss = std::max(longestLoss, r.plies + 1);
+            });
+
+            if (moves == 0) {
+                if (kingAttacked(layout, squares, whiteToMove))
+                    found[thread].push_back(std::make_pair(0, (uint32_t)index));
+                else
+                    values[(size_t)index] = SettledDraw;
+            } else if (bestWin <= MaxPlies) {
+                external[(size_t)index] = (uint8_t)bestWin;
+                found[thread].push_back(std::make_pair(bestWin, (uint32_t)index));
+            } else if (draw) {
+                external[(size_t)index] = SettledDraw;
+            } else if (longestLoss >= 0) {
+                if (longestLoss > MaxPlies)
+                    overflow = true;
+                external[(size_t)index] = (uint8_t)(LossBase + std::min(longestLoss, MaxPlies));
+                if (internal == 0)
+                    found[thread].push_back(std::make_pair(longestLoss, (uint32_t)index));
+            }
+        }
+    });
+    auto gather = [&]() {
+        for (auto list = found.begin(); list != found.end(); list++) {
+            for (auto it = list->begin(); it != list->end(); it++) {
+                if (it->first > MaxPlies)
+                    overflow = true;
+                else
+                    buckets[it->first].push_back(it->second);
+            }
+            list->clear();
+        }
+    };
+    gather();
+
+    //Settles the positions one distance at a time, each settled position raising those which lead to it
+    std::vector<std::vector<uint32_t>> raised(threads);
+    int longest = 0;
+    for (int plies = 0; plies <= MaxPlies && !overflow; plies++) {
+        std::vector<uint32_t>& bucket = buckets[plies];
+        std::sort(bucket.begin(), bucket.end());
+        bucket.erase(std::unique(bucket.begin(), bucket.end()), bucket.end());
+        std::vector<uint32_t> settled;
+        for (auto it = bucket.begin(); it != bucket.end(); it++) {
+            if (values[*it] != Unsettled)
+                continue;
+            values[*it] = (plies % 2 == 0) ? (uint8_t)(LossBase + plies) : (uint8_t)plies;
+            settled.push_back(*it);
+        }
+        bucket = std::vector<uint32_t>();
+        if (!settled.empty())
+            longest = plies;
+
+        //Positions leading to a loss are won a ply later, and those leading to a win may now be lost
+        parallelFor(threads, settled.size(), [&](int thread, uint64_t begin, uint64_t end) {
+            int8_t squares[MaxPieces];
+            bool whiteToMove;
+            for (uint64_t i = begin; i < end; i++) {
+                squaresOf(layout, settled[i], squares, whiteToMove);
+                forEachPredecessor(layout, squares, whiteToMove, [&](uint64_t previous) {
+                    if (values[(size_t)previous] == Unsettled)
+                        raised[thread].push_back((uint32_t)previous);
+                });
+            }
+        });
+        std::vector<uint32_t> candidates;
+        for (auto list = raised.begin(); list != raised.end(); list++) {
+            candidates.insert(candidates.end(), list->begin(), list->end());
+            *list = std::vector<uint32_t>();
+        }
+        std::sort(candidates.begin(), candidates.end());
+        candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+        if (plies % 2 == 0) {
+            buckets[plies + 1].insert(buckets[plies + 1].end(), candidates.begin(), candidates.end());
+            continue;
+        }
+
+        parallelFor(threads, candidates.size(), [&](int thread, uint64_t begin, uint64_t end) {
+            int8_t squares[MaxPieces];
+            bool whiteToMove;
+            for (uint64_t i = begin; i < end; i++) {
+                uint32_t index = candidates[i];
+                uint8_t best = external[index];
+                if ((best >= 1 && best < LossBase) || best == SettledDraw)
+                    continue;
+                //Lost only once every move leads to a win for the other side, as late as the slowest of them
+                int lost = (best >= LossBase) ? best - LossBase : 0;
+                bool escapes = false;
+                squaresOf(layout, index, squares, whiteToMove);
+                forEachMove(layout, squares, whiteToMove, [&](const int8_t* after, int captured, uint8_t promotion) {
+                    if (escapes || captured >= 0 || promotion != NoPiece)
+                        return;
+                    int8_t child[MaxPieces];
+                    memcpy(child, after, layout.count);
+                    canonicalize(child, layout.count, layout.pawns);
+                    uint8_t v = values[(size_t)indexOf(layout, child, !whiteToMove)];
+                    if (v >= 1 && v < LossBase)
+                        lost = std::max(lost, v + 1);
+                    else
+                        escapes = true;
+                });
+                if (!escapes)
+                    found[thread].push_back(std::make_pair(lost, index));
+            }
+        });
+        gather();
+    }
+    if (overflow) {
+        if (log != nullptr)
+            *log << layout.name << " has mates longer than " << MaxPlies << " plies, which a table can not hold" << std::endl;
+        return false;
+    }
+
+    //Unsettled positions are draws, and invalid ones copy their neighbour so the runs stay long
+    uint64_t wins = 0, losses = 0, draws = 0;
+    uint8_t previous = 0;
+    for (size_t i = 0; i < values.size(); i++) {
+        uint8_t& v = values[i];
+        if (v == Invalid)
+            v = previous;
+        else if (v == Unsettled || v == SettledDraw)
+            v = 0, draws++;
+        else if (v < LossBase)
+            wins++;
+        else
+            losses++;
+        previous = v;
+    }
+
+    mkdir(directory.c_str(), 0755);
+    if (!Tablebase::write(directory + "/" + layout.name + ".tb", layout.name, values, longest)) {
+        if (log != nullptr)
+            *log << "The table " << layout.name << " could not be written to " << directory << std::endl;
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        tables.erase(layout.name);
+    }
+    if (log != nullptr) {
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        *log << layout.name << ": " << wins << " wins, " << losses << " losses, " << draws << " draws, longest mate "
+             << longest << " plies, in " << seconds << " seconds" << std::endl;
+    }
+    return true;
+}
+
+Tablebases* Tablebases::defaultTablebases() {
+    static Tablebases tablebases;
+    return &tablebases;
+}
@@ -0,0 +1,124 @@
+#ifndef Tablebase_H
+#define Tablebase_H
+
+#include "Position.h"
+#include "MappedFile.h"
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+//The exact result of an endgame position for the side to move
+struct TablebaseResult {
+    int outcome = 0;            //1 if the side to move wins, -1 if it loses, 0 for a draw
+    int plies = 0;              //Plies until mate with best play, 0 for a draw
+};
+
+/*
+ One table of distance to mate values for a set of material, such as KRK, as a read only memory mapped file.
+ A value is one byte for each position with the strong side white: 0 a draw, 1 to 127 a win for the side
+ to move in that many plies, and 128 plus the plies for a loss. Positions are only stored once for each
+ symmetry of the board: the white king is kept in the a1-d1-d4 triangle, or on files a to d when there
+ are pawns.
+ The values are cut into blocks of BlockValues, each run length encoded, after a table of where each block
+ starts, so a probe decodes a single block and nothing is read when the table is opened.
+ */
+class Tablebase {
+private:
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t blockValues;
+        uint64_t count;
+        uint64_t blocks;
+        char material[8];
+        uint32_t longest;       //The most plies to mate in the table
+    };
+
+    MappedFile file;
+    const uint32_t* offsets = nullptr;
+    const uint8_t* data = nullptr;
+    uint64_t count = 0;
+    std::string material;
+
+public:
+
+    static const size_t HeaderBytes = 64;
+    static const int BlockValues = 4096;
+
+    Tablebase() { }
+    ~Tablebase() {
+        close();
+    }
+
+    //Maps a table, returning false if it is missing or not a table
+    bool open(std::string fileName);
+    void close();
+
+    bool isOpen() const {
+        return file.isMapped();
+    }
+    uint64_t size() const {
+        return count;
+    }
+    const std::string& getMaterial() const {
+        return material;
+    }
+
+    //The value stored for an index
+    uint8_t value(uint64_t index) const;
+
+    //Decodes the whole table, for generating the tables which play into it
+    void readAll(std::vector<uint8_t>& values) const;
+
+    //Compresses values into a table file, written to a temporary name and renamed into place
+    static bool write(const std::string& fileName, const std::string& material, const std::vector<uint8_t>& values, int longest);
+};
+
+/*
+ The tables in a directory, each named by its material such as KBNK.tb, mapped the first time a position
+ needs one. Positions where black holds the stronger material are looked up with the colours swapped.
+
+ generate builds a table by retrograde analysis, first building any table a capture or promotion can reach.
+ Every position is visited once on all threads to find mates, stalemates and the results of captures and
+ promotions into smaller tables. Then, one ply at a time, the positions lost in n plies make every position
+ which can move to them a win in n + 1, and a position whose moves all reach positions won for the other
+ side becomes a loss, until nothing changes. Positions never settled are draws.
+ Castling is not possible in a table, and en passant is ignored, so tables with pawns on both sides are
+ correct except where an en passant capture would change the result.
+ */
+class Tablebases {
+private:
+    std::string directory;
+    std::mutex lock;
+    std::map<std::string, std::unique_ptr<Tablebase>> tables;     //nullptr for tables looked for and not found
+
+    //The table for a material, mapping it if it has not been yet
+    const Tablebase* table(const std::string& material);
+
+public:
+
+    //The most pieces a table may have, kings included
+    static const int MaxPieces = 5;
+
+    Tablebases(std::string directory = "tablebases");
+
+    //Looks up a position, returning false if there is no table for its material, or it can still castle
+    bool probe(const Position& pos, TablebaseResult& result);
+
+    //Builds the table for a material written as white's pieces then black's, such as KRKP, along with the
+    //tables it depends on. Tables already built are kept. Progress is written to log if it is given
+    //threads - 0 uses every core
+    bool generate(std::string material, int threads = 0, std::ostream* log = nullptr);
+
+    //Describes a result from white's side, such as "White mates in 7" or "Draw"
+    static std::string describe(const TablebaseResult& result, bool whiteToMove);
+
+    //The tables in the tablebases directory
+    static Tablebases* defaultTablebases();
+};
+
+#endif
@@ -0,0 +1,109 @@
+#include "TerminalRenderer.h"
+#include <sstream>
+#include <ctype.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+//The rows of the board: the top border, eight ranks and the file labels
+static const int BoardRows = 10;
+
+TerminalRenderer::TerminalRenderer(int reservedRows, std::ostream& output) : output(output), reservedRows(reservedRows) { }
+
+void TerminalRenderer::moveTo(int row, int column) {
+    frame += "\033[" + std::to_string(row) + ";" + std::to_string(column) + "H";
+}
+
+void TerminalRenderer::writeLine(int row, const std::string& line) {
+    moveTo(row, 1);
+    frame += line;
+    frame += "\033[K";
+}
+
+std::vector<std::string> TerminalRenderer::splitLines(const std::string& text) {
+    std::vector<std::string> lines;
+    std::istringstream in(text);
+    std::string line;
+    while (std::getline(in, line))
+        lines.push_back(line);
+    return lines;
+}
+
+int TerminalRenderer::terminalRows() {
+    struct winsize size;
+    if (!isatty(STDOUT_FILENO) || ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) != 0)
+        return 0;
+    return size.ws_row;
+}
+
+/*
+ Builds the frame and writes it all at once.
+ board - the board to draw
+ whitesPerspective - whether white's side is at the bottom
+ header - the lines above the board
+ footer - the lines below the board
+ */
+void TerminalRenderer::render(ChessBoard& board, bool whitesPerspective, const std::string& header, const std::string& footer) {
+    std::vector<std::string> newHeader = splitLines(header);
+    std::vector<std::string> newFooter = splitLines(footer);
+    int boardRow = (int)newHeader.size() + 1;
+    int footerRow = boardRow + BoardRows;
+    int screenRows = terminalRows();
+    bool full = !drawn || whitesPerspective != this->whitesPerspective || newHeader.size() != headerLines.size() ||
+                (screenRows > 0 && footerRow + (int)newFooter.size() + reservedRows > screenRows);
+
+    frame.clear();
+    if (full) {
+        //Clears the screen and draws the whole board as ChessBoard prints it, so only the text is left to draw
+        std::ostringstream whole;
+        board.print(whitesPerspective, whole);
+        frame += "\033[H\033[2J";
+        moveTo(boardRow, 1);
+        frame += whole.str();
+        headerLines.clear();
+        footerLines.clear();
+    }
+
+    for (size_t i = 0; i < newHeader.size(); i++)
+        if (i >= headerLines.size() || newHeader[i] != headerLines[i])
+            writeLine((int)i + 1, newHeader[i]);
+
+    for (int row = 0; row < 8; row++) {
+        for (int column = 0; column < 8; column++) {
+            int x = whitesPerspective ? column : 7 - column;
+            int y = whitesPerspective ? 7 - row : row;
+            Piece* p = board.at(x, y);
+            bool occupied = p != nullptr && p->isActive();
+            char cell = occupied ? (p->isWhite() ? p->getIdentifier() : (char)tolower(p->getIdentifier())) : ' ';
+            if (!full && cells[row * 8 + column] == cell)
+                continue;
+            cells[row * 8 + column] = cell;
+            if (full)
+                continue;
+            moveTo(boardRow + 1 + row, 3 + column * 2);
+            frame += ((x + y) % 2 == 0) ? ChessBoard::darkSquareColor : ChessBoard::lightSquareColor;
+            if (occupied) {
+                frame += p->isWhite() ? ChessBoard::whiteColor : ChessBoard::blackColor;
+                frame += p->getIdentifier();
+                frame += ' ';
+            } else {
+                frame += "  ";
+            }
+            frame += ChessBoard::resetColor;
+        }
+    }
+
+    for (size_t i = 0; i < newFooter.size(); i++)
+        if (i >= footerLines.size() || newFooter[i] != footerLines[i])
+            writeLine(footerRow + (int)i, newFooter[i]);
+
+    //Clears what was written under the last frame, and leaves the cursor where the caller carries on writing
+    moveTo(footerRow + (int)newFooter.size(), 1);
+    frame += "\033[J";
+    output.write(frame.data(), frame.size());
+    output.flush();
+
+    drawn = true;
+    this->whitesPerspective = whitesPerspective;
+    headerLines.swap(newHeader);
+    footerLines.swap(newFooter);
+}
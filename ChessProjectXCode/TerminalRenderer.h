@@ -0,0 +1,53 @@
+#ifndef TerminalRenderer_H
+#define TerminalRenderer_H
+
+#include "ChessBoard.h"
+#include <iostream>
+#include <string>
+#include <vector>
+
+/*
+ Draws the board with lines of text above and below it as one frame, built up in a single buffer and
+ written with one write and one flush.
+ The first frame clears the screen and draws everything from the top left. Later frames move the cursor to
+ just the squares and lines which changed since the last frame and redraw those, then clear whatever was
+ written below the frame since, such as a prompt and its answer. A frame is drawn in full again when the
+ board is turned around, the lines above it change in number, or the frame and the rows kept for input
+ would not fit on the terminal, as the screen would then scroll away from where the last frame was drawn.
+ */
+class TerminalRenderer {
+private:
+    std::ostream& output;
+    int reservedRows;                   //Rows left free below the frame for prompts and input
+    bool drawn = false;                 //Whether the screen holds a frame which can be updated
+    bool whitesPerspective = true;
+    char cells[64];                     //What each square on screen shows, top left first: the identifier, lower case for black, or ' '
+    std::vector<std::string> headerLines;
+    std::vector<std::string> footerLines;
+    std::string frame;
+
+    //Adds the escape sequence which moves the cursor to a row and column, both counted from 1
+    void moveTo(int row, int column);
+    //Adds a line of text at a row, clearing what was left of the old line after it
+    void writeLine(int row, const std::string& line);
+
+    static std::vector<std::string> splitLines(const std::string& text);
+
+    //The rows of the terminal, or 0 if the output is not a terminal
+    static int terminalRows();
+
+public:
+
+    TerminalRenderer(int reservedRows = 4, std::ostream& output = std::cout);
+
+    //Draws the header lines, the board from one side, then the footer lines, changing only what differs
+    //from the last frame. The cursor is left at the start of the row below the frame.
+    void render(ChessBoard& board, bool whitesPerspective, const std::string& header, const std::string& footer);
+
+    //Makes the next frame draw in full, for when something else has been drawn over the screen
+    void invalidate() {
+        drawn = false;
+    }
+};
+
+#endif
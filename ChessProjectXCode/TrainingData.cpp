@@ -0,0 +1,213 @@
+#include "TrainingData.h"
+#include "Evaluation.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <algorithm>
+
+static_assert(sizeof(PackedPosition) == 32, "Packed positions must stay 32 bytes");
+
+static const char trainingMagic[8] = {'C', 'H', 'E', 'S', 'S', 'T', 'P', '1'};
+static const uint32_t trainingVersion = 1;
+
+struct TrainingHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t recordSize;
+    uint64_t count;
+    uint64_t unused;
+};
+static_assert(sizeof(TrainingHeader) == sizeof(PackedPosition), "The header takes the place of one record, keeping records aligned");
+
+bool PackedPosition::pack(const Position& pos, int score, GameResult result, int ply) {
+    PackedPosition& p = *this;
+    memset(&p, 0, sizeof(p));
+    int n = 0;
+    for (int sq = 0; sq < 64; sq++) {
+        uint8_t piece = pos.at(sq);
+        if (piece == NoPiece)
+            continue;
+        //The nibbles only have room for 32 pieces
+        if (n == 32)
+            return false;
+        p.occupancy |= (uint64_t)1 << sq;
+        p.pieces[n / 2] |= (uint8_t)(piece << ((n & 1) * 4));
+        n++;
+    }
+    p.score = (int16_t)std::max(-32767, std::min(32767, score));
+    p.state = (uint8_t)((pos.isWhiteToMove() ? 1 : 0) | (pos.getCastling() << 1));
+    p.epLane = (int8_t)pos.getEpLane();
+    p.result = result;
+    p.halfmoveClock = (uint8_t)std::min(255, pos.getHalfmoveClock());
+    p.ply = (uint16_t)std::min(65535, ply);
+    return true;
+}
+
+void PackedPosition::unpackSquares(uint8_t squares[64]) const {
+    int n = 0;
+    for (int sq = 0; sq < 64; sq++) {
+        if (occupancy & ((uint64_t)1 << sq)) {
+            squares[sq] = (pieces[n / 2] >> ((n & 1) * 4)) & 15;
+            n++;
+        } else {
+            squares[sq] = NoPiece;
+        }
+    }
+}
+
+bool PackedPosition::unpack(Position& pos) const {
+    //More than 32 occupied squares can not be described by the nibbles
+    if (__builtin_popcountll(occupancy) > 32)
+        return false;
+    uint8_t squares[64];
+    unpackSquares(squares);
+    return pos.setFromSquares(squares, (state & 1) != 0, (state >> 1) & 15, epLane, halfmoveClock);
+}
+
+bool TrainingWriter::open(std::string fileName) {
+    close();
+    fd = ::open(fileName.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return false;
+    written = 0;
+    buffer.reserve(BufferRecords);
+    buffer.clear();
+    //The header goes in straight away, so an empty file is still a valid one
+    if (!flush()) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+/*
+ Writes the buffered positions after those already written, and only then the header counting them
+ */
+bool TrainingWriter::flush() {
+    if (fd < 0)
+        return false;
+    if (!buffer.empty()) {
+        uint64_t offset = sizeof(TrainingHeader) + written * sizeof(PackedPosition);
+        if (!MappedFile::writeAll(fd, reinterpret_cast<const char*>(buffer.data()), buffer.size() * sizeof(PackedPosition), offset))
+            return false;
+        written += buffer.size();
+        buffer.clear();
+    }
+
+    TrainingHeader header = {};
+    memcpy(header.magic, trainingMagic, sizeof(trainingMagic));
+    header.version = trainingVersion;
+    header.recordSize = sizeof(PackedPosition);
+    header.count = written;
+    return MappedFile::writeAll(fd, reinterpret_cast<const char*>(&header), sizeof(header), 0);
+}
+
+bool TrainingWriter::close() {
+    if (fd < 0)
+        return false;
+    bool flushed = flush();
+    ::close(fd);
+    fd = -1;
+    return flushed;
+}
+
+bool TrainingWriter::write(const PackedPosition& position) {
+    if (fd < 0)
+        return false;
+    buffer.push_back(position);
+    if (buffer.size() >= BufferRecords)
+        return flush();
+    return true;
+}
+
+/*
+ Replays each game in the database, writing the position before every ply and the final position
+ storage - the games
+ */
+uint64_t TrainingWriter::addGames(const GameStorage& storage) {
+    uint64_t added = 0;
+    storage.forEachGame([&](int id, const std::vector<Move>& moves) {
+        GameResult result = storage.info(id).result;
+        Position pos;
+        pos.reset();
+        for (size_t ply = 0; ; ply++) {
+            PackedPosition packed;
+            if (packed.pack(pos, Evaluation::evaluate(pos), result, (int)ply)) {
+                if (!write(packed))
+                    return false;
+                added++;
+            }
+            if (ply == moves.size() || !pos.applyStoredMove(moves[ply]))
+                break;
+        }
+        return true;
+    });
+    return added;
+}
+
+bool TrainingReader::open(std::string fileName) {
+    close();
+
+    TrainingHeader header;
+    bool valid = file.open(fileName) && file.read(&header, sizeof(header), 0) &&
+                 memcmp(header.magic, trainingMagic, sizeof(trainingMagic)) == 0 &&
+                 header.version == trainingVersion && header.recordSize == sizeof(PackedPosition) &&
+                 (uint64_t)file.size() >= sizeof(header) + header.count * sizeof(PackedPosition);
+    if (!valid || !file.map(false)) {
+        close();
+        return false;
+    }
+
+    records = reinterpret_cast<const PackedPosition*>(file.data() + sizeof(TrainingHeader));
+    count = header.count;
+    startEpoch(0);
+    return true;
+}
+
+void TrainingReader::close() {
+    file.close();
+    records = nullptr;
+    count = 0;
+    blockOrder.clear();
+    window.clear();
+    nextBlock = 0;
+    windowPosition = 0;
+}
+
+void TrainingReader::startEpoch(uint64_t seed) {
+    random.seed(seed);
+    uint64_t blocks = (count + BlockRecords - 1) / BlockRecords;
+    blockOrder.resize((size_t)blocks);
+    for (uint64_t b = 0; b < blocks; b++)
+        blockOrder[(size_t)b] = b;
+    std::shuffle(blockOrder.begin(), blockOrder.end(), random);
+    nextBlock = 0;
+    window.clear();
+    windowPosition = 0;
+}
+
+size_t TrainingReader::nextBatch(PackedPosition* batch, size_t batchSize) {
+    size_t filled = 0;
+    while (filled < batchSize) {
+        if (windowPosition == window.size()) {
+            //Takes in the next blocks of the epoch, and mixes their positions together
+            if (nextBlock == blockOrder.size())
+                break;
+            window.clear();
+            windowPosition = 0;
+            for (int b = 0; b < WindowBlocks && nextBlock < blockOrder.size(); b++, nextBlock++) {
+                uint64_t first = blockOrder[nextBlock] * BlockRecords;
+                uint64_t last = std::min(count, first + BlockRecords);
+                for (uint64_t i = first; i < last; i++)
+                    window.push_back(i);
+            }
+            std::shuffle(window.begin(), window.end(), random);
+        }
+        size_t take = std::min(batchSize - filled, window.size() - windowPosition);
+        for (size_t i = 0; i < take; i++)
+            batch[filled + i] = records[window[windowPosition + i]];
+        filled += take;
+        windowPosition += take;
+    }
+    return filled;
+}
@@ -0,0 +1,132 @@
+#ifndef TrainingData_H
+#define TrainingData_H
+
+#include "Position.h"
+#include "GameStorage.h"
+#include "MappedFile.h"
+#include <random>
+#include <span>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+/*
+ A position for training in 32 bytes. The occupied squares are a bitboard, and the piece on each one, in
+ square order, is a PieceCode in four bits; no position has more than 32 pieces, so 16 bytes hold them all.
+ */
+struct PackedPosition {
+    uint64_t occupancy;         //One bit per occupied square, A1 the lowest
+    uint8_t pieces[16];         //The pieces of the occupied squares in order, the first in the low four bits
+    int16_t score;              //Centipawns from white's side
+    uint8_t state;              //Bit 0 set when white is to move, bits 1-4 the castling rights
+    int8_t epLane;              //As Position::getEpLane, -1 when there is none
+    uint8_t result;             //The GameResult of the game the position came from
+    uint8_t halfmoveClock;      //Capped at 255
+    uint16_t ply;               //Plies played in the game before the position
+
+    //Packs a position with its score, the game's result and how far into the game it was, returning false
+    //if it has more than 32 pieces
+    bool pack(const Position& pos, int score, GameResult result, int ply);
+
+    //The piece on each square, NoPiece where it is empty
+    void unpackSquares(uint8_t squares[64]) const;
+
+    //Sets up the position, returning false if the record does not hold one
+    bool unpack(Position& pos) const;
+};
+
+/*
+ Writes packed positions to a training file: a 32 byte header then the records. Records are gathered
+ into a buffer and written in large blocks, and the count in the header is only updated after the
+ records it counts are written, so a file cut short by a crash still reads as the positions before it.
+ */
+class TrainingWriter {
+private:
+    int fd = -1;
+    std::vector<PackedPosition> buffer;
+    uint64_t written = 0;
+
+public:
+
+    //Positions held back before they are written out together
+    static const size_t BufferRecords = 1 << 15;
+
+    TrainingWriter() { }
+    ~TrainingWriter() {
+        close();
+    }
+
+    //Creates the file, replacing any file already there
+    bool open(std::string fileName);
+    //Writes everything buffered, and then the new count
+    bool flush();
+    bool close();
+
+    bool isOpen() const {
+        return fd >= 0;
+    }
+
+    bool write(const PackedPosition& position);
+
+    //Adds every position of every game in the database, scored by the static evaluation. Returns the number added
+    uint64_t addGames(const GameStorage& storage);
+
+    //The number of positions written or waiting in the buffer
+    uint64_t size() const {
+        return written + buffer.size();
+    }
+};
+
+/*
+ Reads a training file by mapping it, either in order through entries() or in shuffled batches.
+ A shuffled epoch visits the file in blocks of BlockRecords in a random order, and draws batches at random
+ from a window of WindowBlocks blocks at a time, so every position is seen once per epoch in a well mixed
+ order while the reads stay in large runs of neighbouring pages.
+ */
+class TrainingReader {
+private:
+    MappedFile file;
+    const PackedPosition* records = nullptr;
+    uint64_t count = 0;
+
+    std::mt19937_64 random;
+    std::vector<uint64_t> blockOrder;
+    size_t nextBlock = 0;
+    std::vector<uint64_t> window;       //Positions of the current window not yet handed out, shuffled
+    size_t windowPosition = 0;
+
+public:
+
+    static const int BlockRecords = 4096;
+    static const int WindowBlocks = 16;
+
+    TrainingReader() { }
+    ~TrainingReader() {
+        close();
+    }
+
+    //Maps a training file, returning false if it is missing or not a training file
+    bool open(std::string fileName);
+    void close();
+
+    bool isOpen() const {
+        return file.isMapped();
+    }
+
+    uint64_t size() const {
+        return count;
+    }
+
+    //Every position in the file, read in place
+    std::span<const PackedPosition> entries() const {
+        return std::span<const PackedPosition>(records, (size_t)count);
+    }
+
+    //Starts a new pass over the file in an order decided by the seed
+    void startEpoch(uint64_t seed);
+
+    //Copies up to batchSize positions of the epoch into batch, returning how many, or 0 once the epoch is over
+    size_t nextBatch(PackedPosition* batch, size_t batchSize);
+};
+
+#endif
@@ -0,0 +1,70 @@
+#include "TranspositionTable.h"
+
+//Layout of the data word: move in bits 0-15, score in 16-31, depth in 32-39, bound in 40-41, generation in 42-47
+uint64_t TranspositionTable::pack(CompactMove move, int score, int depth, Bound bound, uint8_t generation) {
+    return (uint64_t)move.data |
+           ((uint64_t)(uint16_t)(int16_t)score << 16) |
+           ((uint64_t)(uint8_t)depth << 32) |
+           ((uint64_t)bound << 40) |
+           ((uint64_t)generation << 42);
+}
+
+TranspositionTable::TranspositionTable(size_t megabytes) {
+    size_t count = 1;
+    while (count * 2 * sizeof(Slot) <= megabytes * 1024 * 1024)
+        count *= 2;
+    slots = std::vector<Slot>(count);
+    mask = count - 1;
+    clear();
+}
+
+void TranspositionTable::clear() {
+    for (auto it = slots.begin(); it != slots.end(); it++) {
+        it->check.store(0, std::memory_order_relaxed);
+        it->data.store(0, std::memory_order_relaxed);
+    }
+    generation = 0;
+}
+
+bool TranspositionTable::probe(uint64_t key, TTEntry& entry) const {
+    const Slot& slot = slots[key & mask];
+    uint64_t data = slot.data.load(std::memory_order_relaxed);
+    uint64_t check = slot.check.load(std::memory_order_relaxed);
+    if ((check ^ data) != key || data == 0)
+        return false;
+
+    entry.move.data = (uint16_t)(data & 0xFFFF);
+    entry.score = (int16_t)((data >> 16) & 0xFFFF);
+    entry.depth = (int)((data >> 32) & 0xFF);
+    entry.bound = (Bound)((data >> 40) & 3);
+    return true;
+}
+
+void TranspositionTable::store(uint64_t key, CompactMove move, int score, int depth, Bound bound) {
+    Slot& slot = slots[key & mask];
+    uint64_t old = slot.data.load(std::memory_order_relaxed);
+    bool sameKey = (slot.check.load(std::memory_order_relaxed) ^ old) == key;
+    int oldDepth = (int)((old >> 32) & 0xFF);
+    uint8_t oldGeneration = (uint8_t)((old >> 42) & 63);
+
+    if (old != 0 && oldGeneration == generation && !sameKey && depth < oldDepth)
+        return;
+
+    //Keep the old best move when the new result did not find one
+    if (move.isNull() && sameKey)
+        move.data = (uint16_t)(old & 0xFFFF);
+
+    uint64_t data = pack(move, score, depth < 0 ? 0 : depth, bound, generation);
+    slot.check.store(key ^ data, std::memory_order_relaxed);
+    slot.data.store(data, std::memory_order_relaxed);
+}
+
+int TranspositionTable::hashfull() const {
+    int used = 0;
+    for (size_t i = 0; i < 1000 && i < slots.size(); i++) {
+        uint64_t data = slots[i].data.load(std::memory_order_relaxed);
+        if (data != 0 && (uint8_t)((data >> 42) & 63) == generation)
+            used++;
+    }
+    return used;
+}
@@ -0,0 +1,66 @@
+#ifndef TranspositionTable_H
+#define TranspositionTable_H
+
+#include "Position.h"
+#include <atomic>
+#include <stdint.h>
+#include <vector>
+
+//How a stored score relates to the true score of the position
+enum Bound : uint8_t {
+    NoBound = 0,
+    UpperBound,     //The true score is at most the stored score
+    LowerBound,     //The true score is at least the stored score
+    ExactBound
+};
+
+//What a probe of the table found
+struct TTEntry {
+    CompactMove move;
+    int score;
+    int depth;
+    Bound bound;
+};
+
+/*
+ A hash table of search results shared by every search thread without locks.
+ Each slot is two 64 bit words, the key xored with the data and the data itself. A slot torn by
+ two threads writing at once no longer matches its key, so it is simply treated as a miss.
+ */
+class TranspositionTable {
+private:
+    struct Slot {
+        std::atomic<uint64_t> check;
+        std::atomic<uint64_t> data;
+    };
+
+    std::vector<Slot> slots;
+    uint64_t mask = 0;
+    uint8_t generation = 0;
+
+    static uint64_t pack(CompactMove move, int score, int depth, Bound bound, uint8_t generation);
+
+public:
+
+    //Allocates a table of roughly the given size, rounded down to a power of two slots
+    TranspositionTable(size_t megabytes = 64);
+
+    //Empties the table, for a new game
+    void clear();
+
+    //Marks entries from earlier searches as older than anything written from now on
+    void newSearch() {
+        generation = (uint8_t)((generation + 1) & 63);
+    }
+
+    //Looks up a position, returning true if it was found
+    bool probe(uint64_t key, TTEntry& entry) const;
+
+    //Stores a result, replacing the slot if the new result is deeper or the old one is from an earlier search
+    void store(uint64_t key, CompactMove move, int score, int depth, Bound bound);
+
+    //Fraction of slots, out of a thousand sampled, which hold a result from the current search
+    int hashfull() const;
+};
+
+#endif
@@ -3,15 +3,29 @@
 #include "GameManager.h"
 #include "AnalysisManager.h"
 #include "RAFile.h"
+#include "WeightTuner.h"
+#include "MateSolver.h"
+#include "BatchAnalyzer.h"
+#include "GameStorage.h"
+#include "PositionIndex.h"
+#include "OpeningExplorer.h"
+#include "PgnImporter.h"
+#include "PgnExporter.h"
+#include <sys/stat.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
 
 #include <vector>
 #include <iostream>
+#include <fstream>
+#include <chrono>
 
 #define BLINKINGTEXT "\033[5m"
 #define RESETTEXT "\033[0m"
 
 
-int UIManager::maxChoice = 4;
+int UIManager::maxChoice = 10;
 
 /*
     The function which displays the menu to the user on the primary text output.
@@ -41,9 +55,15 @@ void UIManager::menu() {
 void UIManager::displayOptions() {
     std::cout << "Chooose from one of the options below." << std::endl;
     std::cout << "(1) Play a game of Chess against another player" << std::endl;
-    std::cout << "(2) Load a game of Chess from a file" << std::endl;
-    std::cout << "(3) Convert a game to a text file" << std::endl;
-    std::cout << "(4) Exit" << std::endl;
+    std::cout << "(2) Play a game of Chess against the computer" << std::endl;
+    std::cout << "(3) Load a game of Chess from a file" << std::endl;
+    std::cout << "(4) Convert a game to a text file" << std::endl;
+    std::cout << "(5) Tune evaluation weights from saved games" << std::endl;
+    std::cout << "(6) Solve mate puzzles from a file" << std::endl;
+    std::cout << "(7) Analyse the saved games of a directory or the game database" << std::endl;
+    std::cout << "(8) Find saved games which reached a position" << std::endl;
+    std::cout << "(9) Build the opening explorer from saved games" << std::endl;
+    std::cout << "(10) Exit" << std::endl;
 }
 
 /*
@@ -63,8 +83,31 @@ bool UIManager::getOption(int& i) {
  */
 void UIManager::processOption( int i ) {
     switch (i) {
-        case 1: {   // Play a game
+        case 1:     // Play a game
+        case 2: {   // Play a game against the computer
             GameManager gm;
+            if (i == 2) {
+                char c;
+                std::cout << "Would you like to play as white? (y/n)" << std::endl;
+                std::cin >> c;
+                
+                char kind;
+                std::cout << "Should the computer search with (a)lpha-beta or (m)onte carlo tree search?" << std::endl;
+                std::cin >> kind;
+                bool useMonteCarlo = (kind == 'm' || kind == 'M');
+                
+                SearchLimits limits;
+                std::cout << "Enter the time the computer may think per move in milliseconds, or 0 to limit it by nodes instead" << std::endl;
+                std::cin >> limits.timeMs;
+                if (limits.timeMs <= 0) {
+                    limits.timeMs = 0;
+                    std::cout << "Enter the number of " << (useMonteCarlo ? "playouts" : "nodes") << " the computer may search per move" << std::endl;
+                    std::cin >> limits.nodes;
+                }
+                std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+                
+                gm.setComputerPlayer(c != 'y' && c != 'Y', limits, useMonteCarlo);
+            }
             std::vector<Move> game = gm.play();
             
             // Saves the game if the user requests it
@@ -76,27 +119,48 @@ void UIManager::processOption( int i ) {
             }
             break;
         }
-        case 2: {   // Open a file for analysis
-            std::cout << "Enter the path and file name you would like to open. (if it is in the default location,you need only enter the name of the file" << std::endl;
-            std::string path = chooseFile();
-            AnalysisManager am(path);
-            am.play();
+        case 3: {   // Open a game for analysis
+            std::cout << "Enter the name of the saved game you would like to open. Games saved to their own file can be opened by entering the path of the file." << std::endl;
+            std::string name = chooseFile();
+            
+            // Games in the database are found by name, and anything else is taken to be a game file
+            std::vector<Move> game;
+            if (loadSavedGame(name, game)) {
+                AnalysisManager am(game);
+                am.play();
+            } else {
+                AnalysisManager am(name);
+                if (!am) {
+                    std::cout << "There is no saved game called " << name << ". Please try again." << std::endl;
+                    std::cin.get();
+                    break;
+                }
+                am.play();
+            }
             break;
         }
-        case 3: {   // Converting a game to a text file
-            std::cout << "Enter the path for the game you would like to convert. Enter just the name, if it is in the default directory." << std::endl;
+        case 4: {   // Converting a game to a text file
+            std::cout << "Enter the name of the saved game you would like to convert. Games saved to their own file can be converted by entering the path of the file." << std::endl;
             std::string path = chooseFile();
             std::cout << "Enter the directory you would like to save the file to. Enter default for default directory." << std::endl;
             std::string saveDir = chooseFile();
             if (saveDir == "default")
                 saveDir = "";
-            RAFile<Move> file;
-            file.loadFile(path);
-            if (!file.isOpen()) {
-                std::cout << "There was an error opening the file. Try again." << std::endl;
-            }
             
-            bool success = globalFunctions::createGameFile(file, path);
+            // A game from the database is written to the directory under its name, as it has no file of its own
+            bool success;
+            std::vector<Move> game;
+            if (loadSavedGame(path, game)) {
+                success = globalFunctions::createGameFile(game, saveDir.empty() ? path : saveDir + "/" + path);
+            } else {
+                RAFile<Move> file;
+                file.mapFile(path);
+                if (!file.isOpen()) {
+                    std::cout << "There was an error opening the file. Try again." << std::endl;
+                }
+                
+                success = globalFunctions::createGameFile(file, path);
+            }
             
             if (!success) {
                 std::cout << "There was an error in creating the text file. Please try again." << std::endl;
@@ -104,8 +168,112 @@ void UIManager::processOption( int i ) {
             
             break;
         }
-        case 4: {   // Exit
-            exit(0);    //Games are automatically saved when GameStorage is deleted, so no worries
+        case 5: {   // Tuning the evaluation weights
+            std::cout << "Enter the directory holding the saved games to tune from. Enter database for the game database, or default for the default directory." << std::endl;
+            std::string dir = chooseFile();
+            if (dir == "default")
+                dir = "";
+            GameStorage* storage = (dir == "database") ? GameStorage::defaultStorage() : nullptr;
+            if (dir == "database" && storage == nullptr) {
+                std::cout << "The game database could not be opened." << std::endl;
+                std::cin.get();
+                break;
+            }
+            std::cout << "Enter the number of passes to make over the positions" << std::endl;
+            int epochs;
+            std::cin >> epochs;
+            std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+            
+            WeightTuner tuner;
+            int games = (storage != nullptr) ? tuner.loadGames(*storage) : tuner.loadGames(globalFunctions::listFiles(dir));
+            std::cout << "Loaded " << tuner.size() << " positions from " << games << " games." << std::endl;
+            if (tuner.size() == 0 || epochs < 1)
+                break;
+            
+            EvalWeights weights = tuner.tune(Evaluation::defaultWeights(), epochs, 16384, 1.0, std::cout);
+            if (weights.save("weights.txt"))
+                std::cout << "The tuned weights were saved to weights.txt, and will be used from the next run." << std::endl;
+            else
+                std::cout << "There was an error saving the weights. Please try again." << std::endl;
+            std::cin.get();
+            break;
+        }
+        case 6: {   // Solving a file of mate puzzles
+            std::cout << "Enter the path of the puzzle file. Each line holds a FEN, optionally followed by ';' and the number of moves to mate in." << std::endl;
+            std::string path = chooseFile();
+            int moves;
+            uint64_t nodes;
+            std::cout << "Enter the number of moves to look for a mate in, for lines which do not give one" << std::endl;
+            std::cin >> moves;
+            std::cout << "Enter the most nodes to search per puzzle, or 0 for no limit" << std::endl;
+            std::cin >> nodes;
+            std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+            
+            MateSolver::solveFile(path, moves, nodes, std::cout);
+            std::cin.get();
+            break;
+        }
+        case 7: {   // Analysing many games at once
+            std::cout << "Enter the directory holding the saved games to analyse. Enter database for the game database, or default for the default directory." << std::endl;
+            std::string dir = chooseFile();
+            if (dir == "default")
+                dir = "";
+            GameStorage* storage = (dir == "database") ? GameStorage::defaultStorage() : nullptr;
+            if (dir == "database" && storage == nullptr) {
+                std::cout << "The game database could not be opened." << std::endl;
+                std::cin.get();
+                break;
+            }
+            std::cout << "Enter the file to write the analysis to" << std::endl;
+            std::string outputName = chooseFile();
+            std::cout << "Enter the depth to search each position to, or 0 for the static evaluation" << std::endl;
+            int depth;
+            std::cin >> depth;
+            std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+            
+            std::ofstream output(outputName);
+            if (!output.is_open()) {
+                std::cout << "The file " << outputName << " could not be created. Please try again." << std::endl;
+                std::cin.get();
+                break;
+            }
+            BatchAnalyzer analyzer(0, depth, AnalysisCache::defaultCache());
+            BatchStats stats = (storage != nullptr) ? analyzer.run(*storage, output) : analyzer.run(globalFunctions::listFiles(dir), output);
+            std::cout << "Analysed " << stats.games << " games (" << stats.failed << " could not be read, "
+                      << stats.cacheHits << " positions already cached) in " << stats.seconds
+                      << " seconds: " << stats.gamesPerSecond() << " games/sec, " << stats.pliesPerSecond() << " plies/sec" << std::endl;
+            std::cin.get();
+            break;
+        }
+        case 8: {   // Searching the saved games for a position
+            findPosition();
+            std::cin.get();
+            break;
+        }
+        case 9: {   // Counting the openings of the saved games
+            GameStorage* storage = GameStorage::defaultStorage();
+            if (storage == nullptr) {
+                std::cout << "The game database could not be opened." << std::endl;
+                std::cin.get();
+                break;
+            }
+            std::cout << "Enter the number of plies of each game to count" << std::endl;
+            int plies;
+            std::cin >> plies;
+            std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+            
+            auto start = std::chrono::steady_clock::now();
+            if (plies > 0 && OpeningExplorer::rebuildDefault(*storage, plies))
+                std::cout << "Counted the openings of " << storage->size() << " games in "
+                          << std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count()
+                          << " seconds. They are shown while analysing a game." << std::endl;
+            else
+                std::cout << "The opening explorer could not be built. Please try again." << std::endl;
+            std::cin.get();
+            break;
+        }
+        case 10: {  // Exit
+            exit(0);    //Games are committed to the database as they are saved, so no worries
             break;
         }
         default: {
@@ -114,6 +282,60 @@ void UIManager::processOption( int i ) {
     }
 }
 
+/*
+ Looks a position up in the index of the default game database, building the index first if it is
+ missing or older than the database, and lists the games which reached it.
+ */
+void UIManager::findPosition() {
+    GameStorage* storage = GameStorage::defaultStorage();
+    if (storage == nullptr) {
+        std::cout << "The game database could not be opened." << std::endl;
+        return;
+    }
+    
+    PositionIndex index;
+    if (!index.open("positions.index") || index.gameCount() != (uint64_t)storage->size()) {
+        std::cout << "Indexing " << storage->size() << " saved games..." << std::endl;
+        auto start = std::chrono::steady_clock::now();
+        index.close();
+        if (!PositionIndex::build(*storage, "positions.index") || !index.open("positions.index")) {
+            std::cout << "The position index could not be built." << std::endl;
+            return;
+        }
+        std::cout << "Indexed " << index.size() << " positions in "
+                  << std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() << " seconds." << std::endl;
+    }
+    
+    std::cout << "Enter the position as a FEN, or start for the starting position" << std::endl;
+    std::string fen = chooseFile();
+    Position pos;
+    pos.reset();
+    if (fen != "start" && !pos.setFromFen(fen)) {
+        std::cout << "That is not a valid FEN." << std::endl;
+        return;
+    }
+    
+    auto start = std::chrono::steady_clock::now();
+    uint64_t total = index.occurrences(pos.key());
+    std::vector<PositionHit> hits = index.lookup(pos.key(), 20);
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    
+    const char* results[4] = {"*", "1-0", "0-1", "1/2-1/2"};
+    std::cout << "Reached " << total << " times (found in " << ms << " ms)" << std::endl;
+    for (auto it = hits.begin(); it != hits.end(); it++) {
+        GameInfo info = storage->info((int)it->game);
+        std::cout << info.name << " at ply " << it->ply << " of " << info.plies << ", " << results[info.result] << std::endl;
+    }
+    if (total > hits.size())
+        std::cout << "and " << total - hits.size() << " more" << std::endl;
+}
+
+bool UIManager::loadSavedGame(const std::string& name, std::vector<Move>& game) {
+    GameStorage* storage = GameStorage::defaultStorage();
+    int id = (storage != nullptr) ? storage->findGame(name) : -1;
+    return id >= 0 && storage->loadGame(id, game);
+}
+
 /*
  Prompts the user for a line of text, and then inputs it
  */
@@ -124,35 +346,31 @@ std::string UIManager::chooseFile() {
 }
 
 /*
- Goes through the process of saving the game.
- NOTE: Might want to move this functionality to a different class, but for now it is fine.
+ Goes through the process of saving the game, into the default game database or one the user names.
  */
 void UIManager::saveGame(std::string name, std::vector<Move> game) {
     char c;
-    std::cout << RESETTEXT << "Would you like to save in the default location? (y/n)" << std::endl;
+    std::cout << RESETTEXT << "Would you like to save to the default game database? (y/n)" << std::endl;
     std::cin >> c;
     std::cin.ignore();
-    std::string path = name;
-    if (c != 'y' && c != 'Y') { // Different location
-        std::cout << "Enter the path to the location you would like to save the file to" << std::endl;
+    
+    //Finds the database, opening the one the user names if it is not the default
+    GameStorage other;
+    GameStorage* storage = GameStorage::defaultStorage();
+    std::string path = "games.db";
+    if (c != 'y' && c != 'Y') { // Different database
+        std::cout << "Enter the path of the game database you would like to save to. It is created if it does not exist." << std::endl;
         path = chooseFile();
-        path.append("/");
-        path.append(name);
+        storage = other.open(path) ? &other : nullptr;
     }
-    
-    //Makes the file
-    RAFile<Move> file;
-    file.newfile(path);
-    if (!file.isOpen()) {
-        std::cerr << "File to save game could not be created" << std::endl;
+    if (storage == nullptr || !storage->isWritable()) {
+        std::cerr << "The game database " << path << " could not be written to" << std::endl;
         return;
     }
     
-    //Fills the file
-    for (auto it = game.begin(); it != game.end(); it++) {
-        file.append(*it);
-    }
-
+    //Adds the game, committing it to the disk straight away
+    if (storage->addGame(name, game, GameStorage::resultOf(game)) < 0 || !storage->commit(true))
+        std::cerr << "The game could not be written to " << path << std::endl;
 }
 
 
@@ -162,3 +380,266 @@ void UIManager::saveGame(std::string name, std::vector<Move> game) {
 
 
 
+
+/*
+ Splits a command into words at spaces, keeping text in double quotes together as one word
+ */
+static std::vector<std::string> splitCommand(const std::string& line) {
+    std::vector<std::string> words;
+    std::string word;
+    bool quoted = false, inWord = false;
+    for (auto it = line.begin(); it != line.end(); it++) {
+        if (*it == '"') {
+            quoted = !quoted;
+            inWord = true;
+        } else if (!quoted && isspace((unsigned char)*it)) {
+            if (inWord)
+                words.push_back(word);
+            word.clear();
+            inWord = false;
+        } else {
+            word += *it;
+            inWord = true;
+        }
+    }
+    if (inWord)
+        words.push_back(word);
+    return words;
+}
+
+//Quotes a value written in an answer if it holds spaces, so the answer splits back into the same words
+static std::string quote(const std::string& value) {
+    return (value.find(' ') == std::string::npos && !value.empty()) ? value : '"' + value + '"';
+}
+
+/*
+ Reads word i of a command as a whole number, leaving value as it is when the command is shorter
+ error - set to what was wrong if the word is not a number
+ */
+static bool numberWord(const std::vector<std::string>& words, size_t i, int& value, std::string& error) {
+    if (i >= words.size())
+        return true;
+    const char* text = words[i].c_str();
+    char* end;
+    errno = 0;
+    long n = strtol(text, &end, 10);
+    if (end == text || *end != '\0' || errno == ERANGE || n < INT_MIN || n > INT_MAX) {
+        error = "argument=" + quote(words[i]) + " not a number";
+        return false;
+    }
+    value = (int)n;
+    return true;
+}
+
+GameStorage* UIManager::database(const std::string& path) {
+    auto found = databases.find(path);
+    if (found != databases.end())
+        return found->second.get();
+    std::unique_ptr<GameStorage> storage(new GameStorage());
+    if (!storage->open(path))
+        return nullptr;
+    return databases.emplace(path, std::move(storage)).first->second.get();
+}
+
+bool UIManager::commitDatabases() {
+    bool committed = true;
+    for (auto it = databases.begin(); it != databases.end(); it++)
+        if (it->second->isWritable())
+            committed &= it->second->commit(true);
+    return committed;
+}
+
+/*
+ Runs commands for scripts and bulk work, with nothing written but the answers. Blank lines and lines
+ starting with # are skipped, and words holding spaces are put in double quotes. The commands are
+    play <moves>                                    - plays moves in SAN or as coordinates, such as Nf3 or g1f3, from the start
+    save <database> <name>                          - saves the game the last play made
+    convert <game file> [text file]                 - writes the moves of a saved game file as text
+    analyze <depth> <game files>                    - analyses saved game files, one JSON line each as BatchAnalyzer writes them
+    import <file.pgn> <database> [threads]          - adds the games of a PGN file to a database
+    export <database or directory> <file.pgn> [threads] - writes games as PGN
+    quit                                            - stops reading commands
+ Each command answers with "ok", its name and key=value pairs, or with "error", the line number, the command
+ and why it failed. Games saved are committed before an export or import reads the database, and at the end.
+ play refuses promotions to anything but a queen, as a saved game can not hold them.
+ input - the commands
+ output - where the answers are written
+ */
+int UIManager::runCommands(std::istream& input, std::ostream& output) {
+    std::string line;
+    int lineNumber = 0;
+    int failed = 0;
+    while (std::getline(input, line)) {
+        lineNumber++;
+        std::vector<std::string> words = splitCommand(line);
+        if (words.empty() || words[0][0] == '#')
+            continue;
+        if (words[0] == "quit")
+            break;
+        std::string error;
+        if (!runCommand(words, output, error)) {
+            output << "error " << lineNumber << ' ' << words[0] << ' ' << error << '\n';
+            failed++;
+        }
+    }
+    if (!commitDatabases()) {
+        output << "error " << lineNumber << " commit the saved games could not be written" << '\n';
+        failed++;
+    }
+    output.flush();
+    return failed;
+}
+
+bool UIManager::runCommand(const std::vector<std::string>& words, std::ostream& output, std::string& error) {
+    const std::string& command = words[0];
+    
+    if (command == "play") {
+        Position pos;
+        pos.reset();
+        std::vector<Move> game;
+        for (size_t i = 1; i < words.size(); i++) {
+            CompactMove m = pos.fromSan(words[i]);
+            if (m.isNull()) {
+                MoveList legal;
+                pos.generateLegalMoves(legal);
+                for (int j = 0; j < legal.count && m.isNull(); j++)
+                    if (Position::moveName(legal[j]) == words[i])
+                        m = legal[j];
+            }
+            if (m.isNull()) {
+                lastGame.clear();
+                error = "ply=" + std::to_string(i) + " move=" + quote(words[i]) + " illegal";
+                return false;
+            }
+            //A stored move only keeps its squares and is read back as a queen promotion
+            if (m.isPromotion() && m.promotionType() != QueenType) {
+                lastGame.clear();
+                error = "ply=" + std::to_string(i) + " move=" + quote(words[i]) + " underpromotion can not be saved";
+                return false;
+            }
+            game.push_back(pos.toStoredMove(m));
+            UndoInfo undo;
+            pos.makeMove(m, undo);
+        }
+        GameResult result = pos.isCheckmate() ? (pos.isWhiteToMove() ? BlackWins : WhiteWins) : pos.hasLegalMove() ? ResultUnknown : DrawnGame;
+        lastGame.swap(game);
+        output << "ok play plies=" << lastGame.size() << " result=" << PgnExporter::resultText(result) << " fen=" << quote(pos.toFen()) << '\n';
+        return true;
+    }
+    
+    if (command == "save") {
+        if (words.size() < 3) {
+            error = "usage: save <database> <name>";
+            return false;
+        }
+        if (lastGame.empty()) {
+            error = "no game has been played";
+            return false;
+        }
+        GameStorage* storage = database(words[1]);
+        if (storage == nullptr || !storage->isWritable()) {
+            error = "database=" + quote(words[1]) + " not writable";
+            return false;
+        }
+        int id = storage->addGame(words[2], lastGame, GameStorage::resultOf(lastGame));
+        if (id < 0) {
+            error = "database=" + quote(words[1]) + " write failed";
+            return false;
+        }
+        output << "ok save id=" << id << " plies=" << lastGame.size() << '\n';
+        return true;
+    }
+    
+    if (command == "convert") {
+        if (words.size() < 2) {
+            error = "usage: convert <game file> [text file]";
+            return false;
+        }
+        std::string target = (words.size() > 2) ? words[2] : words[1];
+        RAFile<Move> file;
+        file.mapFile(words[1]);
+        if (!file.isOpen()) {
+            error = "file=" + quote(words[1]) + " unreadable";
+            return false;
+        }
+        if (!globalFunctions::createGameFile(file, target)) {
+            error = "file=" + quote(target + ".txt") + " not written";
+            return false;
+        }
+        output << "ok convert plies=" << file.size() << " file=" << quote(target + ".txt") << '\n';
+        return true;
+    }
+    
+    if (command == "analyze") {
+        if (words.size() < 3) {
+            error = "usage: analyze <depth> <game files>";
+            return false;
+        }
+        int depth;
+        if (!numberWord(words, 1, depth, error))
+            return false;
+        BatchAnalyzer analyzer(0, depth, AnalysisCache::defaultCache());
+        BatchStats stats = analyzer.run(std::vector<std::string>(words.begin() + 2, words.end()), output);
+        output << "ok analyze games=" << stats.games << " failed=" << stats.failed << " plies=" << stats.plies
+               << " seconds=" << stats.seconds << '\n';
+        return true;
+    }
+    
+    if (command == "import") {
+        if (words.size() < 3) {
+            error = "usage: import <file.pgn> <database> [threads]";
+            return false;
+        }
+        GameStorage* storage = database(words[2]);
+        if (storage == nullptr || !storage->isWritable()) {
+            error = "database=" + quote(words[2]) + " not writable";
+            return false;
+        }
+        int threads = 0;
+        if (!numberWord(words, 3, threads, error))
+            return false;
+        PgnImporter importer(threads);
+        PgnImportStats stats = importer.run(words[1], *storage);
+        if (stats.bytes == 0) {
+            error = "file=" + quote(words[1]) + " unreadable";
+            return false;
+        }
+        output << "ok import games=" << stats.games << " failed=" << stats.failed << " plies=" << stats.plies
+               << " seconds=" << stats.seconds << '\n';
+        return true;
+    }
+    
+    if (command == "export") {
+        if (words.size() < 3) {
+            error = "usage: export <database or directory> <file.pgn> [threads]";
+            return false;
+        }
+        int threads = 0;
+        if (!numberWord(words, 3, threads, error))
+            return false;
+        PgnExporter exporter(threads);
+        PgnExportStats stats;
+        struct stat info;
+        if (stat(words[1].c_str(), &info) == 0 && S_ISDIR(info.st_mode)) {
+            stats = exporter.exportFiles(globalFunctions::listFiles(words[1]), words[2]);
+        } else {
+            commitDatabases();
+            GameStorage* storage = (stat(words[1].c_str(), &info) == 0) ? database(words[1]) : nullptr;
+            if (storage == nullptr) {
+                error = "database=" + quote(words[1]) + " unreadable";
+                return false;
+            }
+            stats = exporter.exportGames(*storage, words[2]);
+        }
+        if (stats.bytes == 0) {
+            error = "file=" + quote(words[2]) + " not written";
+            return false;
+        }
+        output << "ok export games=" << stats.games << " failed=" << stats.failed << " plies=" << stats.plies
+               << " bytes=" << stats.bytes << " seconds=" << stats.seconds << '\n';
+        return true;
+    }
+    
+    error = "unknown command";
+    return false;
+}
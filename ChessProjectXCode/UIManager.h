@@ -2,7 +2,12 @@
 #define UIManager_H
 
 #include "Move.h"
+#include "GameStorage.h"
 #include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
 
 #include <vector>
 
@@ -10,6 +15,22 @@ class UIManager {
 private:
     static int maxChoice;
     
+    //The game the last play command made, for the save command
+    std::vector<Move> lastGame;
+    //Databases the commands have opened, kept open so games are saved without reopening the file each time
+    std::map<std::string, std::unique_ptr<GameStorage>> databases;
+    
+    //Opens a database for the commands, or returns the one already open. Returns nullptr if it can not be opened
+    GameStorage* database(const std::string& path);
+    //Writes the games saved to each open database to its file
+    bool commitDatabases();
+    
+    //Loads a game saved to the default game database by its name, returning false if there is none
+    static bool loadSavedGame(const std::string& name, std::vector<Move>& game);
+    
+    //Runs one command split into words, writing its answer on success, or setting error to why it failed
+    bool runCommand(const std::vector<std::string>& words, std::ostream& output, std::string& error);
+    
 public:
     //Manages the menu for the user
     void menu();
@@ -28,6 +49,13 @@ public:
     
     //Saves a game to a text file
     void saveGame(std::string name, std::vector<Move>);
+    
+    //Lists the saved games which reached a position the user enters
+    void findPosition();
+    
+    //Runs commands from a stream, one a line, without prompting, clearing the screen or flushing between
+    //them. Each answers with one line of output. Returns the number of commands which failed
+    int runCommands(std::istream& input, std::ostream& output);
 };
 
 #endif
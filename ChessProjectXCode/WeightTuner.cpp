@@ -0,0 +1,342 @@
+#include "WeightTuner.h"
+#include "RAFile.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <random>
+#include <algorithm>
+#include <math.h>
+
+//Positions this early in a game are mostly book moves, and tell us nothing about the weights
+static const int skippedPlies = 8;
+
+/*
+ A fixed set of threads which each run a share of a job and then wait for the next one. A batch may only
+ take a millisecond, so starting threads for every batch would cost about as much as the batch itself.
+ */
+class WeightTuner::Workers {
+private:
+    std::vector<std::thread> threads;
+    std::mutex lock;
+    std::condition_variable started;
+    std::condition_variable finished;
+    std::function<void(int)> job;
+    uint64_t generation = 0;            //Counts the jobs handed out, so a worker can tell a new one from the last
+    int running = 0;                    //Workers still on the current job
+    bool stopping = false;
+
+    void work(int index) {
+        uint64_t done = 0;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                started.wait(guard, [&] { return stopping || generation != done; });
+                if (stopping)
+                    return;
+                done = generation;
+            }
+            job(index);
+            std::lock_guard<std::mutex> guard(lock);
+            if (--running == 0)
+                finished.notify_one();
+        }
+    }
+
+public:
+    Workers(int count) {
+        for (int t = 1; t < count; t++)
+            threads.push_back(std::thread(&Workers::work, this, t));
+    }
+    ~Workers() {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stopping = true;
+        }
+        started.notify_all();
+        for (auto it = threads.begin(); it != threads.end(); it++)
+            it->join();
+    }
+
+    int size() const {
+        return (int)threads.size() + 1;
+    }
+
+    //Runs task(t) for every t below size() at once, the calling thread taking t = 0, and returns once all have finished
+    void run(std::function<void(int)> task) {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            job = std::move(task);
+            running = (int)threads.size();
+            generation++;
+        }
+        started.notify_all();
+        job(0);
+        std::unique_lock<std::mutex> guard(lock);
+        finished.wait(guard, [&] { return running == 0; });
+    }
+};
+
+WeightTuner::WeightTuner(int threads) {
+    threadCount = (threads > 0) ? threads : (int)std::thread::hardware_concurrency();
+    if (threadCount < 1)
+        threadCount = 1;
+}
+
+TuningPosition WeightTuner::pack(const Position& pos, uint8_t result) {
+    TuningPosition tp;
+    for (int i = 0; i < 32; i++)
+        tp.nibbles[i] = (uint8_t)(pos.at(2 * i) | (pos.at(2 * i + 1) << 4));
+    for (int i = 0; i < 12; i++)
+        tp.mobility[i] = 0;
+    for (int sq = 0; sq < 64; sq++) {
+        uint8_t p = pos.at(sq);
+        if (p == NoPiece || Position::typeOf(p) == PawnType)
+            continue;
+        int index = Position::typeOf(p) - 1 + (Position::isWhitePiece(p) ? 0 : 6);
+        tp.mobility[index] = (uint8_t)std::min(255, tp.mobility[index] + pos.mobility(sq));
+    }
+    tp.result = result;
+    tp.padding[0] = tp.padding[1] = tp.padding[2] = 0;
+    return tp;
+}
+
+/*
+ Replays a saved game, keeping the positions where the side to move is not in check.
+ The result is taken from the final position: saved games end in mate, so anything else is a draw.
+ moves - the game
+ out - the vector the positions are added to
+ */
+bool WeightTuner::addGame(const std::vector<Move>& moves, std::vector<TuningPosition>& out) {
+    if (moves.empty())
+        return false;
+
+    Position pos;
+    std::vector<Position> kept;
+    for (size_t i = 0; i < moves.size(); i++) {
+        if ((int)i >= skippedPlies && !pos.inCheck())
+            kept.push_back(pos);
+        if (!pos.applyStoredMove(moves[i]))
+            return false;
+    }
+
+    uint8_t result = 1;
+    if (pos.isCheckmate())
+        result = pos.isWhiteToMove() ? 0 : 2;
+
+    for (auto it = kept.cbegin(); it != kept.cend(); it++)
+        out.push_back(pack(*it, result));
+    return true;
+}
+
+int WeightTuner::loadGames(const std::vector<std::string>& files) {
+    return loadGames(files.size(), [&](size_t i, std::vector<Move>& moves) {
+        return RAFile<Move>::readAll(files[i], moves);
+    });
+}
+
+int WeightTuner::loadGames(const GameStorage& storage) {
+    return loadGames((size_t)storage.size(), [&](size_t i, std::vector<Move>& moves) {
+        return storage.loadGame((int)i, moves);
+    });
+}
+
+/*
+ Loads the games on all threads, then shuffles the positions so every batch is a fair sample
+ count - the number of games
+ read - reads a game's moves
+ */
+int WeightTuner::loadGames(size_t count, const std::function<bool(size_t i, std::vector<Move>& moves)>& read) {
+    std::atomic<size_t> next(0);
+    std::atomic<int> loaded(0);
+    std::mutex merge;
+    std::vector<std::thread> workers;
+
+    for (int t = 0; t < threadCount; t++) {
+        workers.push_back(std::thread([this, count, &read, &next, &loaded, &merge] () {
+            std::vector<TuningPosition> local;
+            std::vector<Move> moves;
+            size_t i;
+            while ((i = next++) < count)
+                if (read(i, moves) && addGame(moves, local))
+                    loaded++;
+            std::lock_guard<std::mutex> lock(merge);
+            positions.insert(positions.end(), local.begin(), local.end());
+        }));
+    }
+    for (auto it = workers.begin(); it != workers.end(); it++)
+        it->join();
+
+    std::mt19937_64 rng(12345);
+    std::shuffle(positions.begin(), positions.end(), rng);
+    return loaded;
+}
+
+double WeightTuner::evaluate(const TuningPosition& tp, const double* weights) {
+    double score = 0;
+    for (int i = 0; i < 32; i++) {
+        for (int half = 0; half < 2; half++) {
+            uint8_t p = (half == 0) ? (tp.nibbles[i] & 15) : (tp.nibbles[i] >> 4);
+            if (p == NoPiece)
+                continue;
+            int sq = 2 * i + half;
+            int type = Position::typeOf(p);
+            bool white = Position::isWhitePiece(p);
+            double value = weights[EvalWeights::materialOffset + type - 1] +
+                           weights[EvalWeights::pstOffset + (type - 1) * 64 + (white ? sq : (sq ^ 56))];
+            score += white ? value : -value;
+        }
+    }
+    for (int t = 0; t < 6; t++)
+        score += weights[EvalWeights::mobilityOffset + t] * (tp.mobility[t] - tp.mobility[6 + t]);
+    return score;
+}
+
+/*
+ Adds the log loss of a range of records, and its gradient with respect to every weight
+ k - the scaling constant of the logistic curve
+ */
+void WeightTuner::accumulate(const double* weights, double k, size_t begin, size_t end, double& loss, double* gradient) const {
+    const double scale = k * log(10.0) / 400.0;
+    for (size_t i = begin; i < end; i++) {
+        const TuningPosition& tp = positions[i];
+        double result = tp.result / 2.0;
+        double e = evaluate(tp, weights);
+        double s = 1.0 / (1.0 + exp(-scale * e));
+        s = std::min(std::max(s, 1e-9), 1.0 - 1e-9);
+        loss -= result * log(s) + (1.0 - result) * log(1.0 - s);
+
+        if (gradient == nullptr)
+            continue;
+
+        //The derivative of the log loss through the logistic curve is just the error, times the feature
+        double g = (s - result) * scale;
+        for (int j = 0; j < 32; j++) {
+            for (int half = 0; half < 2; half++) {
+                uint8_t p = (half == 0) ? (tp.nibbles[j] & 15) : (tp.nibbles[j] >> 4);
+                if (p == NoPiece)
+                    continue;
+                int sq = 2 * j + half;
+                int type = Position::typeOf(p);
+                bool white = Position::isWhitePiece(p);
+                double signedG = white ? g : -g;
+                gradient[EvalWeights::materialOffset + type - 1] += signedG;
+                gradient[EvalWeights::pstOffset + (type - 1) * 64 + (white ? sq : (sq ^ 56))] += signedG;
+            }
+        }
+        for (int t = 0; t < 6; t++)
+            gradient[EvalWeights::mobilityOffset + t] += g * (tp.mobility[t] - tp.mobility[6 + t]);
+    }
+}
+
+double WeightTuner::computeLoss(Workers& workers, const std::vector<double>& weights, double k, size_t begin, size_t end, std::vector<double>* gradient) const {
+    size_t total = end - begin;
+    if (total == 0)
+        return 0;
+
+    int threads = (int)std::min<size_t>(workers.size(), total);
+    std::vector<double> losses(threads, 0.0);
+    std::vector<std::vector<double>> gradients(gradient ? threads : 0, std::vector<double>(EvalWeights::count, 0.0));
+
+    workers.run([&] (int t) {
+        if (t >= threads)
+            return;
+        size_t from = begin + total * t / threads;
+        size_t to = begin + total * (t + 1) / threads;
+        accumulate(weights.data(), k, from, to, losses[t], gradient ? gradients[t].data() : nullptr);
+    });
+
+    double loss = 0;
+    for (int t = 0; t < threads; t++)
+        loss += losses[t];
+
+    if (gradient != nullptr) {
+        gradient->assign(EvalWeights::count, 0.0);
+        for (int t = 0; t < threads; t++)
+            for (int i = 0; i < EvalWeights::count; i++)
+                (*gradient)[i] += gradients[t][i] / total;
+    }
+    return loss / total;
+}
+
+double WeightTuner::fitScalingConstant(const EvalWeights& weights) {
+    Workers workers(threadCount);
+    return fitScalingConstant(workers, weights);
+}
+
+/*
+ Finds the scaling constant with a coarse scan followed by a few finer ones
+ workers - the threads to compute the loss on
+ weights - the weights to fit the curve for
+ */
+double WeightTuner::fitScalingConstant(Workers& workers, const EvalWeights& weights) {
+    std::vector<double> w(weights.values, weights.values + EvalWeights::count);
+    double best = 1.0;
+    double bestLoss = computeLoss(workers, w, best, 0, positions.size(), nullptr);
+    double step = 0.5;
+
+    for (int round = 0; round < 4; round++) {
+        double centre = best;
+        for (int i = -5; i <= 5; i++) {
+            double k = centre + i * step;
+            if (k <= 0)
+                continue;
+            double loss = computeLoss(workers, w, k, 0, positions.size(), nullptr);
+            if (loss < bestLoss) {
+                bestLoss = loss;
+                best = k;
+            }
+        }
+        step /= 5;
+    }
+    return best;
+}
+
+/*
+ Tunes the weights with batched Adam steps over the shuffled positions
+ start - the weights to start from
+ epochs - the number of passes over every position
+ batchSize - the number of positions per gradient step
+ learningRate - the step size, in centipawns
+ log - where progress is written
+ */
+EvalWeights WeightTuner::tune(const EvalWeights& start, int epochs, int batchSize, double learningRate, std::ostream& log) {
+    EvalWeights result = start;
+    if (positions.empty() || batchSize < 1)
+        return result;
+
+    Workers workers(threadCount);
+    double k = fitScalingConstant(workers, start);
+    log << "Tuning " << positions.size() << " positions on " << threadCount << " threads, K = " << k << std::endl;
+
+    std::vector<double> w(start.values, start.values + EvalWeights::count);
+    std::vector<double> gradient;
+    std::vector<double> m(EvalWeights::count, 0.0);
+    std::vector<double> v(EvalWeights::count, 0.0);
+    const double beta1 = 0.9, beta2 = 0.999, epsilon = 1e-8;
+    long step = 0;
+
+    for (int epoch = 1; epoch <= epochs; epoch++) {
+        for (size_t begin = 0; begin < positions.size(); begin += batchSize) {
+            size_t end = std::min(positions.size(), begin + (size_t)batchSize);
+            computeLoss(workers, w, k, begin, end, &gradient);
+            step++;
+            for (int i = 0; i < EvalWeights::count; i++) {
+                //The king is never traded, so its material weight stays fixed
+                if (i == EvalWeights::materialOffset + KingType - 1)
+                    continue;
+                m[i] = beta1 * m[i] + (1 - beta1) * gradient[i];
+                v[i] = beta2 * v[i] + (1 - beta2) * gradient[i] * gradient[i];
+                double mHat = m[i] / (1 - pow(beta1, step));
+                double vHat = v[i] / (1 - pow(beta2, step));
+                w[i] -= learningRate * mHat / (sqrt(vHat) + epsilon);
+            }
+        }
+        log << "Epoch " << epoch << " loss " << computeLoss(workers, w, k, 0, positions.size(), nullptr) << std::endl;
+    }
+
+    for (int i = 0; i < EvalWeights::count; i++)
+        result.values[i] = (int)lround(w[i]);
+    return result;
+}
@@ -0,0 +1,76 @@
+#ifndef WeightTuner_H
+#define WeightTuner_H
+
+#include "Evaluation.h"
+#include "GameStorage.h"
+#include <functional>
+#include <string>
+#include <vector>
+#include <ostream>
+
+//A position prepared for tuning. Everything the evaluation reads is stored here, so an epoch
+//only streams these records and never replays a game
+struct TuningPosition {
+    uint8_t nibbles[32];        //Piece code of square 2i in the low nibble, 2i + 1 in the high nibble
+    uint8_t mobility[12];       //Summed mobility per piece type, [type - 1] for white and [6 + type - 1] for black
+    uint8_t result;             //0 black won, 1 draw, 2 white won
+    uint8_t padding[3];
+};
+
+/*
+ Tunes EvalWeights Texel style: the evaluation of every position is squashed through a logistic
+ curve and compared with the result of the game it came from, and the weights are moved down the
+ gradient of the log loss one batch at a time. Each batch is split across all cores, on worker threads
+ started once per call to tune.
+ */
+class WeightTuner {
+private:
+    std::vector<TuningPosition> positions;
+    int threadCount;
+
+    //Threads kept waiting for work between the batches of a tune() call
+    class Workers;
+
+    //Replays a saved game, adding the quiet positions from it. Returns false if it is not a whole game
+    static bool addGame(const std::vector<Move>& moves, std::vector<TuningPosition>& out);
+
+    //Loads games 0 to count - 1, each read into moves by read, which returns false if it could not be
+    int loadGames(size_t count, const std::function<bool(size_t i, std::vector<Move>& moves)>& read);
+
+    //Packs a position into a tuning record
+    static TuningPosition pack(const Position& pos, uint8_t result);
+
+    //The evaluation of a record under the given weights
+    static double evaluate(const TuningPosition& tp, const double* weights);
+
+    //Adds the loss of the records in [begin, end) to loss, and the gradient to gradient if it is not null
+    void accumulate(const double* weights, double k, size_t begin, size_t end, double& loss, double* gradient) const;
+
+    //The mean loss over [begin, end), filling the mean gradient if it is not null. Split across the workers
+    double computeLoss(Workers& workers, const std::vector<double>& weights, double k, size_t begin, size_t end, std::vector<double>* gradient) const;
+
+    double fitScalingConstant(Workers& workers, const EvalWeights& weights);
+
+public:
+
+    //threads - number of worker threads, where 0 uses every core
+    WeightTuner(int threads = 0);
+
+    //Loads every saved game in the list, returning the number of games which could be used
+    int loadGames(const std::vector<std::string>& files);
+    //Loads every game in the database, returning the number which could be used
+    int loadGames(const GameStorage& storage);
+
+    //Number of positions loaded
+    size_t size() const {
+        return positions.size();
+    }
+
+    //Finds the scaling constant for the logistic curve which best fits the given weights
+    double fitScalingConstant(const EvalWeights& weights);
+
+    //Runs the given number of passes over the positions, starting from start, and returns the tuned weights
+    EvalWeights tune(const EvalWeights& start, int epochs, int batchSize, double learningRate, std::ostream& log);
+};
+
+#endif
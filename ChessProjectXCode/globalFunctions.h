@@ -3,22 +3,23 @@
 
 #include <string>
 #include <fstream>
+#include <vector>
 #include "ChessBoard.h"
 #include "RAFile.h"
 #include "Move.h"
 
 class globalFunctions {
-private:
-    
-    static std::string createGameEntry(RAFile<Move>&, ChessBoard, bool, int, Move&);
-    
 public:
     static void clearConsole();
     
     static std::string getInput();
     
     static bool createGameFile(RAFile<Move>&, std::string);
-    
+    static bool createGameFile(const std::vector<Move>&, std::string);
+
+    //Lists the paths of the regular files in a directory, in sorted order
+    static std::vector<std::string> listFiles(std::string directory);
+
 };
 
 #endif